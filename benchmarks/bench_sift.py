@@ -0,0 +1,77 @@
+"""Benchmark Sift.extract with DSP and affine shape estimation on and off.
+
+Domain-size pooling (DSP) and affine shape estimation are only supported by
+the CPU extractor, so all configurations run on the CPU. The image is read
+with Pillow if given, and is a synthetic multi-scale texture otherwise.
+Example:
+
+    python benchmarks/bench_sift.py --image image.jpg --repeats 3
+"""
+
+import argparse
+import itertools
+import time
+
+import numpy as np
+import pycolmap
+
+
+def synthetic_image(width, height, seed=0):
+    """Sum of upsampled noise at several scales, as 8-bit greyscale."""
+    rng = np.random.default_rng(seed)
+    image = np.zeros((height, width))
+    for cell in [4, 8, 16, 32, 64]:
+        noise = rng.normal(size=(height // cell + 1, width // cell + 1))
+        image += np.kron(noise, np.ones((cell, cell)))[:height, :width]
+    image -= image.min()
+    return (255 * image / image.max()).astype(np.uint8)
+
+
+def load_image(path):
+    from PIL import Image
+
+    return np.asarray(Image.open(path).convert("L"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--image", type=str, default=None)
+    parser.add_argument("--width", type=int, default=1600)
+    parser.add_argument("--height", type=int, default=1200)
+    parser.add_argument("--max_num_features", type=int, default=8192)
+    parser.add_argument("--num_threads", type=int, default=-1)
+    parser.add_argument("--repeats", type=int, default=3)
+    args = parser.parse_args()
+
+    if args.image is None:
+        image = synthetic_image(args.width, args.height)
+    else:
+        image = load_image(args.image)
+    print(f"Image of {image.shape[1]}x{image.shape[0]} pixels")
+
+    baseline = None
+    for dsp, affine in itertools.product([False, True], repeat=2):
+        options = pycolmap.SiftExtractionOptions()
+        options.max_image_size = max(image.shape)
+        options.max_num_features = args.max_num_features
+        options.num_threads = args.num_threads
+        options.domain_size_pooling = dsp
+        options.estimate_affine_shape = affine
+        sift = pycolmap.Sift(options, device=pycolmap.Device.cpu)
+        times = []
+        for _ in range(args.repeats):
+            start = time.perf_counter()
+            keypoints, _ = sift.extract(image)
+            times.append(time.perf_counter() - start)
+        seconds = min(times)
+        if baseline is None:
+            baseline = seconds
+        print(
+            f"dsp={dsp!s:>5} affine_shape={affine!s:>5}: "
+            f"{1000 * seconds:9.2f} ms, {len(keypoints):6d} features, "
+            f"{seconds / baseline:5.2f}x the default"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,110 @@
+"""Benchmark Reconstruction.transform and Reconstruction.normalize.
+
+Builds a synthetic reconstruction and times both operations for several
+numbers of threads, checking that the results do not depend on the number
+of threads. Example:
+
+    python benchmarks/bench_transform.py --num_points 1000000 --threads 1 4 -1
+"""
+
+import argparse
+import copy
+import time
+
+import numpy as np
+import pycolmap
+
+
+def make_reconstruction(num_images, num_points, seed=0):
+    rng = np.random.default_rng(seed)
+    reconstruction = pycolmap.Reconstruction()
+    camera = pycolmap.Camera(
+        model="SIMPLE_PINHOLE",
+        width=1024,
+        height=768,
+        params=[800.0, 512.0, 384.0],
+        id=1,
+    )
+    reconstruction.add_camera(camera)
+    for image_id in range(1, num_images + 1):
+        quat = rng.normal(size=4)
+        cam_from_world = pycolmap.Rigid3d(
+            pycolmap.Rotation3d(quat / np.linalg.norm(quat)),
+            rng.normal(scale=10.0, size=3),
+        )
+        image = pycolmap.Image(
+            name=f"{image_id:06d}.jpg",
+            cam_from_world=cam_from_world,
+            camera_id=1,
+            id=image_id,
+        )
+        reconstruction.add_image(image)
+        reconstruction.register_image(image_id)
+    for xyz in rng.normal(scale=10.0, size=(num_points, 3)):
+        reconstruction.add_point3D(xyz, pycolmap.Track())
+    return reconstruction
+
+
+def point_coordinates(reconstruction):
+    points3D = reconstruction.points3D
+    return np.array([points3D[i].xyz for i in sorted(points3D.keys())])
+
+
+def time_operation(reconstruction, operation, num_threads, repeats):
+    """Best time over repeats, and the result of the first run."""
+    times = []
+    result = None
+    for _ in range(repeats):
+        copied = copy.copy(reconstruction)
+        start = time.perf_counter()
+        operation(copied, num_threads)
+        times.append(time.perf_counter() - start)
+        if result is None:
+            result = point_coordinates(copied)
+    return min(times), result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--num_images", type=int, default=2000)
+    parser.add_argument("--num_points", type=int, default=200000)
+    parser.add_argument("--threads", type=int, nargs="+", default=[1, 2, 4, -1])
+    parser.add_argument("--repeats", type=int, default=5)
+    args = parser.parse_args()
+
+    print(
+        f"Building a reconstruction with {args.num_images} images and "
+        f"{args.num_points} points..."
+    )
+    reconstruction = make_reconstruction(args.num_images, args.num_points)
+
+    new_from_old_world = pycolmap.Sim3d(
+        2.0,
+        pycolmap.Rotation3d(np.array([0.1, 0.2, 0.3, 0.9]) / np.sqrt(0.95)),
+        np.array([1.0, -2.0, 3.0]),
+    )
+    operations = {
+        "transform": lambda r, t: r.transform(
+            new_from_old_world, num_threads=t
+        ),
+        "normalize": lambda r, t: r.normalize(num_threads=t),
+    }
+    for name, operation in operations.items():
+        reference = None
+        baseline = None
+        for num_threads in args.threads:
+            seconds, result = time_operation(
+                reconstruction, operation, num_threads, args.repeats
+            )
+            if reference is None:
+                reference, baseline = result, seconds
+            max_difference = np.abs(result - reference).max()
+            print(
+                f"{name:>9} num_threads={num_threads:>3}: "
+                f"{1000 * seconds:8.2f} ms, speedup {baseline / seconds:5.2f}, "
+                f"max difference {max_difference:.1e}"
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -1,12 +1,17 @@
 // Authors: Mihai-Dusmanu (mihaidusmanu), Paul-Edouard Sarlin (skydes)
 
 #include "colmap/estimators/pose.h"
+
+#include "colmap/estimators/absolute_pose.h"
 #include "colmap/geometry/rigid3.h"
 #include "colmap/math/random.h"
+#include "colmap/optim/loransac.h"
 #include "colmap/scene/camera.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 
 using namespace colmap;
 
@@ -17,8 +22,273 @@ using namespace colmap;
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+#include "estimators/gravity_estimators.h"
+#include "estimators/parallel_loransac.h"
 #include "helpers.h"
 #include "log_exceptions.h"
+#include "utils.h"
+
+// Options of the search over focal lengths in absolute pose estimation with
+// estimate_focal_length, complementing AbsolutePoseEstimationOptions, whose
+// num_threads threads evaluate the focal length samples.
+struct FocalLengthSweepOptions {
+  // Whether to first evaluate num_coarse_samples focal lengths and then
+  // num_fine_samples focal lengths around the best coarse sample, instead of
+  // num_focal_length_samples focal lengths in a single sweep.
+  bool coarse_to_fine = false;
+  int num_coarse_samples = 10;
+  int num_fine_samples = 10;
+
+  // Skip the fine sweep if the best coarse sample has at least this ratio
+  // of inliers, i.e. the support is saturated.
+  double saturation_inlier_ratio = 0.9;
+
+  void Check() const {
+    THROW_CHECK_GE(num_coarse_samples, 2);
+    THROW_CHECK_GE(num_fine_samples, 1);
+    THROW_CHECK_GE(saturation_inlier_ratio, 0);
+  }
+};
+
+struct AbsolutePoseRANSACResult {
+  bool success = false;
+  size_t num_inliers = 0;
+  std::vector<char> inlier_mask;
+  Eigen::Matrix3x4d cam_from_world;
+};
+
+// P3P + EPNP LORANSAC on image points in the given camera. The hypotheses are
+// scored in parallel batches if num_threads is not 1.
+AbsolutePoseRANSACResult RunAbsolutePoseRANSAC(
+    const RANSACOptions& options,
+    const std::vector<Eigen::Vector2d>& points2D,
+    const std::vector<Eigen::Vector3d>& points3D,
+    const Camera& camera,
+    const int num_threads) {
+  std::vector<Eigen::Vector2d> points2D_in_cam(points2D.size());
+  for (size_t i = 0; i < points2D.size(); ++i) {
+    points2D_in_cam[i] = camera.CamFromImg(points2D[i]);
+  }
+
+  RANSACOptions ransac_options = options;
+  ransac_options.max_error = camera.CamFromImgThreshold(options.max_error);
+
+  AbsolutePoseRANSACResult result;
+  if (num_threads == 1) {
+    LORANSAC<P3PEstimator, EPNPEstimator> ransac(ransac_options);
+    const auto report = ransac.Estimate(points2D_in_cam, points3D);
+    result.success = report.success;
+    result.num_inliers = report.support.num_inliers;
+    result.inlier_mask = report.inlier_mask;
+    result.cam_from_world = report.model;
+  } else {
+    ParallelLORANSAC<P3PEstimator, EPNPEstimator> ransac(ransac_options,
+                                                         num_threads);
+    const auto report = ransac.Estimate(points2D_in_cam, points3D);
+    result.success = report.success;
+    result.num_inliers = report.support.num_inliers;
+    result.inlier_mask = report.inlier_mask;
+    result.cam_from_world = report.model;
+  }
+  return result;
+}
+
+// Evaluate the focal length factors in parallel and return the index of the
+// best one, i.e. the first one with the most inliers, or -1 if none succeeds.
+int EvaluateFocalLengthFactors(
+    const AbsolutePoseEstimationOptions& options,
+    const std::vector<double>& focal_length_factors,
+    const std::vector<Eigen::Vector2d>& points2D,
+    const std::vector<Eigen::Vector3d>& points3D,
+    const Camera& camera,
+    const int num_sweep_threads,
+    const int num_ransac_threads,
+    std::vector<AbsolutePoseRANSACResult>* results) {
+  const std::vector<size_t>& focal_length_idxs = camera.FocalLengthIdxs();
+  results->resize(focal_length_factors.size());
+  ParallelFor(focal_length_factors.size(),
+              num_sweep_threads,
+              [&](size_t, size_t begin, size_t end) {
+                Camera scaled_camera = camera;
+                for (size_t i = begin; i < end; ++i) {
+                  // The PRNG is seeded per sample, so that the result does
+                  // not depend on the distribution of samples over threads.
+                  SetPRNGSeed(0);
+                  for (const size_t idx : focal_length_idxs) {
+                    scaled_camera.Params(idx) =
+                        focal_length_factors[i] * camera.Params(idx);
+                  }
+                  (*results)[i] = RunAbsolutePoseRANSAC(options.ransac_options,
+                                                        points2D,
+                                                        points3D,
+                                                        scaled_camera,
+                                                        num_ransac_threads);
+                }
+              });
+
+  int best_idx = -1;
+  for (size_t i = 0; i < results->size(); ++i) {
+    if ((*results)[i].success &&
+        (best_idx == -1 ||
+         (*results)[i].num_inliers > (*results)[best_idx].num_inliers)) {
+      best_idx = static_cast<int>(i);
+    }
+  }
+  return best_idx;
+}
+
+// Same as colmap::EstimateAbsolutePose, with two differences. The LORANSAC
+// hypotheses are scored in parallel batches on num_threads threads, unless
+// num_threads is 1. With estimate_focal_length, the focal length samples are
+// distributed over options.num_threads threads, as in COLMAP, optionally in a
+// coarse-to-fine sweep.
+bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
+                          const FocalLengthSweepOptions& sweep_options,
+                          const std::vector<Eigen::Vector2d>& points2D,
+                          const std::vector<Eigen::Vector3d>& points3D,
+                          Rigid3d* cam_from_world,
+                          Camera* camera,
+                          size_t* num_inliers,
+                          std::vector<char>* inlier_mask,
+                          const int num_threads) {
+  if (!options.estimate_focal_length && num_threads == 1) {
+    return EstimateAbsolutePose(options,
+                                points2D,
+                                points3D,
+                                cam_from_world,
+                                camera,
+                                num_inliers,
+                                inlier_mask);
+  }
+
+  AbsolutePoseRANSACResult result;
+  if (options.estimate_focal_length) {
+    options.Check();
+    sweep_options.Check();
+
+    // Focal length factors on a quadratic function of t in [0, 1], such that
+    // more samples are drawn for small focal lengths, as in COLMAP.
+    const double min_ratio = options.min_focal_length_ratio;
+    const double max_ratio = options.max_focal_length_ratio;
+    const auto FactorFromT = [&](const double t) {
+      return min_ratio + (max_ratio - min_ratio) * t * t;
+    };
+
+    const int num_samples = sweep_options.coarse_to_fine
+                                ? sweep_options.num_coarse_samples
+                                : options.num_focal_length_samples + 1;
+    std::vector<double> ts(num_samples);
+    std::vector<double> focal_length_factors(num_samples);
+    for (int i = 0; i < num_samples; ++i) {
+      ts[i] = static_cast<double>(i) / (num_samples - 1);
+      focal_length_factors[i] = FactorFromT(ts[i]);
+    }
+
+    std::vector<AbsolutePoseRANSACResult> results;
+    int best_idx = EvaluateFocalLengthFactors(options,
+                                              focal_length_factors,
+                                              points2D,
+                                              points3D,
+                                              *camera,
+                                              options.num_threads,
+                                              num_threads,
+                                              &results);
+    if (best_idx == -1) {
+      return false;
+    }
+    double best_factor = focal_length_factors[best_idx];
+    result = std::move(results[best_idx]);
+
+    if (sweep_options.coarse_to_fine &&
+        result.num_inliers <
+            sweep_options.saturation_inlier_ratio * points2D.size()) {
+      // Sample the interval between the neighbors of the best coarse sample.
+      const double min_t = ts[std::max(best_idx - 1, 0)];
+      const double max_t = ts[std::min(best_idx + 1, num_samples - 1)];
+      std::vector<double> fine_focal_length_factors(
+          sweep_options.num_fine_samples);
+      for (int i = 0; i < sweep_options.num_fine_samples; ++i) {
+        fine_focal_length_factors[i] = FactorFromT(
+            min_t + (max_t - min_t) * (i + 1) /
+                        (sweep_options.num_fine_samples + 1));
+      }
+      const int best_fine_idx =
+          EvaluateFocalLengthFactors(options,
+                                     fine_focal_length_factors,
+                                     points2D,
+                                     points3D,
+                                     *camera,
+                                     options.num_threads,
+                                     num_threads,
+                                     &results);
+      if (best_fine_idx != -1 &&
+          results[best_fine_idx].num_inliers > result.num_inliers) {
+        best_factor = fine_focal_length_factors[best_fine_idx];
+        result = std::move(results[best_fine_idx]);
+      }
+    }
+
+    for (const size_t idx : camera->FocalLengthIdxs()) {
+      camera->Params(idx) *= best_factor;
+    }
+  } else {
+    result = RunAbsolutePoseRANSAC(
+        options.ransac_options, points2D, points3D, *camera, num_threads);
+    if (!result.success) {
+      return false;
+    }
+  }
+
+  *num_inliers = result.num_inliers;
+  *inlier_mask = result.inlier_mask;
+  *cam_from_world =
+      Rigid3d(Eigen::Quaterniond(result.cam_from_world.leftCols<3>()),
+              result.cam_from_world.col(3));
+  return true;
+}
+
+// Absolute pose estimation with the 2-point solver for a known direction of
+// gravity in the camera and world frames, followed by the EPNP local
+// optimization of LORANSAC.
+bool EstimateAbsolutePoseWithGravity(
+    const AbsolutePoseEstimationOptions& options,
+    const Eigen::Vector3d& gravity_in_cam,
+    const Eigen::Vector3d& gravity_in_world,
+    const std::vector<Eigen::Vector2d>& points2D,
+    const std::vector<Eigen::Vector3d>& points3D,
+    Rigid3d* cam_from_world,
+    const Camera& camera,
+    size_t* num_inliers,
+    std::vector<char>* inlier_mask,
+    const int num_threads) {
+  THROW_CHECK_MSG(!options.estimate_focal_length,
+                  "Focal length estimation is not supported with gravity.");
+  THROW_CHECK_GT(gravity_in_cam.norm(), 0);
+  THROW_CHECK_GT(gravity_in_world.norm(), 0);
+
+  std::vector<Eigen::Vector2d> points2D_in_cam(points2D.size());
+  for (size_t i = 0; i < points2D.size(); ++i) {
+    points2D_in_cam[i] = camera.CamFromImg(points2D[i]);
+  }
+
+  RANSACOptions ransac_options = options.ransac_options;
+  ransac_options.max_error =
+      camera.CamFromImgThreshold(options.ransac_options.max_error);
+  ParallelLORANSAC<GravityAbsolutePoseEstimator, EPNPEstimator> ransac(
+      ransac_options,
+      num_threads,
+      GravityAbsolutePoseEstimator(gravity_in_cam, gravity_in_world));
+  const auto report = ransac.Estimate(points2D_in_cam, points3D);
+  if (!report.success) {
+    return false;
+  }
+
+  *num_inliers = report.support.num_inliers;
+  *inlier_mask = report.inlier_mask;
+  *cam_from_world = Rigid3d(Eigen::Quaterniond(report.model.leftCols<3>()),
+                            report.model.col(3));
+  return true;
+}
 
 py::dict absolute_pose_estimation(
     const std::vector<Eigen::Vector2d> points2D,
@@ -26,12 +296,20 @@ py::dict absolute_pose_estimation(
     Camera& camera,
     const AbsolutePoseEstimationOptions estimation_options,
     const AbsolutePoseRefinementOptions refinement_options,
-    const bool return_covariance) {
+    const bool return_covariance,
+    const int num_threads,
+    const FocalLengthSweepOptions sweep_options,
+    const py::object gravity,
+    const Eigen::Vector3d gravity_world) {
   SetPRNGSeed(0);
 
   // Check that both vectors have the same size.
   THROW_CHECK_EQ(points2D.size(), points3D.size());
 
+  const bool has_gravity = !gravity.is_none();
+  const Eigen::Vector3d gravity_in_cam =
+      has_gravity ? gravity.cast<Eigen::Vector3d>() : Eigen::Vector3d::Zero();
+
   // Failure output dictionary.
   py::dict failure_dict("success"_a = false);
   py::gil_scoped_release release;
@@ -41,13 +319,28 @@ py::dict absolute_pose_estimation(
   size_t num_inliers;
   std::vector<char> inlier_mask;
 
-  if (!EstimateAbsolutePose(estimation_options,
-                            points2D,
-                            points3D,
-                            &cam_from_world,
-                            &camera,
-                            &num_inliers,
-                            &inlier_mask)) {
+  if (has_gravity) {
+    if (!EstimateAbsolutePoseWithGravity(estimation_options,
+                                         gravity_in_cam,
+                                         gravity_world,
+                                         points2D,
+                                         points3D,
+                                         &cam_from_world,
+                                         camera,
+                                         &num_inliers,
+                                         &inlier_mask,
+                                         num_threads)) {
+      return failure_dict;
+    }
+  } else if (!EstimateAbsolutePose(estimation_options,
+                                   sweep_options,
+                                   points2D,
+                                   points3D,
+                                   &cam_from_world,
+                                   &camera,
+                                   &num_inliers,
+                                   &inlier_mask,
+                                   num_threads)) {
     return failure_dict;
   }
 
@@ -91,7 +384,8 @@ py::dict absolute_pose_estimation(const std::vector<Eigen::Vector2d> points2D,
                                   const int min_num_trials,
                                   const int max_num_trials,
                                   const double confidence,
-                                  const bool return_covariance) {
+                                  const bool return_covariance,
+                                  const int num_threads) {
   // Absolute pose estimation parameters.
   AbsolutePoseEstimationOptions abs_pose_options;
   abs_pose_options.estimate_focal_length = false;
@@ -112,7 +406,11 @@ py::dict absolute_pose_estimation(const std::vector<Eigen::Vector2d> points2D,
                                   camera,
                                   abs_pose_options,
                                   abs_pose_refinement_options,
-                                  return_covariance);
+                                  return_covariance,
+                                  num_threads,
+                                  FocalLengthSweepOptions(),
+                                  py::none(),
+                                  Eigen::Vector3d(0, 0, -1));
 }
 
 py::dict pose_refinement(
@@ -121,7 +419,8 @@ py::dict pose_refinement(
     const std::vector<Eigen::Vector3d> points3D,
     const std::vector<bool> inlier_mask,
     const Camera camera,
-    const AbsolutePoseRefinementOptions refinement_options) {
+    const AbsolutePoseRefinementOptions refinement_options,
+    const bool return_covariance) {
   SetPRNGSeed(0);
 
   // Check that both vectors have the same size.
@@ -134,29 +433,120 @@ py::dict pose_refinement(
 
   // Absolute pose estimation.
   Rigid3d refined_cam_from_world = init_cam_from_world;
-  std::vector<char> inlier_mask_char;
-  for (size_t i = 0; i < inlier_mask.size(); ++i) {
-    if (inlier_mask[i]) {
-      inlier_mask_char.emplace_back(1);
-    } else {
-      inlier_mask_char.emplace_back(0);
-    }
-  }
+  const std::vector<char> inlier_mask_char(inlier_mask.begin(),
+                                           inlier_mask.end());
 
   // Absolute pose refinement.
+  Eigen::Matrix<double, 6, 6> covariance;
   if (!RefineAbsolutePose(refinement_options,
                           inlier_mask_char,
                           points2D,
                           points3D,
                           &refined_cam_from_world,
-                          const_cast<Camera*>(&camera))) {
+                          const_cast<Camera*>(&camera),
+                          return_covariance ? &covariance : nullptr)) {
     return failure_dict;
   }
 
   // Success output dictionary.
   py::gil_scoped_acquire acquire;
-  return py::dict("success"_a = true,
-                  "cam_from_world"_a = refined_cam_from_world);
+  py::dict success_dict("success"_a = true,
+                        "cam_from_world"_a = refined_cam_from_world);
+  if (return_covariance) success_dict["covariance"] = covariance;
+  return success_dict;
+}
+
+py::dict pose_refinement_batch(
+    const std::vector<Rigid3d>& init_cams_from_world,
+    const std::vector<std::vector<Eigen::Vector2d>>& points2D,
+    const std::vector<std::vector<Eigen::Vector3d>>& points3D,
+    const std::vector<std::vector<bool>>& inlier_masks,
+    const std::vector<Camera>& cameras,
+    const AbsolutePoseRefinementOptions& refinement_options,
+    const bool return_covariance,
+    const int num_threads) {
+  const size_t num_poses = init_cams_from_world.size();
+  THROW_CHECK_EQ(points2D.size(), num_poses);
+  THROW_CHECK_EQ(points3D.size(), num_poses);
+  THROW_CHECK_EQ(inlier_masks.size(), num_poses);
+  THROW_CHECK(cameras.size() == 1 || cameras.size() == num_poses);
+  for (size_t i = 0; i < num_poses; ++i) {
+    THROW_CHECK_EQ(points2D[i].size(), points3D[i].size());
+    THROW_CHECK_EQ(inlier_masks[i].size(), points2D[i].size());
+  }
+
+  const bool refine_cameras = refinement_options.refine_focal_length ||
+                              refinement_options.refine_extra_params;
+  std::vector<Rigid3d> cams_from_world = init_cams_from_world;
+  std::vector<Camera> refined_cameras;
+  if (refine_cameras) {
+    refined_cameras.reserve(num_poses);
+    for (size_t i = 0; i < num_poses; ++i) {
+      refined_cameras.push_back(cameras[cameras.size() == 1 ? 0 : i]);
+    }
+  }
+  std::vector<char> successes(num_poses, false);
+  py::array_t<double> covariances;
+  if (return_covariance) {
+    covariances = py::array_t<double>(std::vector<size_t>{num_poses, 6, 6});
+  }
+  double* covariances_data =
+      return_covariance ? covariances.mutable_data() : nullptr;
+
+  {
+    py::gil_scoped_release release;
+    ParallelFor(
+        num_poses, num_threads, [&](size_t, size_t begin, size_t end) {
+          // Buffers reused by all the poses of a worker.
+          std::vector<char> inlier_mask_char;
+          Camera camera;
+          Eigen::Matrix<double, 6, 6> covariance;
+          for (size_t i = begin; i < end; ++i) {
+            SetPRNGSeed(0);
+            inlier_mask_char.assign(inlier_masks[i].begin(),
+                                    inlier_masks[i].end());
+            Camera* refined_camera = &camera;
+            if (refine_cameras) {
+              refined_camera = &refined_cameras[i];
+            } else if (i == begin || cameras.size() > 1) {
+              camera = cameras[cameras.size() == 1 ? 0 : i];
+            }
+            successes[i] = RefineAbsolutePose(
+                refinement_options,
+                inlier_mask_char,
+                points2D[i],
+                points3D[i],
+                &cams_from_world[i],
+                refined_camera,
+                return_covariance ? &covariance : nullptr);
+            if (return_covariance) {
+              if (!successes[i]) {
+                covariance.setConstant(
+                    std::numeric_limits<double>::quiet_NaN());
+              }
+              // The covariance is symmetric, so its storage order does not
+              // matter.
+              std::copy(covariance.data(),
+                        covariance.data() + 36,
+                        covariances_data + 36 * i);
+            }
+          }
+        });
+  }
+
+  // Failed refinements keep their initial pose.
+  for (size_t i = 0; i < num_poses; ++i) {
+    if (!successes[i]) {
+      cams_from_world[i] = init_cams_from_world[i];
+    }
+  }
+
+  py::dict output("success"_a = std::vector<bool>(successes.begin(),
+                                                  successes.end()),
+                  "cams_from_world"_a = cams_from_world);
+  if (refine_cameras) output["cameras"] = refined_cameras;
+  if (return_covariance) output["covariances"] = covariances;
+  return output;
 }
 
 void bind_absolute_pose_estimation(py::module& m,
@@ -182,6 +572,10 @@ void bind_absolute_pose_estimation(py::module& m,
                          &AbsolutePoseEstimationOptions::min_focal_length_ratio)
           .def_readwrite("max_focal_length_ratio",
                          &AbsolutePoseEstimationOptions::max_focal_length_ratio)
+          .def_readwrite("num_threads",
+                         &AbsolutePoseEstimationOptions::num_threads,
+                         "Number of threads over which the focal length "
+                         "samples are distributed.")
           .def_readwrite("ransac",
                          &AbsolutePoseEstimationOptions::ransac_options);
   make_dataclass(PyEstimationOptions);
@@ -214,20 +608,59 @@ void bind_absolute_pose_estimation(py::module& m,
   auto ref_options =
       PyRefinementOptions().cast<AbsolutePoseRefinementOptions>();
 
+  auto PySweepOptions =
+      py::class_<FocalLengthSweepOptions>(m, "FocalLengthSweepOptions")
+          .def(py::init<>())
+          .def_readwrite("coarse_to_fine",
+                         &FocalLengthSweepOptions::coarse_to_fine,
+                         "Whether to refine around the best of "
+                         "num_coarse_samples samples instead\n"
+                         "of evaluating num_focal_length_samples samples.")
+          .def_readwrite("num_coarse_samples",
+                         &FocalLengthSweepOptions::num_coarse_samples)
+          .def_readwrite("num_fine_samples",
+                         &FocalLengthSweepOptions::num_fine_samples)
+          .def_readwrite("saturation_inlier_ratio",
+                         &FocalLengthSweepOptions::saturation_inlier_ratio,
+                         "Skip the fine samples if the best coarse sample "
+                         "has at least this\n"
+                         "ratio of inliers.");
+  make_dataclass(PySweepOptions);
+  auto sweep_options = PySweepOptions().cast<FocalLengthSweepOptions>();
+
+  const char* kAbsolutePoseEstimationDoc =
+      "Absolute pose estimation with non-linear refinement.\n\n"
+      "With num_threads != 1 (-1 for all cores), the RANSAC hypotheses are\n"
+      "scored in parallel batches. The result is then independent of\n"
+      "num_threads but may differ from the sequential estimate with\n"
+      "num_threads=1. With estimate_focal_length, the focal length samples\n"
+      "are evaluated on estimation_options.num_threads threads, optionally\n"
+      "coarse to fine as configured by focal_length_sweep_options.\n\n"
+      "If the direction of gravity in the camera frame is given, the\n"
+      "2-point solver for known gravity replaces P3P. gravity_world is the\n"
+      "direction of gravity in the world frame, by default -z.";
   m.def("absolute_pose_estimation",
         static_cast<py::dict (*)(const std::vector<Eigen::Vector2d>,
                                  const std::vector<Eigen::Vector3d>,
                                  Camera&,
                                  const AbsolutePoseEstimationOptions,
                                  const AbsolutePoseRefinementOptions,
-                                 bool)>(&absolute_pose_estimation),
+                                 bool,
+                                 int,
+                                 FocalLengthSweepOptions,
+                                 py::object,
+                                 Eigen::Vector3d)>(&absolute_pose_estimation),
         "points2D"_a,
         "points3D"_a,
         "camera"_a,
         "estimation_options"_a = est_options,
         "refinement_options"_a = ref_options,
         "return_covariance"_a = false,
-        "Absolute pose estimation with non-linear refinement.");
+        "num_threads"_a = 1,
+        "focal_length_sweep_options"_a = sweep_options,
+        "gravity"_a = py::none(),
+        "gravity_world"_a = Eigen::Vector3d(0, 0, -1),
+        kAbsolutePoseEstimationDoc);
 
   m.def("absolute_pose_estimation",
         static_cast<py::dict (*)(const std::vector<Eigen::Vector2d>,
@@ -238,7 +671,8 @@ void bind_absolute_pose_estimation(py::module& m,
                                  const int,
                                  const int,
                                  const double,
-                                 const bool)>(&absolute_pose_estimation),
+                                 const bool,
+                                 const int)>(&absolute_pose_estimation),
         "points2D"_a,
         "points3D"_a,
         "camera"_a,
@@ -248,7 +682,8 @@ void bind_absolute_pose_estimation(py::module& m,
         "max_num_trials"_a = est_options.ransac_options.max_num_trials,
         "confidence"_a = est_options.ransac_options.confidence,
         "return_covariance"_a = false,
-        "Absolute pose estimation with non-linear refinement.");
+        "num_threads"_a = 1,
+        kAbsolutePoseEstimationDoc);
 
   m.def("pose_refinement",
         &pose_refinement,
@@ -258,5 +693,23 @@ void bind_absolute_pose_estimation(py::module& m,
         "inlier_mask"_a,
         "camera"_a,
         "refinement_options"_a = ref_options,
+        "return_covariance"_a = false,
         "Non-linear refinement of absolute pose.");
+
+  m.def("pose_refinement_batch",
+        &pose_refinement_batch,
+        "cams_from_world"_a,
+        "points2D"_a,
+        "points3D"_a,
+        "inlier_masks"_a,
+        "cameras"_a,
+        "refinement_options"_a = ref_options,
+        "return_covariance"_a = false,
+        "num_threads"_a = -1,
+        "Non-linear refinement of a batch of absolute poses on num_threads\n"
+        "threads. The cameras are given either per pose or as a single\n"
+        "shared camera. Returns a dict with the per-pose success flags and\n"
+        "refined cams_from_world (failures keep their initial pose), the\n"
+        "refined cameras if the intrinsics are refined, and the covariances\n"
+        "as an Nx6x6 array (NaN for failures) if return_covariance.");
 }
@@ -5,16 +5,27 @@
 #include "colmap/estimators/similarity_transform.h"
 #include "colmap/exe/model.h"
 #include "colmap/geometry/sim3.h"
+#include "colmap/math/math.h"
 #include "colmap/optim/loransac.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/ply.h"
+#include "colmap/util/timer.h"
 #include "colmap/util/types.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 using namespace colmap;
 
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
@@ -22,9 +33,352 @@ using namespace colmap;
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+#include "estimators/parallel_loransac.h"
 #include "log_exceptions.h"
+#include "utils.h"
+
+// Result of a robust similarity alignment with the duration in seconds of its
+// phases: building the name index, gathering the correspondences, and RANSAC.
+struct SimilarityAlignment {
+  bool success = false;
+  Sim3d tgt_from_src;
+  size_t num_correspondences = 0;
+  size_t num_inliers = 0;
+  double index_time = 0;
+  double correspondences_time = 0;
+  double ransac_time = 0;
+};
+
+py::dict SimilarityAlignmentToDict(const SimilarityAlignment& alignment) {
+  return py::dict(
+      "tgt_from_src"_a = alignment.tgt_from_src,
+      "num_correspondences"_a = alignment.num_correspondences,
+      "num_inliers"_a = alignment.num_inliers,
+      "timings"_a = py::dict("index"_a = alignment.index_time,
+                             "correspondences"_a =
+                                 alignment.correspondences_time,
+                             "ransac"_a = alignment.ransac_time));
+}
+
+std::unordered_map<std::string, image_t> RegImageIdsByName(
+    const Reconstruction& reconstruction) {
+  std::unordered_map<std::string, image_t> image_ids;
+  image_ids.reserve(reconstruction.NumRegImages());
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    image_ids.emplace(reconstruction.Image(image_id).Name(), image_id);
+  }
+  return image_ids;
+}
+
+// Pairs of ids of the images registered in both reconstructions, matched by
+// name through an index of the target images instead of the linear search of
+// Reconstruction::FindImageWithName. The pairs are in the order of
+// src.RegImageIds().
+std::vector<std::pair<image_t, image_t>> FindCommonRegImages(
+    const Reconstruction& src,
+    const std::unordered_map<std::string, image_t>& tgt_image_ids,
+    const int num_threads) {
+  const std::vector<image_t>& src_image_ids = src.RegImageIds();
+  std::vector<std::vector<std::pair<image_t, image_t>>> chunk_pairs(
+      NumParallelChunks(src_image_ids.size(), num_threads));
+  ParallelFor(src_image_ids.size(),
+              num_threads,
+              [&](size_t chunk_idx, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                  const auto it = tgt_image_ids.find(
+                      src.Image(src_image_ids[i]).Name());
+                  if (it != tgt_image_ids.end()) {
+                    chunk_pairs[chunk_idx].emplace_back(src_image_ids[i],
+                                                        it->second);
+                  }
+                }
+              });
+  std::vector<std::pair<image_t, image_t>> pairs;
+  for (const auto& pairs_of_chunk : chunk_pairs) {
+    pairs.insert(pairs.end(), pairs_of_chunk.begin(), pairs_of_chunk.end());
+  }
+  return pairs;
+}
+
+// Robust similarity estimation with a parallel LORANSAC. Successful if at
+// least min_num_inliers correspondences are inliers.
+void EstimateSimilarity(const std::vector<Eigen::Vector3d>& src,
+                        const std::vector<Eigen::Vector3d>& tgt,
+                        const RANSACOptions& ransac_options,
+                        const size_t min_num_inliers,
+                        const int num_threads,
+                        SimilarityAlignment* alignment) {
+  Timer timer;
+  timer.Start();
+  alignment->num_correspondences = src.size();
+  ParallelLORANSAC<SimilarityTransformEstimator<3, true>,
+                   SimilarityTransformEstimator<3, true>>
+      ransac(ransac_options, num_threads);
+  const auto report = ransac.Estimate(src, tgt);
+  alignment->num_inliers = report.support.num_inliers;
+  alignment->success =
+      report.success && report.support.num_inliers >= min_num_inliers;
+  if (alignment->success) {
+    alignment->tgt_from_src = Sim3d::FromMatrix(report.model);
+  }
+  alignment->ransac_time = timer.ElapsedSeconds();
+}
+
+// Same as AlignReconstructionToLocations.
+SimilarityAlignment AlignToLocations(
+    const Reconstruction& src,
+    const std::vector<std::string>& image_names,
+    const std::vector<Eigen::Vector3d>& locations,
+    const int min_common_images,
+    const RANSACOptions& ransac_options,
+    const int num_threads) {
+  THROW_CHECK_EQ(image_names.size(), locations.size());
+  SimilarityAlignment alignment;
+  Timer timer;
+  timer.Start();
+  const std::unordered_map<std::string, image_t> src_image_ids =
+      RegImageIdsByName(src);
+  alignment.index_time = timer.ElapsedSeconds();
+
+  timer.Restart();
+  std::vector<Eigen::Vector3d> src_locations;
+  std::vector<Eigen::Vector3d> tgt_locations;
+  for (size_t i = 0; i < image_names.size(); ++i) {
+    const auto it = src_image_ids.find(image_names[i]);
+    if (it != src_image_ids.end()) {
+      src_locations.push_back(src.Image(it->second).ProjectionCenter());
+      tgt_locations.push_back(locations[i]);
+    }
+  }
+  alignment.correspondences_time = timer.ElapsedSeconds();
+
+  if (src_locations.size() < static_cast<size_t>(min_common_images)) {
+    alignment.num_correspondences = src_locations.size();
+    return alignment;
+  }
+  EstimateSimilarity(src_locations,
+                     tgt_locations,
+                     ransac_options,
+                     min_common_images,
+                     num_threads,
+                     &alignment);
+  return alignment;
+}
+
+// Same as AlignReconstructionsViaProjCenters.
+SimilarityAlignment AlignViaProjCenters(const Reconstruction& src,
+                                        const Reconstruction& tgt,
+                                        const double max_proj_center_error,
+                                        const int num_threads) {
+  SimilarityAlignment alignment;
+  Timer timer;
+  timer.Start();
+  const std::unordered_map<std::string, image_t> tgt_image_ids =
+      RegImageIdsByName(tgt);
+  alignment.index_time = timer.ElapsedSeconds();
+
+  timer.Restart();
+  const std::vector<std::pair<image_t, image_t>> common_image_ids =
+      FindCommonRegImages(src, tgt_image_ids, num_threads);
+  std::vector<Eigen::Vector3d> src_proj_centers(common_image_ids.size());
+  std::vector<Eigen::Vector3d> tgt_proj_centers(common_image_ids.size());
+  for (size_t i = 0; i < common_image_ids.size(); ++i) {
+    src_proj_centers[i] =
+        src.Image(common_image_ids[i].first).ProjectionCenter();
+    tgt_proj_centers[i] =
+        tgt.Image(common_image_ids[i].second).ProjectionCenter();
+  }
+  alignment.correspondences_time = timer.ElapsedSeconds();
+
+  const size_t kMinCommonImages = 3;
+  if (common_image_ids.size() < kMinCommonImages) {
+    alignment.num_correspondences = common_image_ids.size();
+    return alignment;
+  }
+  RANSACOptions ransac_options;
+  ransac_options.max_error = max_proj_center_error;
+  EstimateSimilarity(src_proj_centers,
+                     tgt_proj_centers,
+                     ransac_options,
+                     kMinCommonImages,
+                     num_threads,
+                     &alignment);
+  return alignment;
+}
+
+// Same as AlignReconstructionsViaPoints: each 3D point of the source is
+// matched to the target 3D point observed by most of its observations in the
+// common images. The source points are distributed over threads by hash
+// bucket and the correspondences of each thread are concatenated in bucket
+// order, which is independent of the number of threads.
+SimilarityAlignment AlignViaPoints(const Reconstruction& src,
+                                   const Reconstruction& tgt,
+                                   const size_t min_common_observations,
+                                   const double max_error,
+                                   const double min_inlier_ratio,
+                                   const int num_threads) {
+  SimilarityAlignment alignment;
+  Timer timer;
+  timer.Start();
+  const std::unordered_map<std::string, image_t> tgt_image_ids =
+      RegImageIdsByName(tgt);
+  alignment.index_time = timer.ElapsedSeconds();
+
+  timer.Restart();
+  std::unordered_map<image_t, const Image*> tgt_images;
+  for (const auto& image_ids :
+       FindCommonRegImages(src, tgt_image_ids, num_threads)) {
+    tgt_images.emplace(image_ids.first, &tgt.Image(image_ids.second));
+  }
+
+  const size_t num_chunks =
+      NumParallelChunks(src.Points3D().bucket_count(), num_threads);
+  std::vector<std::vector<Eigen::Vector3d>> chunk_src_xyz(num_chunks);
+  std::vector<std::vector<Eigen::Vector3d>> chunk_tgt_xyz(num_chunks);
+  std::vector<std::vector<std::pair<point3D_t, size_t>>> chunk_counts(
+      num_chunks);
+  ParallelForEachInMap(
+      src.Points3D(), num_threads, [&](size_t chunk_idx, const auto& point3D) {
+        // Tracks are short, so a vector is faster than a hash map.
+        std::vector<std::pair<point3D_t, size_t>>& counts =
+            chunk_counts[chunk_idx];
+        counts.clear();
+        for (const auto& track_el : point3D.second.Track().Elements()) {
+          const auto it = tgt_images.find(track_el.image_id);
+          if (it == tgt_images.end()) {
+            continue;
+          }
+          const Point2D& point2D = it->second->Point2D(track_el.point2D_idx);
+          if (!point2D.HasPoint3D()) {
+            continue;
+          }
+          auto count_it = std::find_if(
+              counts.begin(),
+              counts.end(),
+              [&point2D](const std::pair<point3D_t, size_t>& count) {
+                return count.first == point2D.point3D_id;
+              });
+          if (count_it == counts.end()) {
+            counts.emplace_back(point2D.point3D_id, 1);
+          } else {
+            ++count_it->second;
+          }
+        }
+        if (counts.empty()) {
+          return;
+        }
+        const auto best = std::max_element(
+            counts.begin(),
+            counts.end(),
+            [](const std::pair<point3D_t, size_t>& count1,
+               const std::pair<point3D_t, size_t>& count2) {
+              return count1.second < count2.second;
+            });
+        if (best->second >= min_common_observations) {
+          chunk_src_xyz[chunk_idx].push_back(point3D.second.XYZ());
+          chunk_tgt_xyz[chunk_idx].push_back(tgt.Point3D(best->first).XYZ());
+        }
+      });
+  std::vector<Eigen::Vector3d> src_xyz;
+  std::vector<Eigen::Vector3d> tgt_xyz;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    src_xyz.insert(
+        src_xyz.end(), chunk_src_xyz[i].begin(), chunk_src_xyz[i].end());
+    tgt_xyz.insert(
+        tgt_xyz.end(), chunk_tgt_xyz[i].begin(), chunk_tgt_xyz[i].end());
+  }
+  alignment.correspondences_time = timer.ElapsedSeconds();
+
+  RANSACOptions ransac_options;
+  ransac_options.max_error = max_error;
+  ransac_options.min_inlier_ratio = min_inlier_ratio;
+  EstimateSimilarity(
+      src_xyz, tgt_xyz, ransac_options, 0, num_threads, &alignment);
+  return alignment;
+}
+
+// Per-image errors of an alignment, in the order of src.RegImageIds().
+struct AlignmentErrors {
+  std::vector<image_t> image_ids;
+  Eigen::VectorXd rotation_errors_deg;
+  Eigen::VectorXd proj_center_errors;
+};
+
+// Same as ComputeImageAlignmentError, with the common images found through an
+// index of the target images and the errors computed in parallel.
+AlignmentErrors ComputeAlignmentErrors(const Reconstruction& src,
+                                       const Reconstruction& tgt,
+                                       const Sim3d& tgt_from_src,
+                                       const int num_threads) {
+  const std::vector<std::pair<image_t, image_t>> common_image_ids =
+      FindCommonRegImages(src, RegImageIdsByName(tgt), num_threads);
+  AlignmentErrors errors;
+  errors.image_ids.resize(common_image_ids.size());
+  errors.rotation_errors_deg.resize(common_image_ids.size());
+  errors.proj_center_errors.resize(common_image_ids.size());
+  ParallelFor(
+      common_image_ids.size(),
+      num_threads,
+      [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          const Image& src_image = src.Image(common_image_ids[i].first);
+          const Image& tgt_image = tgt.Image(common_image_ids[i].second);
+          const Rigid3d src_cam_from_tgt_world =
+              TransformCameraWorld(tgt_from_src, src_image.CamFromWorld());
+          errors.image_ids[i] = common_image_ids[i].first;
+          errors.rotation_errors_deg(i) =
+              RadToDeg(src_cam_from_tgt_world.rotation.angularDistance(
+                  tgt_image.CamFromWorld().rotation));
+          errors.proj_center_errors(i) =
+              (Inverse(src_cam_from_tgt_world).translation -
+               tgt_image.ProjectionCenter())
+                  .norm();
+        }
+      });
+  return errors;
+}
+
+// Mean, maximum, and percentiles of the errors, with a linear interpolation
+// between the closest ranks as in numpy.percentile.
+py::dict SummarizeErrors(const Eigen::VectorXd& errors) {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  if (errors.size() == 0) {
+    return py::dict("mean"_a = nan,
+                    "max"_a = nan,
+                    "p50"_a = nan,
+                    "p75"_a = nan,
+                    "p90"_a = nan,
+                    "p95"_a = nan,
+                    "p99"_a = nan);
+  }
+  std::vector<double> sorted_errors(errors.data(),
+                                    errors.data() + errors.size());
+  std::sort(sorted_errors.begin(), sorted_errors.end());
+  const auto Percentile = [&sorted_errors](const double percentile) {
+    const double rank = percentile / 100 * (sorted_errors.size() - 1);
+    const size_t lower = static_cast<size_t>(std::floor(rank));
+    const size_t upper = std::min(lower + 1, sorted_errors.size() - 1);
+    return sorted_errors[lower] +
+           (rank - lower) * (sorted_errors[upper] - sorted_errors[lower]);
+  };
+  return py::dict("mean"_a = errors.mean(),
+                  "max"_a = sorted_errors.back(),
+                  "p50"_a = Percentile(50),
+                  "p75"_a = Percentile(75),
+                  "p90"_a = Percentile(90),
+                  "p95"_a = Percentile(95),
+                  "p99"_a = Percentile(99));
+}
 
 void bind_alignment(py::module& m) {
+  const char* kAlignmentDoc =
+      "Robust similarity alignment. The images are matched by name through a\n"
+      "hash index, the correspondences are gathered on num_threads threads,\n"
+      "and the hypotheses of RANSAC are scored in parallel. Returns the\n"
+      "tgt_from_src Sim3d or, if return_details, a dict with tgt_from_src,\n"
+      "num_correspondences, num_inliers, and the timings in seconds of the\n"
+      "index, correspondences, and ransac phases.";
+
   py::class_<ImageAlignmentError>(m, "ImageAlignmentError")
       .def(py::init<>())
       .def_readwrite("image_name", &ImageAlignmentError::image_name)
@@ -59,18 +413,30 @@ void bind_alignment(py::module& m) {
       "align_reconstructions_via_proj_centers",
       [](const Reconstruction& src_reconstruction,
          const Reconstruction& tgt_reconstruction,
-         const double max_proj_center_error) {
+         const double max_proj_center_error,
+         const int num_threads,
+         const bool return_details) -> py::object {
         THROW_CHECK_GT(max_proj_center_error, 0.0);
-        Sim3d tgt_from_src;
-        THROW_CHECK(AlignReconstructionsViaProjCenters(src_reconstruction,
-                                                       tgt_reconstruction,
-                                                       max_proj_center_error,
-                                                       &tgt_from_src));
-        return tgt_from_src;
+        SimilarityAlignment alignment;
+        {
+          py::gil_scoped_release release;
+          alignment = AlignViaProjCenters(src_reconstruction,
+                                          tgt_reconstruction,
+                                          max_proj_center_error,
+                                          num_threads);
+        }
+        THROW_CHECK(alignment.success);
+        if (return_details) {
+          return SimilarityAlignmentToDict(alignment);
+        }
+        return py::cast(alignment.tgt_from_src);
       },
       "src_reconstruction"_a,
       "tgt_reconstruction"_a,
-      "max_proj_center_error"_a);
+      "max_proj_center_error"_a,
+      "num_threads"_a = -1,
+      "return_details"_a = false,
+      kAlignmentDoc);
 
   m.def(
       "align_reconstructions_via_points",
@@ -78,25 +444,37 @@ void bind_alignment(py::module& m) {
          const Reconstruction& tgt_reconstruction,
          const size_t min_common_observations,
          const double max_error,
-         const double min_inlier_ratio) {
+         const double min_inlier_ratio,
+         const int num_threads,
+         const bool return_details) -> py::object {
         THROW_CHECK_GT(min_common_observations, 0);
         THROW_CHECK_GT(max_error, 0.0);
         THROW_CHECK_GE(min_inlier_ratio, 0.0);
         THROW_CHECK_LE(min_inlier_ratio, 1.0);
-        Sim3d tgt_from_src;
-        THROW_CHECK(AlignReconstructionsViaPoints(src_reconstruction,
-                                                  tgt_reconstruction,
-                                                  min_common_observations,
-                                                  max_error,
-                                                  min_inlier_ratio,
-                                                  &tgt_from_src));
-        return tgt_from_src;
+        SimilarityAlignment alignment;
+        {
+          py::gil_scoped_release release;
+          alignment = AlignViaPoints(src_reconstruction,
+                                     tgt_reconstruction,
+                                     min_common_observations,
+                                     max_error,
+                                     min_inlier_ratio,
+                                     num_threads);
+        }
+        THROW_CHECK(alignment.success);
+        if (return_details) {
+          return SimilarityAlignmentToDict(alignment);
+        }
+        return py::cast(alignment.tgt_from_src);
       },
       "src_reconstruction"_a,
       "tgt_reconstruction"_a,
       "min_common_observations"_a = 3,
       "max_error"_a = 0.005,
-      "min_inlier_ratio"_a = 0.9);
+      "min_inlier_ratio"_a = 0.9,
+      "num_threads"_a = -1,
+      "return_details"_a = false,
+      kAlignmentDoc);
 
   m.def(
       "align_reconstrution_to_locations",
@@ -104,23 +482,35 @@ void bind_alignment(py::module& m) {
          const std::vector<std::string>& image_names,
          const std::vector<Eigen::Vector3d>& locations,
          const int min_common_images,
-         const RANSACOptions& ransac_options) {
+         const RANSACOptions& ransac_options,
+         const int num_threads,
+         const bool return_details) -> py::object {
         THROW_CHECK_GE(min_common_images, 3);
         THROW_CHECK_EQ(image_names.size(), locations.size());
-        Sim3d locationsFromSrc;
-        THROW_CHECK(AlignReconstructionToLocations(src,
-                                                   image_names,
-                                                   locations,
-                                                   min_common_images,
-                                                   ransac_options,
-                                                   &locationsFromSrc));
-        return locationsFromSrc;
+        SimilarityAlignment alignment;
+        {
+          py::gil_scoped_release release;
+          alignment = AlignToLocations(src,
+                                       image_names,
+                                       locations,
+                                       min_common_images,
+                                       ransac_options,
+                                       num_threads);
+        }
+        THROW_CHECK(alignment.success);
+        if (return_details) {
+          return SimilarityAlignmentToDict(alignment);
+        }
+        return py::cast(alignment.tgt_from_src);
       },
       "src"_a,
       "image_names"_a,
       "locations"_a,
       "min_common_points"_a,
-      "ransac_options"_a);
+      "ransac_options"_a,
+      "num_threads"_a = -1,
+      "return_details"_a = false,
+      kAlignmentDoc);
 
   m.def(
       "compare_reconstructions",
@@ -129,26 +519,111 @@ void bind_alignment(py::module& m) {
          const std::string& alignment_error,
          double min_inlier_observations,
          double max_reproj_error,
-         double max_proj_center_error) {
-        std::vector<ImageAlignmentError> errors;
+         double max_proj_center_error,
+         const int num_threads,
+         const bool return_image_names,
+         const bool return_error_objects) {
+        AlignmentErrors errors;
         Sim3d rec2_from_rec1;
-        THROW_CUSTOM_CHECK_MSG(CompareModels(reconstruction1,
-                                             reconstruction2,
-                                             alignment_error,
-                                             min_inlier_observations,
-                                             max_reproj_error,
-                                             max_proj_center_error,
-                                             errors,
-                                             rec2_from_rec1),
-                               std::runtime_error,
-                               "=> Reconstruction alignment failed.");
-        return py::dict("rec2_from_rec1"_a = rec2_from_rec1,
-                        "errors"_a = errors);
+        double alignment_time = 0;
+        double errors_time = 0;
+        {
+          py::gil_scoped_release release;
+          Timer timer;
+          timer.Start();
+          bool success = false;
+          if (alignment_error == "reprojection") {
+            success = AlignReconstructionsViaReprojections(
+                reconstruction1,
+                reconstruction2,
+                min_inlier_observations,
+                max_reproj_error,
+                &rec2_from_rec1);
+          } else if (alignment_error == "proj_center") {
+            const SimilarityAlignment alignment =
+                AlignViaProjCenters(reconstruction1,
+                                    reconstruction2,
+                                    max_proj_center_error,
+                                    num_threads);
+            success = alignment.success;
+            rec2_from_rec1 = alignment.tgt_from_src;
+          } else {
+            THROW_EXCEPTION(std::invalid_argument,
+                            "Invalid alignment_error: " + alignment_error);
+          }
+          THROW_CUSTOM_CHECK_MSG(success,
+                                 std::runtime_error,
+                                 "=> Reconstruction alignment failed.");
+          alignment_time = timer.ElapsedSeconds();
+
+          timer.Restart();
+          errors = ComputeAlignmentErrors(
+              reconstruction1, reconstruction2, rec2_from_rec1, num_threads);
+          errors_time = timer.ElapsedSeconds();
+        }
+
+        py::dict output(
+            "rec2_from_rec1"_a = rec2_from_rec1,
+            "image_ids"_a = py::array_t<image_t>(errors.image_ids.size(),
+                                                 errors.image_ids.data()),
+            "rotation_errors_deg"_a = errors.rotation_errors_deg,
+            "proj_center_errors"_a = errors.proj_center_errors,
+            "summary"_a = py::dict(
+                "num_common_images"_a = errors.image_ids.size(),
+                "rotation_error_deg"_a =
+                    SummarizeErrors(errors.rotation_errors_deg),
+                "proj_center_error"_a =
+                    SummarizeErrors(errors.proj_center_errors)),
+            "timings"_a = py::dict("alignment"_a = alignment_time,
+                                   "errors"_a = errors_time));
+        if (return_image_names || return_error_objects) {
+          std::vector<std::string> image_names;
+          image_names.reserve(errors.image_ids.size());
+          for (const image_t image_id : errors.image_ids) {
+            image_names.push_back(reconstruction1.Image(image_id).Name());
+          }
+          if (return_error_objects) {
+            if (PyErr_WarnEx(PyExc_DeprecationWarning,
+                             "The list of ImageAlignmentError objects in "
+                             "'errors' is deprecated and will not be "
+                             "returned by default in a future release. Use "
+                             "the rotation_errors_deg and proj_center_errors "
+                             "arrays, or pass return_error_objects=False.",
+                             1) != 0) {
+              throw py::error_already_set();
+            }
+            std::vector<ImageAlignmentError> error_objects(
+                errors.image_ids.size());
+            for (size_t i = 0; i < error_objects.size(); ++i) {
+              error_objects[i].image_name = image_names[i];
+              error_objects[i].rotation_error_deg =
+                  errors.rotation_errors_deg(i);
+              error_objects[i].proj_center_error =
+                  errors.proj_center_errors(i);
+            }
+            output["errors"] = error_objects;
+          }
+          if (return_image_names) output["image_names"] = image_names;
+        }
+        return output;
       },
       "reconstruction1"_a,
       "reconstruction2"_a,
       "alignment_error"_a = "reprojection",
       "min_inlier_observations"_a = 0.3,
       "max_reproj_error"_a = 8.0,
-      "max_proj_center_error"_a = 0.1);
+      "max_proj_center_error"_a = 0.1,
+      "num_threads"_a = -1,
+      "return_image_names"_a = false,
+      "return_error_objects"_a = true,
+      "Align reconstruction1 to reconstruction2 and compare the poses of\n"
+      "their common registered images, matched by name. Returns a dict\n"
+      "with rec2_from_rec1, the ids in reconstruction1 of the common\n"
+      "images, their rotation_errors_deg and proj_center_errors arrays, a\n"
+      "summary with the mean, max, and percentiles of the errors, and the\n"
+      "timings in seconds. The image names are only returned on demand.\n"
+      "The list of ImageAlignmentError objects in errors is deprecated: it\n"
+      "is still returned by default, with a DeprecationWarning, but will\n"
+      "only be returned with return_error_objects=True in a future\n"
+      "release.");
 }
@@ -20,6 +20,7 @@ using namespace colmap;
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+#include "estimators/parallel_loransac.h"
 #include "log_exceptions.h"
 
 py::dict essential_matrix_estimation(
@@ -27,7 +28,8 @@ py::dict essential_matrix_estimation(
     const std::vector<Eigen::Vector2d> points2D2,
     Camera& camera1,
     Camera& camera2,
-    const RANSACOptions options) {
+    const RANSACOptions options,
+    const int num_threads) {
   SetPRNGSeed(0);
 
   // Check that both vectors have the same size.
@@ -55,21 +57,34 @@ py::dict essential_matrix_estimation(
   RANSACOptions ransac_options(options);
   ransac_options.max_error = max_error;
 
-  LORANSAC<EssentialMatrixFivePointEstimator, EssentialMatrixFivePointEstimator>
-      ransac(ransac_options);
-
   // Essential matrix estimation.
-  const auto report = ransac.Estimate(world_points2D1, world_points2D2);
-
-  if (!report.success) {
-    return failure_dict;
+  Eigen::Matrix3d E;
+  size_t num_inliers;
+  std::vector<char> inlier_mask;
+  if (num_threads == 1) {
+    LORANSAC<EssentialMatrixFivePointEstimator,
+             EssentialMatrixFivePointEstimator>
+        ransac(ransac_options);
+    const auto report = ransac.Estimate(world_points2D1, world_points2D2);
+    if (!report.success) {
+      return failure_dict;
+    }
+    E = report.model;
+    num_inliers = report.support.num_inliers;
+    inlier_mask = report.inlier_mask;
+  } else {
+    ParallelLORANSAC<EssentialMatrixFivePointEstimator,
+                     EssentialMatrixFivePointEstimator>
+        ransac(ransac_options, num_threads);
+    const auto report = ransac.Estimate(world_points2D1, world_points2D2);
+    if (!report.success) {
+      return failure_dict;
+    }
+    E = report.model;
+    num_inliers = report.support.num_inliers;
+    inlier_mask = report.inlier_mask;
   }
 
-  // Recover data from report.
-  const Eigen::Matrix3d E = report.model;
-  const size_t num_inliers = report.support.num_inliers;
-  const auto inlier_mask = report.inlier_mask;
-
   // Pose from essential matrix.
   std::vector<Eigen::Vector2d> inlier_world_points2D1;
   std::vector<Eigen::Vector2d> inlier_world_points2D2;
@@ -121,7 +136,8 @@ py::dict essential_matrix_estimation(
     const double min_inlier_ratio,
     const int min_num_trials,
     const int max_num_trials,
-    const double confidence) {
+    const double confidence,
+    const int num_threads) {
   RANSACOptions ransac_options;
   ransac_options.max_error = max_error_px;
   ransac_options.min_inlier_ratio = min_inlier_ratio;
@@ -129,10 +145,15 @@ py::dict essential_matrix_estimation(
   ransac_options.max_num_trials = max_num_trials;
   ransac_options.confidence = confidence;
   return essential_matrix_estimation(
-      points2D1, points2D2, camera1, camera2, ransac_options);
+      points2D1, points2D2, camera1, camera2, ransac_options, num_threads);
 }
 
 void bind_essential_matrix_estimation(py::module& m) {
+  const char* kEssentialMatrixEstimationDoc =
+      "LORANSAC + 5-point algorithm.\n\n"
+      "With num_threads != 1 (-1 for all cores), the hypotheses are scored\n"
+      "in parallel batches. The result is then independent of num_threads\n"
+      "but may differ from the sequential estimate with num_threads=1.";
   auto est_options = m.attr("RANSACOptions")().cast<RANSACOptions>();
 
   m.def("essential_matrix_estimation",
@@ -140,14 +161,15 @@ void bind_essential_matrix_estimation(py::module& m) {
                                  const std::vector<Eigen::Vector2d>,
                                  Camera&,
                                  Camera&,
-                                 const RANSACOptions)>(
-            &essential_matrix_estimation),
+                                 const RANSACOptions,
+                                 const int)>(&essential_matrix_estimation),
         "points2D1"_a,
         "points2D2"_a,
         "camera1"_a,
         "camera2"_a,
         "estimation_options"_a = est_options,
-        "LORANSAC + 5-point algorithm.");
+        "num_threads"_a = 1,
+        kEssentialMatrixEstimationDoc);
 
   m.def("essential_matrix_estimation",
         static_cast<py::dict (*)(const std::vector<Eigen::Vector2d>,
@@ -158,7 +180,8 @@ void bind_essential_matrix_estimation(py::module& m) {
                                  const double,
                                  const int,
                                  const int,
-                                 const double)>(&essential_matrix_estimation),
+                                 const double,
+                                 const int)>(&essential_matrix_estimation),
         "points2D1"_a,
         "points2D2"_a,
         "camera1"_a,
@@ -168,5 +191,6 @@ void bind_essential_matrix_estimation(py::module& m) {
         "min_num_trials"_a = est_options.min_num_trials,
         "max_num_trials"_a = est_options.max_num_trials,
         "confidence"_a = est_options.confidence,
-        "LORANSAC + 5-point algorithm.");
+        "num_threads"_a = 1,
+        kEssentialMatrixEstimationDoc);
 }
@@ -10,6 +10,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 using namespace colmap;
 
@@ -21,6 +22,7 @@ namespace py = pybind11;
 using namespace pybind11::literals;
 
 #include "log_exceptions.h"
+#include "utils.h"
 
 py::dict rig_absolute_pose_estimation(
     const std::vector<Eigen::Vector2d>& points2D,
@@ -91,6 +93,126 @@ py::dict rig_absolute_pose_estimation(
   return success_dict;
 }
 
+// Result of a rig pose estimation, converted to a dict once the GIL is held.
+struct RigPoseEstimate {
+  bool success = false;
+  Rigid3d rig_from_world;
+  size_t num_inliers = 0;
+  std::vector<char> inlier_mask;
+  Eigen::Matrix<double, 6, 6> covariance;
+};
+
+py::dict RigPoseEstimateToDict(const RigPoseEstimate& estimate,
+                               const bool return_covariance) {
+  if (!estimate.success) {
+    return py::dict("success"_a = false);
+  }
+  std::vector<bool> inlier_mask_bool(estimate.inlier_mask.begin(),
+                                     estimate.inlier_mask.end());
+  py::dict success_dict("success"_a = true,
+                        "rig_from_world"_a = estimate.rig_from_world,
+                        "num_inliers"_a = estimate.num_inliers,
+                        "inliers"_a = inlier_mask_bool);
+  if (return_covariance) success_dict["covariance"] = estimate.covariance;
+  return success_dict;
+}
+
+// Localizer for a calibrated multi-camera rig. The cameras and rig
+// extrinsics are converted from Python only once. The 2D points are
+// converted to normalized image coordinates by the localizer, so that the
+// generalized estimator runs with identity cameras and the (possibly
+// iterative) undistortion is not repeated inside of RANSAC.
+class RigLocalizer {
+ public:
+  RigLocalizer(const std::vector<Camera>& cameras,
+               const std::vector<Rigid3d>& cams_from_rig)
+      : cameras_(cameras), cams_from_rig_(cams_from_rig) {
+    THROW_CHECK_EQ(cams_from_rig_.size(), cameras_.size());
+    Camera normalized_camera;
+    normalized_camera.SetModelIdFromName("PINHOLE");
+    normalized_camera.SetParams({1, 1, 0, 0});
+    for (const Camera& camera : cameras_) {
+      normalized_camera.SetWidth(camera.Width());
+      normalized_camera.SetHeight(camera.Height());
+      normalized_cameras_.push_back(normalized_camera);
+    }
+  }
+
+  const std::vector<Camera>& Cameras() const { return cameras_; }
+  const std::vector<Rigid3d>& CamsFromRig() const { return cams_from_rig_; }
+
+  // The cameras are passed to the non-linear refinement, which may update
+  // their parameters, and must be initialized from Cameras().
+  RigPoseEstimate Estimate(
+      const std::vector<Eigen::Vector2d>& points2D,
+      const std::vector<Eigen::Vector3d>& points3D,
+      const std::vector<size_t>& camera_idxs,
+      const RANSACOptions& ransac_options,
+      const AbsolutePoseRefinementOptions& refinement_options,
+      const bool return_covariance,
+      std::vector<Camera>* cameras) const {
+    SetPRNGSeed(0);
+    THROW_CHECK_EQ(points2D.size(), points3D.size());
+    THROW_CHECK_EQ(points2D.size(), camera_idxs.size());
+
+    RigPoseEstimate estimate;
+    if (points2D.empty()) {
+      return estimate;
+    }
+
+    // Normalize the points and average the error thresholds of the cameras,
+    // weighted by the number of correspondences, as in
+    // EstimateGeneralizedAbsolutePose.
+    std::vector<double> thresholds(cameras_.size());
+    for (size_t i = 0; i < cameras_.size(); ++i) {
+      thresholds[i] = cameras_[i].CamFromImgThreshold(ransac_options.max_error);
+    }
+    std::vector<Eigen::Vector2d> points2D_in_cam(points2D.size());
+    double threshold_sum = 0;
+    for (size_t i = 0; i < points2D.size(); ++i) {
+      THROW_CHECK_LT(camera_idxs[i], cameras_.size());
+      points2D_in_cam[i] = cameras_[camera_idxs[i]].CamFromImg(points2D[i]);
+      threshold_sum += thresholds[camera_idxs[i]];
+    }
+    RANSACOptions normalized_ransac_options = ransac_options;
+    normalized_ransac_options.max_error = threshold_sum / points2D.size();
+
+    if (!EstimateGeneralizedAbsolutePose(normalized_ransac_options,
+                                         points2D_in_cam,
+                                         points3D,
+                                         camera_idxs,
+                                         cams_from_rig_,
+                                         normalized_cameras_,
+                                         &estimate.rig_from_world,
+                                         &estimate.num_inliers,
+                                         &estimate.inlier_mask)) {
+      return estimate;
+    }
+
+    // Absolute pose refinement.
+    if (!RefineGeneralizedAbsolutePose(
+            refinement_options,
+            estimate.inlier_mask,
+            points2D,
+            points3D,
+            camera_idxs,
+            cams_from_rig_,
+            &estimate.rig_from_world,
+            cameras,
+            return_covariance ? &estimate.covariance : nullptr)) {
+      return estimate;
+    }
+
+    estimate.success = true;
+    return estimate;
+  }
+
+ private:
+  std::vector<Camera> cameras_;
+  std::vector<Rigid3d> cams_from_rig_;
+  std::vector<Camera> normalized_cameras_;
+};
+
 void bind_generalized_absolute_pose_estimation(py::module& m) {
   auto est_options = m.attr("RANSACOptions")().cast<RANSACOptions>();
   auto ref_options = m.attr("AbsolutePoseRefinementOptions")()
@@ -109,4 +231,97 @@ void bind_generalized_absolute_pose_estimation(py::module& m) {
       "return_covariance"_a = false,
       "Absolute pose estimation with non-linear refinement for a multi-camera "
       "rig.");
+
+  py::class_<RigLocalizer>(m, "RigLocalizer")
+      .def(py::init<const std::vector<Camera>&, const std::vector<Rigid3d>&>(),
+           "cameras"_a,
+           "cams_from_rig"_a)
+      .def_property_readonly("cameras", &RigLocalizer::Cameras)
+      .def_property_readonly("cams_from_rig", &RigLocalizer::CamsFromRig)
+      .def(
+          "estimate",
+          [](const RigLocalizer& self,
+             const std::vector<Eigen::Vector2d>& points2D,
+             const std::vector<Eigen::Vector3d>& points3D,
+             const std::vector<size_t>& camera_idxs,
+             const RANSACOptions& ransac_options,
+             const AbsolutePoseRefinementOptions& refinement_options,
+             const bool return_covariance) {
+            RigPoseEstimate estimate;
+            {
+              py::gil_scoped_release release;
+              std::vector<Camera> cameras = self.Cameras();
+              estimate = self.Estimate(points2D,
+                                       points3D,
+                                       camera_idxs,
+                                       ransac_options,
+                                       refinement_options,
+                                       return_covariance,
+                                       &cameras);
+            }
+            return RigPoseEstimateToDict(estimate, return_covariance);
+          },
+          "points2D"_a,
+          "points3D"_a,
+          "camera_idxs"_a,
+          "estimation_options"_a = est_options,
+          "refinement_options"_a = ref_options,
+          "return_covariance"_a = false,
+          "Absolute pose estimation with non-linear refinement of the rig.")
+      .def(
+          "estimate_batch",
+          [](const RigLocalizer& self,
+             const std::vector<std::vector<Eigen::Vector2d>>& points2D,
+             const std::vector<std::vector<Eigen::Vector3d>>& points3D,
+             const std::vector<std::vector<size_t>>& camera_idxs,
+             const RANSACOptions& ransac_options,
+             const AbsolutePoseRefinementOptions& refinement_options,
+             const bool return_covariance,
+             const int num_threads) {
+            THROW_CHECK_EQ(points2D.size(), points3D.size());
+            THROW_CHECK_EQ(points2D.size(), camera_idxs.size());
+            std::vector<RigPoseEstimate> estimates(points2D.size());
+            {
+              py::gil_scoped_release release;
+              const bool refine_cameras =
+                  refinement_options.refine_focal_length ||
+                  refinement_options.refine_extra_params;
+              ParallelFor(
+                  points2D.size(),
+                  num_threads,
+                  [&](size_t, size_t begin, size_t end) {
+                    std::vector<Camera> cameras = self.Cameras();
+                    for (size_t i = begin; i < end; ++i) {
+                      if (refine_cameras && i > begin) {
+                        cameras = self.Cameras();
+                      }
+                      estimates[i] = self.Estimate(points2D[i],
+                                                   points3D[i],
+                                                   camera_idxs[i],
+                                                   ransac_options,
+                                                   refinement_options,
+                                                   return_covariance,
+                                                   &cameras);
+                    }
+                  });
+            }
+            py::list results;
+            for (const RigPoseEstimate& estimate : estimates) {
+              results.append(
+                  RigPoseEstimateToDict(estimate, return_covariance));
+            }
+            return results;
+          },
+          "points2D"_a,
+          "points3D"_a,
+          "camera_idxs"_a,
+          "estimation_options"_a = est_options,
+          "refinement_options"_a = ref_options,
+          "return_covariance"_a = false,
+          "num_threads"_a = -1,
+          "Estimate the rig poses of a batch of frames on num_threads "
+          "threads.\n"
+          "Each frame is given by a list of 2D points, 3D points, and camera\n"
+          "indices. Returns a list of dicts as for estimate, which are\n"
+          "independent of num_threads.");
 }
@@ -0,0 +1,283 @@
+#pragma once
+
+#include "colmap/estimators/absolute_pose.h"
+#include "colmap/estimators/essential_matrix.h"
+#include "colmap/util/eigen_alignment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <Eigen/Geometry>
+#include <Eigen/SVD>
+
+// Rotation that maps the given gravity direction onto the y-axis, which is
+// the (downward) vertical axis of the COLMAP camera convention.
+inline Eigen::Matrix3d GravityAlignedFromFrame(
+    const Eigen::Vector3d& gravity) {
+  return Eigen::Quaterniond::FromTwoVectors(gravity.normalized(),
+                                            Eigen::Vector3d::UnitY())
+      .toRotationMatrix();
+}
+
+// Rotation by the given cosine and sine about the y-axis.
+inline Eigen::Matrix3d RotationAboutGravity(const double c, const double s) {
+  Eigen::Matrix3d rotation;
+  rotation << c, 0, s, 0, 1, 0, -s, 0, c;
+  return rotation;
+}
+
+// Minimal absolute pose solver from 2 correspondences for a known direction
+// of gravity in the camera and the world frame. After aligning both gravity
+// directions with the y-axis, only the rotation angle about gravity and the
+// translation remain unknown. The projection constraints are linear in
+// (cos, sin, t), whose null space is intersected with cos^2 + sin^2 = 1.
+class GravityAbsolutePoseEstimator {
+ public:
+  // The 2D image feature observations in normalized camera coordinates.
+  typedef Eigen::Vector2d X_t;
+  // The observed 3D features in the world frame.
+  typedef Eigen::Vector3d Y_t;
+  // The transformation from the world to the camera frame.
+  typedef Eigen::Matrix3x4d M_t;
+
+  // The minimum number of samples needed to estimate a model.
+  static const int kMinNumSamples = 2;
+
+  GravityAbsolutePoseEstimator()
+      : aligned_from_cam_(Eigen::Matrix3d::Identity()),
+        aligned_from_world_(Eigen::Matrix3d::Identity()) {}
+
+  GravityAbsolutePoseEstimator(const Eigen::Vector3d& gravity_in_cam,
+                               const Eigen::Vector3d& gravity_in_world)
+      : aligned_from_cam_(GravityAlignedFromFrame(gravity_in_cam)),
+        aligned_from_world_(GravityAlignedFromFrame(gravity_in_world)) {}
+
+  void Estimate(const std::vector<X_t>& points2D,
+                const std::vector<Y_t>& points3D,
+                std::vector<M_t>* cams_from_world) const {
+    cams_from_world->clear();
+
+    // Rows of the cross product constraints in the unknowns
+    // (cos, sin, tx, ty, tz, 1) of the gravity-aligned frames.
+    Eigen::Matrix<double, 6, 6> A;
+    for (int i = 0; i < 2; ++i) {
+      const Eigen::Vector3d ray =
+          aligned_from_cam_ * points2D[i].homogeneous();
+      const Eigen::Vector3d point = aligned_from_world_ * points3D[i];
+      Eigen::Matrix<double, 6, 1> qx, qy, qz;
+      qx << point.x(), point.z(), 1, 0, 0, 0;
+      qy << 0, 0, 0, 1, 0, point.y();
+      qz << point.z(), -point.x(), 0, 0, 1, 0;
+      A.row(3 * i) = ray.y() * qz - ray.z() * qy;
+      A.row(3 * i + 1) = ray.z() * qx - ray.x() * qz;
+      A.row(3 * i + 2) = ray.x() * qy - ray.y() * qx;
+    }
+
+    const Eigen::JacobiSVD<Eigen::Matrix<double, 6, 6>> svd(
+        A, Eigen::ComputeFullV);
+    Eigen::Matrix<double, 6, 1> n1 = svd.matrixV().col(4);
+    Eigen::Matrix<double, 6, 1> n2 = svd.matrixV().col(5);
+    if (std::abs(n1(5)) < std::abs(n2(5))) {
+      std::swap(n1, n2);
+    }
+    if (std::abs(n1(5)) < 1e-12) {
+      return;
+    }
+
+    // Solutions v = a * n1 + b * n2 with v(5) = 1 and cos^2 + sin^2 = 1.
+    const double c0 = n1(0) / n1(5);
+    const double s0 = n1(1) / n1(5);
+    const double c1 = n2(0) - n1(0) * n2(5) / n1(5);
+    const double s1 = n2(1) - n1(1) * n2(5) / n1(5);
+    const double qa = c1 * c1 + s1 * s1;
+    const double qb = 2 * (c0 * c1 + s0 * s1);
+    const double qc = c0 * c0 + s0 * s0 - 1;
+
+    std::vector<double> bs;
+    if (std::abs(qa) < 1e-12) {
+      if (std::abs(qb) > 1e-12) {
+        bs.push_back(-qc / qb);
+      }
+    } else {
+      const double discriminant = qb * qb - 4 * qa * qc;
+      if (discriminant >= 0) {
+        const double sqrt_discriminant = std::sqrt(discriminant);
+        bs.push_back((-qb + sqrt_discriminant) / (2 * qa));
+        bs.push_back((-qb - sqrt_discriminant) / (2 * qa));
+      }
+    }
+
+    for (const double b : bs) {
+      const double a = (1 - b * n2(5)) / n1(5);
+      const Eigen::Matrix<double, 6, 1> v = a * n1 + b * n2;
+      const double norm = std::hypot(v(0), v(1));
+      const Eigen::Matrix3d rotation =
+          aligned_from_cam_.transpose() *
+          RotationAboutGravity(v(0) / norm, v(1) / norm) * aligned_from_world_;
+      M_t cam_from_world;
+      cam_from_world.leftCols<3>() = rotation;
+      cam_from_world.col(3) = aligned_from_cam_.transpose() * v.segment<3>(2);
+      cams_from_world->push_back(cam_from_world);
+    }
+  }
+
+  // Squared reprojection errors as for the P3P estimator.
+  void Residuals(const std::vector<X_t>& points2D,
+                 const std::vector<Y_t>& points3D,
+                 const M_t& cam_from_world,
+                 std::vector<double>* residuals) const {
+    colmap::P3PEstimator::Residuals(
+        points2D, points3D, cam_from_world, residuals);
+  }
+
+ private:
+  Eigen::Matrix3d aligned_from_cam_;
+  Eigen::Matrix3d aligned_from_world_;
+};
+
+// Minimal relative pose solver from 3 correspondences for a known direction
+// of gravity in both cameras. After aligning both gravity directions with the
+// y-axis, the relative rotation is about the y-axis. With the tangent
+// half-angle substitution, the three epipolar constraints t^T w_i(k) = 0
+// admit a solution if the determinant of [w_1 w_2 w_3], a polynomial of
+// degree 6 in k, vanishes.
+class GravityRelativePoseEstimator {
+ public:
+  // The normalized image points in the first and second camera.
+  typedef Eigen::Vector2d X_t;
+  typedef Eigen::Vector2d Y_t;
+  // The essential matrix.
+  typedef Eigen::Matrix3d M_t;
+
+  // The minimum number of samples needed to estimate a model.
+  static const int kMinNumSamples = 3;
+
+  GravityRelativePoseEstimator()
+      : aligned_from_cam1_(Eigen::Matrix3d::Identity()),
+        aligned_from_cam2_(Eigen::Matrix3d::Identity()) {}
+
+  GravityRelativePoseEstimator(const Eigen::Vector3d& gravity_in_cam1,
+                               const Eigen::Vector3d& gravity_in_cam2)
+      : aligned_from_cam1_(GravityAlignedFromFrame(gravity_in_cam1)),
+        aligned_from_cam2_(GravityAlignedFromFrame(gravity_in_cam2)) {}
+
+  void Estimate(const std::vector<X_t>& points1,
+                const std::vector<Y_t>& points2,
+                std::vector<M_t>* models) const {
+    models->clear();
+
+    // Rows w_i(k) * (1 + k^2) = A_i + B_i * k + C_i * k^2 with
+    // w_i = (R_y(k) * r1_i) x r2_i.
+    Eigen::Matrix3d A, B, C;
+    for (int i = 0; i < 3; ++i) {
+      const Eigen::Vector3d r1 =
+          aligned_from_cam1_ * points1[i].homogeneous();
+      const Eigen::Vector3d r2 =
+          aligned_from_cam2_ * points2[i].homogeneous();
+      const Eigen::Vector3d w_c =
+          Eigen::Vector3d(r1.x(), 0, r1.z()).cross(r2);
+      const Eigen::Vector3d w_s =
+          Eigen::Vector3d(r1.z(), 0, -r1.x()).cross(r2);
+      const Eigen::Vector3d w_1 = Eigen::Vector3d(0, r1.y(), 0).cross(r2);
+      A.row(i) = w_c + w_1;
+      B.row(i) = 2 * w_s;
+      C.row(i) = w_1 - w_c;
+    }
+
+    // Coefficients of det([w_1; w_2; w_3]) in increasing order of degree.
+    const auto RowPolynomial = [&](const int row, const int col) {
+      return Eigen::Vector3d(A(row, col), B(row, col), C(row, col));
+    };
+    const auto Multiply = [](const Eigen::VectorXd& p,
+                             const Eigen::VectorXd& q) {
+      Eigen::VectorXd pq = Eigen::VectorXd::Zero(p.size() + q.size() - 1);
+      for (Eigen::Index i = 0; i < p.size(); ++i) {
+        for (Eigen::Index j = 0; j < q.size(); ++j) {
+          pq(i + j) += p(i) * q(j);
+        }
+      }
+      return pq;
+    };
+    Eigen::VectorXd det = Eigen::VectorXd::Zero(7);
+    for (int col = 0; col < 3; ++col) {
+      const int col1 = (col + 1) % 3;
+      const int col2 = (col + 2) % 3;
+      const Eigen::VectorXd minor =
+          Multiply(RowPolynomial(1, col1), RowPolynomial(2, col2)) -
+          Multiply(RowPolynomial(1, col2), RowPolynomial(2, col1));
+      det += Multiply(RowPolynomial(0, col), minor);
+    }
+
+    for (const double k : RealPolynomialRoots(det)) {
+      const double denom = 1 + k * k;
+      const double c = (1 - k * k) / denom;
+      const double s = 2 * k / denom;
+      const Eigen::Matrix3d W = (A + k * B + k * k * C) / denom;
+
+      // The translation is orthogonal to all rows of W and is given by the
+      // most stable cross product of two rows.
+      Eigen::Vector3d t = W.row(0).cross(W.row(1));
+      for (const Eigen::Vector3d& candidate :
+           {Eigen::Vector3d(W.row(0).cross(W.row(2))),
+            Eigen::Vector3d(W.row(1).cross(W.row(2)))}) {
+        if (candidate.squaredNorm() > t.squaredNorm()) {
+          t = candidate;
+        }
+      }
+      if (t.squaredNorm() < 1e-24) {
+        continue;
+      }
+      t.normalize();
+
+      Eigen::Matrix3d t_cross;
+      t_cross << 0, -t.z(), t.y(), t.z(), 0, -t.x(), -t.y(), t.x(), 0;
+      const Eigen::Matrix3d E = aligned_from_cam2_.transpose() * t_cross *
+                                RotationAboutGravity(c, s) *
+                                aligned_from_cam1_;
+      models->push_back(E / E.norm());
+    }
+  }
+
+  // Sampson errors as for the five-point estimator.
+  void Residuals(const std::vector<X_t>& points1,
+                 const std::vector<Y_t>& points2,
+                 const M_t& E,
+                 std::vector<double>* residuals) const {
+    colmap::EssentialMatrixFivePointEstimator::Residuals(
+        points1, points2, E, residuals);
+  }
+
+ private:
+  // Real roots of the polynomial with the given coefficients in increasing
+  // order of degree, as eigenvalues of the companion matrix.
+  static std::vector<double> RealPolynomialRoots(
+      const Eigen::VectorXd& coeffs) {
+    Eigen::Index degree = coeffs.size() - 1;
+    const double scale = coeffs.cwiseAbs().maxCoeff();
+    while (degree > 0 && std::abs(coeffs(degree)) <= 1e-12 * scale) {
+      --degree;
+    }
+    std::vector<double> roots;
+    if (degree <= 0) {
+      return roots;
+    }
+    Eigen::MatrixXd companion = Eigen::MatrixXd::Zero(degree, degree);
+    companion.bottomLeftCorner(degree - 1, degree - 1).setIdentity();
+    companion.col(degree - 1) = -coeffs.head(degree) / coeffs(degree);
+    const Eigen::EigenSolver<Eigen::MatrixXd> solver(companion, false);
+    for (Eigen::Index i = 0; i < degree; ++i) {
+      const std::complex<double> root = solver.eigenvalues()(i);
+      if (std::abs(root.imag()) <= 1e-6 * std::max(1.0, std::abs(root))) {
+        roots.push_back(root.real());
+      }
+    }
+    return roots;
+  }
+
+  Eigen::Matrix3d aligned_from_cam1_;
+  Eigen::Matrix3d aligned_from_cam2_;
+};
@@ -0,0 +1,329 @@
+#pragma once
+
+#include "colmap/math/random.h"
+#include "colmap/optim/ransac.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "utils.h"
+
+// Locally optimized RANSAC that evaluates the hypotheses of a batch of
+// minimal samples in parallel. It follows colmap::LORANSAC, except that
+//  - minimal samples are drawn sequentially in batches of kBatchSize from a
+//    generator seeded by the PRNG of COLMAP (see colmap::SetPRNGSeed) and the
+//    batch is then scored on a thread pool of num_threads threads,
+//  - the best hypothesis of a batch is selected in sample order with ties
+//    resolved towards the earlier sample, and local optimization is only run
+//    on the batch winner if it improves over the best support so far,
+//  - the dynamic number of trials is updated and checked after each batch.
+// The result is thus independent of the number of threads. The estimators are
+// passed as instances, so that they may carry state (e.g. a gravity prior).
+template <typename Estimator, typename LocalEstimator>
+class ParallelLORANSAC {
+ public:
+  using X_t = typename Estimator::X_t;
+  using Y_t = typename Estimator::Y_t;
+  using M_t = typename Estimator::M_t;
+
+  struct Support {
+    size_t num_inliers = 0;
+    double residual_sum = std::numeric_limits<double>::max();
+  };
+
+  struct Report {
+    bool success = false;
+    size_t num_trials = 0;
+    Support support;
+    std::vector<char> inlier_mask;
+    M_t model;
+  };
+
+  static const size_t kBatchSize = 64;
+
+  ParallelLORANSAC(const colmap::RANSACOptions& options,
+                   const int num_threads,
+                   const Estimator& estimator = Estimator(),
+                   const LocalEstimator& local_estimator = LocalEstimator())
+      : options_(options),
+        num_threads_(num_threads),
+        estimator_(estimator),
+        local_estimator_(local_estimator) {
+    options_.Check();
+    // Determine max_num_trials based on the assumed min_inlier_ratio, as in
+    // colmap::RANSAC.
+    const size_t kNumSamples = 100000;
+    options_.max_num_trials = static_cast<int>(std::min<size_t>(
+        options_.max_num_trials,
+        ComputeNumTrials(
+            static_cast<size_t>(options_.min_inlier_ratio * kNumSamples),
+            kNumSamples)));
+  }
+
+  Report Estimate(const std::vector<X_t>& X, const std::vector<Y_t>& Y) {
+    THROW_CHECK_EQ(X.size(), Y.size());
+    const size_t num_samples = X.size();
+    const size_t kMinNumSamples = Estimator::kMinNumSamples;
+
+    Report report;
+    if (num_samples < kMinNumSamples) {
+      return report;
+    }
+
+    const double max_residual = options_.max_error * options_.max_error;
+    const size_t max_num_trials = options_.max_num_trials;
+    const size_t min_num_trials = options_.min_num_trials;
+    size_t dyn_max_num_trials = max_num_trials;
+
+    std::mt19937 prng(colmap::RandomUniformInteger<uint32_t>(
+        0, std::numeric_limits<uint32_t>::max()));
+    std::vector<size_t> sample_idxs(num_samples);
+    std::iota(sample_idxs.begin(), sample_idxs.end(), 0);
+
+    // The threads are shared by all batches.
+    const size_t num_chunks = NumParallelChunks(kBatchSize, num_threads_);
+    std::unique_ptr<colmap::ThreadPool> thread_pool;
+    if (num_chunks > 1) {
+      thread_pool.reset(new colmap::ThreadPool(static_cast<int>(num_chunks)));
+    }
+    std::vector<std::vector<double>> chunk_residuals(num_chunks);
+    std::vector<X_t> batch_X(kBatchSize * kMinNumSamples);
+    std::vector<Y_t> batch_Y(kBatchSize * kMinNumSamples);
+    std::vector<Support> batch_supports(kBatchSize);
+    std::vector<M_t> batch_models(kBatchSize);
+
+    Support best_support;
+    M_t best_model;
+    bool best_model_is_local = false;
+    std::vector<double> residuals;
+
+    while (report.num_trials < max_num_trials &&
+           (report.num_trials < dyn_max_num_trials ||
+            report.num_trials < min_num_trials)) {
+      const size_t batch_size = std::min(static_cast<size_t>(kBatchSize),
+                                         max_num_trials - report.num_trials);
+
+      // Draw distinct random indices by partial Fisher-Yates shuffles.
+      for (size_t i = 0; i < batch_size; ++i) {
+        for (size_t j = 0; j < kMinNumSamples; ++j) {
+          std::uniform_int_distribution<size_t> distribution(j,
+                                                             num_samples - 1);
+          std::swap(sample_idxs[j], sample_idxs[distribution(prng)]);
+          batch_X[i * kMinNumSamples + j] = X[sample_idxs[j]];
+          batch_Y[i * kMinNumSamples + j] = Y[sample_idxs[j]];
+        }
+      }
+
+      const auto evaluate_samples = [&](size_t chunk_idx,
+                                        size_t begin,
+                                        size_t end) {
+        Estimator estimator = estimator_;
+        std::vector<double>& chunk_residual = chunk_residuals[chunk_idx];
+        std::vector<X_t> X_rand(kMinNumSamples);
+        std::vector<Y_t> Y_rand(kMinNumSamples);
+        std::vector<M_t> sample_models;
+        for (size_t i = begin; i < end; ++i) {
+          std::copy_n(batch_X.begin() + i * kMinNumSamples,
+                      kMinNumSamples,
+                      X_rand.begin());
+          std::copy_n(batch_Y.begin() + i * kMinNumSamples,
+                      kMinNumSamples,
+                      Y_rand.begin());
+          sample_models.clear();
+          estimator.Estimate(X_rand, Y_rand, &sample_models);
+          batch_supports[i] = Support();
+          for (const M_t& sample_model : sample_models) {
+            estimator.Residuals(X, Y, sample_model, &chunk_residual);
+            const Support support =
+                EvaluateSupport(chunk_residual, max_residual);
+            if (IsBetter(support, batch_supports[i])) {
+              batch_supports[i] = support;
+              batch_models[i] = sample_model;
+            }
+          }
+        }
+      };
+      if (thread_pool) {
+        ParallelFor(*thread_pool, batch_size, evaluate_samples);
+      } else {
+        evaluate_samples(0, 0, batch_size);
+      }
+
+      report.num_trials += batch_size;
+
+      size_t best_batch_idx = batch_size;
+      for (size_t i = 0; i < batch_size; ++i) {
+        if (IsBetter(batch_supports[i], best_support) &&
+            (best_batch_idx == batch_size ||
+             IsBetter(batch_supports[i], batch_supports[best_batch_idx]))) {
+          best_batch_idx = i;
+        }
+      }
+      if (best_batch_idx == batch_size) {
+        continue;
+      }
+
+      best_support = batch_supports[best_batch_idx];
+      best_model = batch_models[best_batch_idx];
+      best_model_is_local = false;
+
+      // Estimate locally optimized model from inliers.
+      if (best_support.num_inliers > kMinNumSamples &&
+          best_support.num_inliers >= LocalEstimator::kMinNumSamples) {
+        estimator_.Residuals(X, Y, best_model, &residuals);
+        LocallyOptimize(X,
+                        Y,
+                        max_residual,
+                        &residuals,
+                        &best_support,
+                        &best_model,
+                        &best_model_is_local);
+      }
+
+      dyn_max_num_trials =
+          ComputeNumTrials(best_support.num_inliers, num_samples);
+    }
+
+    report.support = best_support;
+    report.model = best_model;
+
+    // No valid model was found.
+    if (report.support.num_inliers < kMinNumSamples) {
+      return report;
+    }
+
+    report.success = true;
+
+    // Determine inlier mask. Note that this calculates the residuals for the
+    // best model twice, but saves to copy and fill the inlier mask for each
+    // evaluated model. Some benchmarking revealed that this approach is
+    // faster.
+    if (best_model_is_local) {
+      local_estimator_.Residuals(X, Y, report.model, &residuals);
+    } else {
+      estimator_.Residuals(X, Y, report.model, &residuals);
+    }
+
+    report.inlier_mask.resize(num_samples);
+    for (size_t i = 0; i < residuals.size(); ++i) {
+      report.inlier_mask[i] = residuals[i] <= max_residual;
+    }
+
+    return report;
+  }
+
+ private:
+  static Support EvaluateSupport(const std::vector<double>& residuals,
+                                 const double max_residual) {
+    Support support;
+    support.num_inliers = 0;
+    support.residual_sum = 0;
+    for (const double residual : residuals) {
+      if (residual <= max_residual) {
+        support.num_inliers += 1;
+        support.residual_sum += residual;
+      }
+    }
+    return support;
+  }
+
+  // Same ordering as colmap::InlierSupportMeasurer.
+  static bool IsBetter(const Support& support1, const Support& support2) {
+    if (support1.num_inliers > support2.num_inliers) {
+      return true;
+    } else {
+      return support1.num_inliers == support2.num_inliers &&
+             support1.residual_sum < support2.residual_sum;
+    }
+  }
+
+  // Same as colmap::RANSAC::ComputeNumTrials.
+  size_t ComputeNumTrials(const size_t num_inliers,
+                          const size_t num_samples) const {
+    const double inlier_ratio = num_inliers / static_cast<double>(num_samples);
+
+    const double nom = 1 - options_.confidence;
+    if (nom <= 0) {
+      return std::numeric_limits<size_t>::max();
+    }
+
+    const double denom = 1 - std::pow(inlier_ratio, Estimator::kMinNumSamples);
+    if (denom <= 0) {
+      return 1;
+    }
+
+    // Prevent divide by zero below.
+    if (denom == 1.0) {
+      return std::numeric_limits<size_t>::max();
+    }
+
+    return static_cast<size_t>(
+        std::ceil(std::log(nom) / std::log(denom) *
+                  options_.dyn_num_trials_multiplier));
+  }
+
+  // Recursive local optimization to expand the inlier set, as in
+  // colmap::LORANSAC. The residuals must be those of the given best model.
+  void LocallyOptimize(const std::vector<X_t>& X,
+                       const std::vector<Y_t>& Y,
+                       const double max_residual,
+                       std::vector<double>* residuals,
+                       Support* best_support,
+                       M_t* best_model,
+                       bool* best_model_is_local) {
+    const size_t kMaxNumLocalTrials = 10;
+    std::vector<X_t> X_inlier;
+    std::vector<Y_t> Y_inlier;
+    std::vector<M_t> local_models;
+    for (size_t local_num_trials = 0; local_num_trials < kMaxNumLocalTrials;
+         ++local_num_trials) {
+      X_inlier.clear();
+      Y_inlier.clear();
+      X_inlier.reserve(best_support->num_inliers);
+      Y_inlier.reserve(best_support->num_inliers);
+      for (size_t i = 0; i < residuals->size(); ++i) {
+        if ((*residuals)[i] <= max_residual) {
+          X_inlier.push_back(X[i]);
+          Y_inlier.push_back(Y[i]);
+        }
+      }
+
+      local_models.clear();
+      local_estimator_.Estimate(X_inlier, Y_inlier, &local_models);
+
+      const size_t prev_best_num_inliers = best_support->num_inliers;
+
+      for (const M_t& local_model : local_models) {
+        local_estimator_.Residuals(X, Y, local_model, residuals);
+        const Support local_support =
+            EvaluateSupport(*residuals, max_residual);
+        if (IsBetter(local_support, *best_support)) {
+          *best_support = local_support;
+          *best_model = local_model;
+          *best_model_is_local = true;
+        }
+      }
+
+      // Only continue recursive local optimization, if the inlier set
+      // expanded and another iteration of local optimization may be
+      // beneficial.
+      if (best_support->num_inliers <= prev_best_num_inliers) {
+        break;
+      }
+
+      // Re-evaluate the residuals of the best model for the next iteration.
+      local_estimator_.Residuals(X, Y, *best_model, residuals);
+    }
+  }
+
+  colmap::RANSACOptions options_;
+  const int num_threads_;
+  Estimator estimator_;
+  LocalEstimator local_estimator_;
+};
@@ -0,0 +1,449 @@
+#include "colmap/geometry/rigid3.h"
+#include "colmap/scene/camera.h"
+#include "colmap/util/types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace colmap;
+
+#include <pybind11/eigen.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+#include "helpers.h"
+#include "log_exceptions.h"
+#include "utils.h"
+
+struct BatchTriangulationOptions {
+  // Maximum reprojection error in pixels of an inlier observation.
+  double max_error = 4.0;
+
+  // Minimum triangulation angle in degrees of a successful track.
+  double min_tri_angle = 1.5;
+
+  // Whether to select the inlier observations by RANSAC over pairs of views
+  // instead of using all observations.
+  bool use_ransac = false;
+
+  // Maximum number of view pairs evaluated by RANSAC. If a track has more
+  // view pairs, they are sampled randomly.
+  int max_num_trials = 100;
+
+  // Maximum number of Gauss-Newton iterations to refine the reprojection
+  // error of the inliers, or 0 to only use the DLT estimate.
+  int max_num_iterations = 10;
+
+  // Number of threads over which the tracks are distributed.
+  int num_threads = -1;
+
+  void Check() const {
+    THROW_CHECK_GT(max_error, 0);
+    THROW_CHECK_GE(min_tri_angle, 0);
+    THROW_CHECK_GT(max_num_trials, 0);
+    THROW_CHECK_GE(max_num_iterations, 0);
+  }
+};
+
+// Per-image data shared by all tracks.
+struct TriangulationView {
+  Eigen::Matrix3x4d cam_from_world;
+  Eigen::Vector3d center;
+  const Camera* camera;
+  double squared_max_error;
+};
+
+struct TriangulationObservation {
+  const TriangulationView* view;
+  Eigen::Vector2d point2D;
+  Eigen::Vector2d point2D_in_cam;
+};
+
+// Squared reprojection error in normalized camera coordinates, or infinity if
+// the point is behind the camera.
+inline double SquaredNormalizedError(const TriangulationObservation& obs,
+                                     const Eigen::Vector3d& xyz) {
+  const Eigen::Vector3d point_in_cam =
+      obs.view->cam_from_world * xyz.homogeneous();
+  if (point_in_cam.z() <= std::numeric_limits<double>::epsilon()) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return (point_in_cam.hnormalized() - obs.point2D_in_cam).squaredNorm();
+}
+
+// Linear triangulation minimizing the algebraic error of the given views,
+// as in colmap::TriangulateMultiViewPoint.
+bool TriangulateDLT(const std::vector<TriangulationObservation>& observations,
+                    const std::vector<size_t>& idxs,
+                    Eigen::Vector3d* xyz) {
+  Eigen::Matrix4d A = Eigen::Matrix4d::Zero();
+  for (const size_t idx : idxs) {
+    const TriangulationObservation& obs = observations[idx];
+    const Eigen::Vector3d ray = obs.point2D_in_cam.homogeneous().normalized();
+    const Eigen::Matrix3x4d term = obs.view->cam_from_world -
+                                   ray * ray.transpose() *
+                                       obs.view->cam_from_world;
+    A += term.transpose() * term;
+  }
+  const Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> solver(A);
+  const Eigen::Vector4d point = solver.eigenvectors().col(0);
+  if (std::abs(point(3)) < std::numeric_limits<double>::epsilon()) {
+    return false;
+  }
+  *xyz = point.hnormalized();
+  return xyz->allFinite();
+}
+
+// Gauss-Newton refinement of the normalized reprojection errors with a
+// Levenberg-Marquardt damping.
+void RefinePoint(const std::vector<TriangulationObservation>& observations,
+                 const std::vector<size_t>& idxs,
+                 const int max_num_iterations,
+                 Eigen::Vector3d* xyz) {
+  const auto Cost = [&](const Eigen::Vector3d& point) {
+    double cost = 0;
+    for (const size_t idx : idxs) {
+      cost += SquaredNormalizedError(observations[idx], point);
+    }
+    return cost;
+  };
+
+  double cost = Cost(*xyz);
+  double lambda = 1e-6;
+  for (int iter = 0; iter < max_num_iterations; ++iter) {
+    Eigen::Matrix3d JtJ = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d Jtr = Eigen::Vector3d::Zero();
+    for (const size_t idx : idxs) {
+      const TriangulationObservation& obs = observations[idx];
+      const Eigen::Matrix3d R = obs.view->cam_from_world.leftCols<3>();
+      const Eigen::Vector3d p = obs.view->cam_from_world * xyz->homogeneous();
+      const double inv_z = 1 / p.z();
+      const Eigen::Vector2d residual =
+          p.head<2>() * inv_z - obs.point2D_in_cam;
+      Eigen::Matrix<double, 2, 3> J_proj;
+      J_proj << inv_z, 0, -p.x() * inv_z * inv_z, 0, inv_z,
+          -p.y() * inv_z * inv_z;
+      const Eigen::Matrix<double, 2, 3> J = J_proj * R;
+      JtJ += J.transpose() * J;
+      Jtr += J.transpose() * residual;
+    }
+
+    bool improved = false;
+    while (lambda < 1e6) {
+      Eigen::Matrix3d damped_JtJ = JtJ;
+      damped_JtJ.diagonal() *= 1 + lambda;
+      const Eigen::Vector3d delta = damped_JtJ.ldlt().solve(-Jtr);
+      const Eigen::Vector3d candidate = *xyz + delta;
+      const double candidate_cost = Cost(candidate);
+      if (candidate_cost < cost) {
+        *xyz = candidate;
+        const double relative_decrease = (cost - candidate_cost) / cost;
+        cost = candidate_cost;
+        lambda = std::max(lambda / 10, 1e-12);
+        improved = relative_decrease > 1e-10;
+        break;
+      }
+      lambda *= 10;
+    }
+    if (!improved) {
+      break;
+    }
+  }
+}
+
+// Maximum angle in degrees between the rays from the given views to the point.
+double MaxTriangulationAngle(
+    const std::vector<TriangulationObservation>& observations,
+    const std::vector<size_t>& idxs,
+    const Eigen::Vector3d& xyz) {
+  double max_cos_angle = 1;
+  for (size_t i = 0; i < idxs.size(); ++i) {
+    const Eigen::Vector3d ray1 =
+        (observations[idxs[i]].view->center - xyz).normalized();
+    for (size_t j = i + 1; j < idxs.size(); ++j) {
+      const Eigen::Vector3d ray2 =
+          (observations[idxs[j]].view->center - xyz).normalized();
+      max_cos_angle = std::min(max_cos_angle, ray1.dot(ray2));
+    }
+  }
+  return std::acos(std::max(-1.0, std::min(1.0, max_cos_angle))) * 180 /
+         M_PI;
+}
+
+struct TrackTriangulation {
+  bool success = false;
+  Eigen::Vector3d xyz = Eigen::Vector3d::Zero();
+  double tri_angle = 0;
+  double error = 0;
+  std::vector<size_t> inlier_idxs;
+};
+
+// Select the observations consistent with the best two-view triangulation.
+// Pairs are enumerated exhaustively if there are at most max_num_trials of
+// them and otherwise sampled from a generator seeded with the track index.
+void SelectInliersRANSAC(
+    const std::vector<TriangulationObservation>& observations,
+    const BatchTriangulationOptions& options,
+    const size_t track_idx,
+    std::vector<size_t>* inlier_idxs) {
+  const size_t num_obs = observations.size();
+  const size_t num_pairs = num_obs * (num_obs - 1) / 2;
+  const size_t num_trials =
+      std::min(num_pairs, static_cast<size_t>(options.max_num_trials));
+  std::mt19937 prng(static_cast<std::mt19937::result_type>(track_idx));
+  std::uniform_int_distribution<size_t> distribution(0, num_obs - 1);
+
+  size_t best_num_inliers = 0;
+  double best_residual_sum = std::numeric_limits<double>::max();
+  std::vector<size_t> pair_idxs(2);
+  std::vector<size_t> trial_inlier_idxs;
+  size_t idx1 = 0;
+  size_t idx2 = 0;
+  for (size_t trial = 0; trial < num_trials; ++trial) {
+    if (num_trials == num_pairs) {
+      if (++idx2 >= num_obs) {
+        ++idx1;
+        idx2 = idx1 + 1;
+      }
+      pair_idxs[0] = idx1;
+      pair_idxs[1] = idx2;
+    } else {
+      pair_idxs[0] = distribution(prng);
+      do {
+        pair_idxs[1] = distribution(prng);
+      } while (pair_idxs[1] == pair_idxs[0]);
+    }
+
+    Eigen::Vector3d xyz;
+    if (!TriangulateDLT(observations, pair_idxs, &xyz) ||
+        MaxTriangulationAngle(observations, pair_idxs, xyz) <
+            options.min_tri_angle) {
+      continue;
+    }
+
+    trial_inlier_idxs.clear();
+    double residual_sum = 0;
+    for (size_t i = 0; i < num_obs; ++i) {
+      const double squared_error = SquaredNormalizedError(observations[i], xyz);
+      if (squared_error <= observations[i].view->squared_max_error) {
+        trial_inlier_idxs.push_back(i);
+        residual_sum += squared_error;
+      }
+    }
+    if (trial_inlier_idxs.size() > best_num_inliers ||
+        (trial_inlier_idxs.size() == best_num_inliers &&
+         residual_sum < best_residual_sum)) {
+      best_num_inliers = trial_inlier_idxs.size();
+      best_residual_sum = residual_sum;
+      *inlier_idxs = trial_inlier_idxs;
+    }
+  }
+}
+
+TrackTriangulation TriangulateTrack(
+    const std::vector<TriangulationObservation>& observations,
+    const BatchTriangulationOptions& options,
+    const size_t track_idx) {
+  TrackTriangulation result;
+  if (observations.size() < 2) {
+    return result;
+  }
+
+  if (options.use_ransac) {
+    SelectInliersRANSAC(observations, options, track_idx, &result.inlier_idxs);
+  } else {
+    result.inlier_idxs.resize(observations.size());
+    for (size_t i = 0; i < observations.size(); ++i) {
+      result.inlier_idxs[i] = i;
+    }
+  }
+
+  // Reject the observation with the largest error and re-estimate until all
+  // are within max_error, so that outliers neither bias the point nor count
+  // as inliers. Rejecting one at a time keeps the inliers that only an
+  // outlier pulled beyond max_error.
+  while (true) {
+    if (result.inlier_idxs.size() < 2 ||
+        !TriangulateDLT(observations, result.inlier_idxs, &result.xyz)) {
+      return result;
+    }
+    if (options.max_num_iterations > 0) {
+      RefinePoint(observations,
+                  result.inlier_idxs,
+                  options.max_num_iterations,
+                  &result.xyz);
+    }
+    size_t worst_i = 0;
+    double worst_relative_error = 0;
+    for (size_t i = 0; i < result.inlier_idxs.size(); ++i) {
+      const TriangulationObservation& obs = observations[result.inlier_idxs[i]];
+      const double relative_error = SquaredNormalizedError(obs, result.xyz) /
+                                    obs.view->squared_max_error;
+      if (relative_error > worst_relative_error) {
+        worst_i = i;
+        worst_relative_error = relative_error;
+      }
+    }
+    if (worst_relative_error <= 1) {
+      break;
+    }
+    result.inlier_idxs.erase(result.inlier_idxs.begin() + worst_i);
+  }
+
+  // Mean reprojection error in pixels. The cheirality of the inliers was
+  // verified by SquaredNormalizedError.
+  double error_sum = 0;
+  for (const size_t idx : result.inlier_idxs) {
+    const TriangulationObservation& obs = observations[idx];
+    const Eigen::Vector3d point_in_cam =
+        obs.view->cam_from_world * result.xyz.homogeneous();
+    error_sum +=
+        (obs.view->camera->ImgFromCam(point_in_cam.hnormalized()) -
+         obs.point2D)
+            .norm();
+  }
+  result.error = error_sum / result.inlier_idxs.size();
+  result.tri_angle =
+      MaxTriangulationAngle(observations, result.inlier_idxs, result.xyz);
+  result.success = result.tri_angle >= options.min_tri_angle;
+  return result;
+}
+
+py::dict triangulate(
+    const Eigen::Ref<const Eigen::Matrix<double, Eigen::Dynamic, 2,
+                                         Eigen::RowMajor>>& points2D,
+    const Eigen::Ref<const Eigen::Matrix<int64_t, Eigen::Dynamic, 1>>&
+        track_offsets,
+    const Eigen::Ref<const Eigen::Matrix<int64_t, Eigen::Dynamic, 1>>&
+        image_idxs,
+    const std::vector<Rigid3d>& cams_from_world,
+    const std::vector<Camera>& cameras,
+    const BatchTriangulationOptions& options) {
+  options.Check();
+  THROW_CHECK_EQ(cams_from_world.size(), cameras.size());
+  THROW_CHECK_EQ(points2D.rows(), image_idxs.size());
+  THROW_CHECK_GE(track_offsets.size(), 1);
+  THROW_CHECK_EQ(track_offsets(0), 0);
+  THROW_CHECK_EQ(track_offsets(track_offsets.size() - 1), points2D.rows());
+  for (Eigen::Index i = 0; i < image_idxs.size(); ++i) {
+    THROW_CHECK_GE(image_idxs(i), 0);
+    THROW_CHECK_LT(image_idxs(i), static_cast<int64_t>(cameras.size()));
+  }
+  for (Eigen::Index i = 1; i < track_offsets.size(); ++i) {
+    THROW_CHECK_LE(track_offsets(i - 1), track_offsets(i));
+  }
+
+  const size_t num_tracks = track_offsets.size() - 1;
+  Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor> xyzs(num_tracks,
+                                                                 3);
+  Eigen::VectorXd tri_angles(num_tracks);
+  Eigen::VectorXd errors(num_tracks);
+  Eigen::Matrix<bool, Eigen::Dynamic, 1> successes(num_tracks);
+  Eigen::Matrix<int64_t, Eigen::Dynamic, 1> num_inliers(num_tracks);
+  Eigen::Matrix<bool, Eigen::Dynamic, 1> inlier_mask =
+      Eigen::Matrix<bool, Eigen::Dynamic, 1>::Zero(points2D.rows());
+
+  {
+    py::gil_scoped_release release;
+
+    std::vector<TriangulationView> views(cameras.size());
+    for (size_t i = 0; i < cameras.size(); ++i) {
+      views[i].cam_from_world = cams_from_world[i].ToMatrix();
+      views[i].center = cams_from_world[i].Inverse().translation;
+      views[i].camera = &cameras[i];
+      const double max_error =
+          cameras[i].CamFromImgThreshold(options.max_error);
+      views[i].squared_max_error = max_error * max_error;
+    }
+
+    ParallelFor(
+        num_tracks,
+        options.num_threads,
+        [&](size_t, size_t begin, size_t end) {
+          std::vector<TriangulationObservation> observations;
+          for (size_t track_idx = begin; track_idx < end; ++track_idx) {
+            const int64_t obs_begin = track_offsets(track_idx);
+            const int64_t obs_end = track_offsets(track_idx + 1);
+            observations.resize(obs_end - obs_begin);
+            for (int64_t i = obs_begin; i < obs_end; ++i) {
+              TriangulationObservation& obs = observations[i - obs_begin];
+              obs.view = &views[image_idxs(i)];
+              obs.point2D = points2D.row(i).transpose();
+              obs.point2D_in_cam = obs.view->camera->CamFromImg(obs.point2D);
+            }
+
+            const TrackTriangulation result =
+                TriangulateTrack(observations, options, track_idx);
+            xyzs.row(track_idx) = result.xyz.transpose();
+            tri_angles(track_idx) = result.tri_angle;
+            errors(track_idx) = result.error;
+            successes(track_idx) = result.success;
+            num_inliers(track_idx) = result.inlier_idxs.size();
+            for (const size_t idx : result.inlier_idxs) {
+              inlier_mask(obs_begin + idx) = true;
+            }
+          }
+        });
+  }
+
+  return py::dict("xyz"_a = xyzs,
+                  "tri_angles"_a = tri_angles,
+                  "errors"_a = errors,
+                  "success"_a = successes,
+                  "num_inliers"_a = num_inliers,
+                  "inlier_mask"_a = inlier_mask);
+}
+
+void bind_triangulation(py::module& m) {
+  auto PyOptions =
+      py::class_<BatchTriangulationOptions>(m, "BatchTriangulationOptions")
+          .def(py::init<>())
+          .def_readwrite("max_error",
+                         &BatchTriangulationOptions::max_error,
+                         "Maximum reprojection error in pixels of an inlier.")
+          .def_readwrite("min_tri_angle",
+                         &BatchTriangulationOptions::min_tri_angle,
+                         "Minimum triangulation angle in degrees.")
+          .def_readwrite("use_ransac",
+                         &BatchTriangulationOptions::use_ransac,
+                         "Whether to select the inliers by RANSAC over pairs "
+                         "of views.")
+          .def_readwrite("max_num_trials",
+                         &BatchTriangulationOptions::max_num_trials,
+                         "Maximum number of view pairs evaluated by RANSAC.")
+          .def_readwrite("max_num_iterations",
+                         &BatchTriangulationOptions::max_num_iterations,
+                         "Maximum number of refinement iterations.")
+          .def_readwrite("num_threads",
+                         &BatchTriangulationOptions::num_threads);
+  make_dataclass(PyOptions);
+  auto options = PyOptions().cast<BatchTriangulationOptions>();
+
+  m.def("triangulate",
+        &triangulate,
+        "points2D"_a,
+        "track_offsets"_a,
+        "image_idxs"_a,
+        "cams_from_world"_a,
+        "cameras"_a,
+        "options"_a = options,
+        "Triangulate a batch of tracks from known poses in parallel.\n\n"
+        "The tracks are given in compressed sparse row format: the\n"
+        "observations of track i are the rows track_offsets[i] to\n"
+        "track_offsets[i + 1] - 1 of points2D (Nx2, pixels) and image_idxs\n"
+        "(N), which index into cams_from_world and cameras. Each track is\n"
+        "triangulated by DLT over its inliers, optionally selected by\n"
+        "RANSAC over pairs of views, and refined by Gauss-Newton. The\n"
+        "observation with the largest error is then rejected and the point\n"
+        "re-estimated until all inliers are within max_error. A track fails\n"
+        "if fewer than 2 inliers remain or its angle is below min_tri_angle.\n"
+        "Returns a dict with xyz (Mx3), tri_angles (M, degrees), errors\n"
+        "(M, mean reprojection error of the inliers in pixels), success (M),\n"
+        "num_inliers (M), and inlier_mask (N).");
+}
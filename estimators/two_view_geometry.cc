@@ -20,20 +20,85 @@ using namespace colmap;
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+#include "estimators/gravity_estimators.h"
+#include "estimators/parallel_loransac.h"
 #include "helpers.h"
 #include "log_exceptions.h"
 
+// Calibrated two-view geometry estimation with the 3-point solver for a known
+// direction of gravity in both cameras, followed by the five-point local
+// optimization of LORANSAC. Planar and panoramic configurations are not
+// detected, i.e. the geometry is either CALIBRATED or DEGENERATE.
+TwoViewGeometry EstimateCalibratedTwoViewGeometryWithGravity(
+    const Camera& camera1,
+    const std::vector<Eigen::Vector2d>& points2D1,
+    const Eigen::Vector3d& gravity1,
+    const Camera& camera2,
+    const std::vector<Eigen::Vector2d>& points2D2,
+    const Eigen::Vector3d& gravity2,
+    const TwoViewGeometryOptions& options,
+    const int num_threads) {
+  THROW_CHECK_GT(gravity1.norm(), 0);
+  THROW_CHECK_GT(gravity2.norm(), 0);
+
+  TwoViewGeometry geometry;
+  geometry.config = TwoViewGeometry::DEGENERATE;
+
+  std::vector<Eigen::Vector2d> points2D1_in_cam(points2D1.size());
+  std::vector<Eigen::Vector2d> points2D2_in_cam(points2D2.size());
+  for (size_t i = 0; i < points2D1.size(); ++i) {
+    points2D1_in_cam[i] = camera1.CamFromImg(points2D1[i]);
+    points2D2_in_cam[i] = camera2.CamFromImg(points2D2[i]);
+  }
+
+  // Same average threshold as in EstimateCalibratedTwoViewGeometry.
+  RANSACOptions ransac_options = options.ransac_options;
+  ransac_options.max_error =
+      (camera1.CamFromImgThreshold(options.ransac_options.max_error) +
+       camera2.CamFromImgThreshold(options.ransac_options.max_error)) /
+      2;
+  ParallelLORANSAC<GravityRelativePoseEstimator,
+                   EssentialMatrixFivePointEstimator>
+      ransac(ransac_options,
+             num_threads,
+             GravityRelativePoseEstimator(gravity1, gravity2));
+  const auto report = ransac.Estimate(points2D1_in_cam, points2D2_in_cam);
+  if (!report.success || report.support.num_inliers <
+                              static_cast<size_t>(options.min_num_inliers)) {
+    return geometry;
+  }
+
+  geometry.config = TwoViewGeometry::CALIBRATED;
+  geometry.E = report.model;
+  for (size_t i = 0; i < report.inlier_mask.size(); ++i) {
+    if (report.inlier_mask[i]) {
+      geometry.inlier_matches.emplace_back(i, i);
+    }
+  }
+  return geometry;
+}
+
 py::dict two_view_geometry_estimation(
     const std::vector<Eigen::Vector2d> points2D1,
     const std::vector<Eigen::Vector2d> points2D2,
     Camera& camera1,
     Camera& camera2,
-    TwoViewGeometryOptions options) {
+    TwoViewGeometryOptions options,
+    const py::object gravity1,
+    const py::object gravity2,
+    const int num_threads) {
   SetPRNGSeed(0);
 
   // Check that both vectors have the same size.
   THROW_CHECK_EQ(points2D1.size(), points2D2.size());
 
+  THROW_CHECK_EQ(gravity1.is_none(), gravity2.is_none());
+  const bool has_gravity = !gravity1.is_none();
+  const Eigen::Vector3d gravity_in_cam1 =
+      has_gravity ? gravity1.cast<Eigen::Vector3d>() : Eigen::Vector3d::Zero();
+  const Eigen::Vector3d gravity_in_cam2 =
+      has_gravity ? gravity2.cast<Eigen::Vector3d>() : Eigen::Vector3d::Zero();
+
   // Failure output dictionary.
   py::dict failure_dict("success"_a = false);
   py::gil_scoped_release release;
@@ -45,8 +110,18 @@ py::dict two_view_geometry_estimation(
     matches.emplace_back(i, i);
   }
 
-  auto two_view_geometry = EstimateCalibratedTwoViewGeometry(
-      camera1, points2D1, camera2, points2D2, matches, options);
+  auto two_view_geometry =
+      has_gravity
+          ? EstimateCalibratedTwoViewGeometryWithGravity(camera1,
+                                                         points2D1,
+                                                         gravity_in_cam1,
+                                                         camera2,
+                                                         points2D2,
+                                                         gravity_in_cam2,
+                                                         options,
+                                                         num_threads)
+          : EstimateCalibratedTwoViewGeometry(
+                camera1, points2D1, camera2, points2D2, matches, options);
 
   if (!EstimateTwoViewGeometryPose(
           camera1, points2D1, camera2, points2D2, &two_view_geometry)) {
@@ -86,8 +161,14 @@ py::dict two_view_geometry_estimation(
   two_view_geometry_options.ransac_options.min_num_trials = min_num_trials;
   two_view_geometry_options.ransac_options.max_num_trials = max_num_trials;
   two_view_geometry_options.ransac_options.confidence = confidence;
-  return two_view_geometry_estimation(
-      points2D1, points2D2, camera1, camera2, two_view_geometry_options);
+  return two_view_geometry_estimation(points2D1,
+                                      points2D2,
+                                      camera1,
+                                      camera2,
+                                      two_view_geometry_options,
+                                      py::none(),
+                                      py::none(),
+                                      1);
 }
 
 void bind_two_view_geometry_estimation(py::module& m) {
@@ -133,14 +214,22 @@ void bind_two_view_geometry_estimation(py::module& m) {
                                  const std::vector<Eigen::Vector2d>,
                                  Camera&,
                                  Camera&,
-                                 const TwoViewGeometryOptions)>(
-            &two_view_geometry_estimation),
+                                 const TwoViewGeometryOptions,
+                                 const py::object,
+                                 const py::object,
+                                 const int)>(&two_view_geometry_estimation),
         "points2D1"_a,
         "points2D2"_a,
         "camera1"_a,
         "camera2"_a,
         "estimation_options"_a = est_options,
-        "Generic two-view geometry estimation");
+        "gravity1"_a = py::none(),
+        "gravity2"_a = py::none(),
+        "num_threads"_a = 1,
+        "Generic two-view geometry estimation.\n\n"
+        "If the directions of gravity in both camera frames are given, the\n"
+        "calibrated relative pose is estimated with the 3-point solver for\n"
+        "known gravity and the hypotheses are scored on num_threads threads.");
 
   m.def("two_view_geometry_estimation",
         static_cast<py::dict (*)(const std::vector<Eigen::Vector2d>,
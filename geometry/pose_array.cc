@@ -0,0 +1,500 @@
+#include "colmap/geometry/rigid3.h"
+#include "colmap/geometry/sim3.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+using namespace colmap;
+
+#include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
+#include <pybind11/operators.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+#include "log_exceptions.h"
+#include "utils.h"
+
+// Arrays of poses are stored in structure-of-arrays layout: each coefficient
+// is a contiguous column, so that the kernels below are vectorized by Eigen
+// across poses. Quaternions are ordered as x, y, z, w, as in
+// Eigen::Quaterniond::coeffs.
+typedef Eigen::Matrix<double, Eigen::Dynamic, 4> QuaternionArray;
+typedef Eigen::Matrix<double, Eigen::Dynamic, 3> Vector3dArray;
+
+// Repeat a single element to n elements, for broadcasting.
+template <typename MatrixType>
+MatrixType Broadcast(const MatrixType& matrix, const Eigen::Index n) {
+  if (matrix.rows() == n) {
+    return matrix;
+  }
+  THROW_CHECK_EQ(matrix.rows(), 1);
+  return matrix.replicate(n, 1);
+}
+
+// Common number of elements of two broadcastable arrays.
+Eigen::Index BroadcastSize(const Eigen::Index n1, const Eigen::Index n2) {
+  THROW_CHECK(n1 == n2 || n1 == 1 || n2 == 1);
+  return n1 == 1 ? n2 : n1;
+}
+
+QuaternionArray NormalizeQuaternions(const QuaternionArray& quats) {
+  const Eigen::ArrayXd norms = quats.rowwise().norm().array();
+  if (norms.size() > 0) {
+    THROW_CHECK_GT(norms.minCoeff(), 0);
+  }
+  return (quats.array().colwise() / norms).matrix();
+}
+
+// Hamilton product of unit quaternions.
+QuaternionArray MultiplyQuaternions(const QuaternionArray& a,
+                                    const QuaternionArray& b) {
+  const auto ax = a.col(0).array(), ay = a.col(1).array(),
+             az = a.col(2).array(), aw = a.col(3).array();
+  const auto bx = b.col(0).array(), by = b.col(1).array(),
+             bz = b.col(2).array(), bw = b.col(3).array();
+  QuaternionArray c(a.rows(), 4);
+  c.col(0) = (aw * bx + ax * bw + ay * bz - az * by).matrix();
+  c.col(1) = (aw * by - ax * bz + ay * bw + az * bx).matrix();
+  c.col(2) = (aw * bz + ax * by - ay * bx + az * bw).matrix();
+  c.col(3) = (aw * bw - ax * bx - ay * by - az * bz).matrix();
+  return c;
+}
+
+QuaternionArray ConjugateQuaternions(const QuaternionArray& quats) {
+  QuaternionArray conjugates = -quats;
+  conjugates.col(3) = quats.col(3);
+  return conjugates;
+}
+
+// Rotate the vectors by the unit quaternions, with the same number of rows,
+// as v + 2w (q x v) + 2 q x (q x v).
+Vector3dArray RotateVectors(const QuaternionArray& quats,
+                            const Vector3dArray& vectors) {
+  const auto qx = quats.col(0).array(), qy = quats.col(1).array(),
+             qz = quats.col(2).array(), qw = quats.col(3).array();
+  const auto vx = vectors.col(0).array(), vy = vectors.col(1).array(),
+             vz = vectors.col(2).array();
+  const Eigen::ArrayXd tx = 2 * (qy * vz - qz * vy);
+  const Eigen::ArrayXd ty = 2 * (qz * vx - qx * vz);
+  const Eigen::ArrayXd tz = 2 * (qx * vy - qy * vx);
+  Vector3dArray rotated(vectors.rows(), 3);
+  rotated.col(0) = (vx + qw * tx + qy * tz - qz * ty).matrix();
+  rotated.col(1) = (vy + qw * ty + qz * tx - qx * tz).matrix();
+  rotated.col(2) = (vz + qw * tz + qx * ty - qy * tx).matrix();
+  return rotated;
+}
+
+// Spherical linear interpolation of unit quaternions along the shortest arc,
+// with a linear interpolation for nearby rotations, as in
+// Eigen::Quaterniond::slerp.
+QuaternionArray SlerpQuaternions(const QuaternionArray& a,
+                                 const QuaternionArray& b,
+                                 const Eigen::ArrayXd& t) {
+  const Eigen::ArrayXd dot = (a.array() * b.array()).rowwise().sum();
+  const Eigen::ArrayXd abs_dot = dot.abs().min(1.0);
+  const Eigen::ArrayXd theta = abs_dot.acos();
+  const Eigen::ArrayXd sin_theta = theta.sin();
+  const auto nearby = abs_dot >= 1 - Eigen::NumTraits<double>::epsilon();
+  const Eigen::ArrayXd weights_a =
+      nearby.select(1 - t, ((1 - t) * theta).sin() / sin_theta);
+  Eigen::ArrayXd weights_b = nearby.select(t, (t * theta).sin() / sin_theta);
+  weights_b = (dot < 0).select(-weights_b, weights_b);
+  return (a.array().colwise() * weights_a + b.array().colwise() * weights_b)
+      .matrix();
+}
+
+// Check the shape of an Nx3x4 or Nx4x4 array of transformation matrices.
+void CheckMatricesShape(const py::array_t<double>& matrices) {
+  THROW_CHECK_EQ(matrices.ndim(), 3);
+  THROW_CHECK(matrices.shape(1) == 3 || matrices.shape(1) == 4);
+  THROW_CHECK_EQ(matrices.shape(2), 4);
+}
+
+struct Rigid3dArray {
+  QuaternionArray rotations;
+  Vector3dArray translations;
+
+  Rigid3dArray() = default;
+
+  Rigid3dArray(const QuaternionArray& rotations,
+               const Vector3dArray& translations)
+      : rotations(NormalizeQuaternions(rotations)),
+        translations(translations) {
+    THROW_CHECK_EQ(rotations.rows(), translations.rows());
+  }
+
+  explicit Rigid3dArray(const std::vector<Rigid3d>& poses)
+      : rotations(poses.size(), 4), translations(poses.size(), 3) {
+    for (size_t i = 0; i < poses.size(); ++i) {
+      rotations.row(i) = poses[i].rotation.coeffs().transpose();
+      translations.row(i) = poses[i].translation.transpose();
+    }
+  }
+
+  Eigen::Index Size() const { return rotations.rows(); }
+
+  Rigid3d Get(const Eigen::Index idx) const {
+    THROW_CHECK_LT(idx, Size());
+    return Rigid3d(Eigen::Quaterniond(rotations.row(idx).transpose()),
+                   translations.row(idx).transpose());
+  }
+
+  std::vector<Rigid3d> ToList() const {
+    std::vector<Rigid3d> poses(Size());
+    for (Eigen::Index i = 0; i < Size(); ++i) {
+      poses[i] = Get(i);
+    }
+    return poses;
+  }
+
+  Rigid3dArray Inverse() const {
+    Rigid3dArray inverse;
+    inverse.rotations = ConjugateQuaternions(rotations);
+    inverse.translations = -RotateVectors(inverse.rotations, translations);
+    return inverse;
+  }
+
+  // Transform the points by the poses. Either may be a single element, which
+  // is then broadcast.
+  Vector3dArray Apply(const Vector3dArray& points) const {
+    const Eigen::Index n = BroadcastSize(Size(), points.rows());
+    return RotateVectors(Broadcast(rotations, n), Broadcast(points, n)) +
+           Broadcast(translations, n);
+  }
+
+  py::array_t<double> ToMatrices() const {
+    py::array_t<double> matrices(std::vector<size_t>{
+        static_cast<size_t>(Size()), size_t(3), size_t(4)});
+    auto matrices_data = matrices.mutable_unchecked<3>();
+    for (Eigen::Index i = 0; i < Size(); ++i) {
+      const Eigen::Matrix3x4d matrix = Get(i).ToMatrix();
+      for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 4; ++c) {
+          matrices_data(i, r, c) = matrix(r, c);
+        }
+      }
+    }
+    return matrices;
+  }
+
+  static Rigid3dArray FromMatrices(const py::array_t<double>& matrices) {
+    CheckMatricesShape(matrices);
+    const auto matrices_data = matrices.unchecked<3>();
+    Rigid3dArray poses;
+    poses.rotations.resize(matrices.shape(0), 4);
+    poses.translations.resize(matrices.shape(0), 3);
+    for (py::ssize_t i = 0; i < matrices.shape(0); ++i) {
+      Eigen::Matrix3d rotation;
+      for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+          rotation(r, c) = matrices_data(i, r, c);
+        }
+        poses.translations(i, r) = matrices_data(i, r, 3);
+      }
+      poses.rotations.row(i) =
+          Eigen::Quaterniond(rotation).normalized().coeffs().transpose();
+    }
+    return poses;
+  }
+};
+
+// Composition with broadcasting: a * b = a(b(x)).
+Rigid3dArray operator*(const Rigid3dArray& a, const Rigid3dArray& b) {
+  const Eigen::Index n = BroadcastSize(a.Size(), b.Size());
+  const QuaternionArray a_rotations = Broadcast(a.rotations, n);
+  Rigid3dArray c;
+  c.rotations = MultiplyQuaternions(a_rotations, Broadcast(b.rotations, n));
+  c.translations = RotateVectors(a_rotations, Broadcast(b.translations, n)) +
+                   Broadcast(a.translations, n);
+  return c;
+}
+
+struct Sim3dArray {
+  Eigen::VectorXd scales;
+  QuaternionArray rotations;
+  Vector3dArray translations;
+
+  Sim3dArray() = default;
+
+  Sim3dArray(const Eigen::VectorXd& scales,
+             const QuaternionArray& rotations,
+             const Vector3dArray& translations)
+      : scales(scales),
+        rotations(NormalizeQuaternions(rotations)),
+        translations(translations) {
+    THROW_CHECK_EQ(scales.size(), rotations.rows());
+    THROW_CHECK_EQ(rotations.rows(), translations.rows());
+  }
+
+  explicit Sim3dArray(const std::vector<Sim3d>& poses)
+      : scales(poses.size()),
+        rotations(poses.size(), 4),
+        translations(poses.size(), 3) {
+    for (size_t i = 0; i < poses.size(); ++i) {
+      scales(i) = poses[i].scale;
+      rotations.row(i) = poses[i].rotation.coeffs().transpose();
+      translations.row(i) = poses[i].translation.transpose();
+    }
+  }
+
+  Eigen::Index Size() const { return rotations.rows(); }
+
+  Sim3d Get(const Eigen::Index idx) const {
+    THROW_CHECK_LT(idx, Size());
+    return Sim3d(scales(idx),
+                 Eigen::Quaterniond(rotations.row(idx).transpose()),
+                 translations.row(idx).transpose());
+  }
+
+  std::vector<Sim3d> ToList() const {
+    std::vector<Sim3d> poses(Size());
+    for (Eigen::Index i = 0; i < Size(); ++i) {
+      poses[i] = Get(i);
+    }
+    return poses;
+  }
+
+  Sim3dArray Inverse() const {
+    Sim3dArray inverse;
+    inverse.scales = scales.cwiseInverse();
+    inverse.rotations = ConjugateQuaternions(rotations);
+    inverse.translations =
+        -(RotateVectors(inverse.rotations, translations).array().colwise() *
+          inverse.scales.array())
+             .matrix();
+    return inverse;
+  }
+
+  Vector3dArray Apply(const Vector3dArray& points) const {
+    const Eigen::Index n = BroadcastSize(Size(), points.rows());
+    return (RotateVectors(Broadcast(rotations, n), Broadcast(points, n))
+                .array()
+                .colwise() *
+            Broadcast(scales, n).array())
+               .matrix() +
+           Broadcast(translations, n);
+  }
+
+  py::array_t<double> ToMatrices() const {
+    py::array_t<double> matrices(std::vector<size_t>{
+        static_cast<size_t>(Size()), size_t(3), size_t(4)});
+    auto matrices_data = matrices.mutable_unchecked<3>();
+    for (Eigen::Index i = 0; i < Size(); ++i) {
+      const Eigen::Matrix3x4d matrix = Get(i).ToMatrix();
+      for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 4; ++c) {
+          matrices_data(i, r, c) = matrix(r, c);
+        }
+      }
+    }
+    return matrices;
+  }
+
+  // The scales are the norms of the first columns, as in Sim3d::FromMatrix.
+  static Sim3dArray FromMatrices(const py::array_t<double>& matrices) {
+    CheckMatricesShape(matrices);
+    const auto matrices_data = matrices.unchecked<3>();
+    Sim3dArray poses;
+    poses.scales.resize(matrices.shape(0));
+    poses.rotations.resize(matrices.shape(0), 4);
+    poses.translations.resize(matrices.shape(0), 3);
+    for (py::ssize_t i = 0; i < matrices.shape(0); ++i) {
+      Eigen::Matrix3d rotation;
+      for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+          rotation(r, c) = matrices_data(i, r, c);
+        }
+        poses.translations(i, r) = matrices_data(i, r, 3);
+      }
+      poses.scales(i) = rotation.col(0).norm();
+      THROW_CHECK_GT(poses.scales(i), 0);
+      poses.rotations.row(i) =
+          Eigen::Quaterniond(rotation / poses.scales(i))
+              .normalized()
+              .coeffs()
+              .transpose();
+    }
+    return poses;
+  }
+};
+
+Sim3dArray operator*(const Sim3dArray& a, const Sim3dArray& b) {
+  const Eigen::Index n = BroadcastSize(a.Size(), b.Size());
+  const Eigen::VectorXd a_scales = Broadcast(a.scales, n);
+  const QuaternionArray a_rotations = Broadcast(a.rotations, n);
+  Sim3dArray c;
+  c.scales = a_scales.cwiseProduct(Broadcast(b.scales, n));
+  c.rotations = MultiplyQuaternions(a_rotations, Broadcast(b.rotations, n));
+  c.translations =
+      (RotateVectors(a_rotations, Broadcast(b.translations, n))
+           .array()
+           .colwise() *
+       a_scales.array())
+          .matrix() +
+      Broadcast(a.translations, n);
+  return c;
+}
+
+// Interpolate the poses of a trajectory sampled at increasing times with the
+// same scheme as InterpolateCameraPoses: slerp of the rotations and lerp of
+// the translations between the bracketing samples. Query times outside of the
+// trajectory are clamped to its ends.
+Rigid3dArray InterpolateTrajectory(const Eigen::VectorXd& times,
+                                   const Rigid3dArray& poses,
+                                   const Eigen::VectorXd& query_times,
+                                   const int num_threads) {
+  THROW_CHECK_EQ(times.size(), poses.Size());
+  THROW_CHECK_GT(times.size(), 0);
+  for (Eigen::Index i = 1; i < times.size(); ++i) {
+    THROW_CHECK_LT(times(i - 1), times(i));
+  }
+
+  const Eigen::Index num_queries = query_times.size();
+  Rigid3dArray interpolated;
+  interpolated.rotations.resize(num_queries, 4);
+  interpolated.translations.resize(num_queries, 3);
+  if (times.size() == 1) {
+    interpolated.rotations = Broadcast(poses.rotations, num_queries);
+    interpolated.translations = Broadcast(poses.translations, num_queries);
+    return interpolated;
+  }
+
+  py::gil_scoped_release release;
+  ParallelFor(
+      num_queries, num_threads, [&](size_t, size_t begin, size_t end) {
+        // Gather the bracketing samples of the chunk to interpolate them with
+        // vectorized kernels.
+        const Eigen::Index num_chunk_queries = end - begin;
+        QuaternionArray rotations1(num_chunk_queries, 4);
+        QuaternionArray rotations2(num_chunk_queries, 4);
+        Vector3dArray translations1(num_chunk_queries, 3);
+        Vector3dArray translations2(num_chunk_queries, 3);
+        Eigen::ArrayXd t(num_chunk_queries);
+        for (Eigen::Index i = 0; i < num_chunk_queries; ++i) {
+          const double query_time = query_times(begin + i);
+          const Eigen::Index upper_idx =
+              std::upper_bound(
+                  times.data(), times.data() + times.size(), query_time) -
+              times.data();
+          const Eigen::Index idx2 = std::min<Eigen::Index>(
+              std::max<Eigen::Index>(upper_idx, 1), times.size() - 1);
+          const Eigen::Index idx1 = idx2 - 1;
+          rotations1.row(i) = poses.rotations.row(idx1);
+          rotations2.row(i) = poses.rotations.row(idx2);
+          translations1.row(i) = poses.translations.row(idx1);
+          translations2.row(i) = poses.translations.row(idx2);
+          const double ratio =
+              (query_time - times(idx1)) / (times(idx2) - times(idx1));
+          t(i) = std::min(1.0, std::max(0.0, ratio));
+        }
+        interpolated.rotations.middleRows(begin, num_chunk_queries) =
+            SlerpQuaternions(rotations1, rotations2, t);
+        interpolated.translations.middleRows(begin, num_chunk_queries) =
+            translations1 +
+            ((translations2 - translations1).array().colwise() * t).matrix();
+      });
+  return interpolated;
+}
+
+void init_pose_array(py::module& m) {
+  py::class_<Rigid3dArray>(m, "Rigid3dArray")
+      .def(py::init<>())
+      .def(py::init<const QuaternionArray&, const Vector3dArray&>(),
+           "rotations"_a,
+           "translations"_a,
+           "Rotations as Nx4 quaternions (x, y, z, w) and Nx3 translations.")
+      .def(py::init<const std::vector<Rigid3d>&>(), "poses"_a)
+      .def_static("from_matrices",
+                  &Rigid3dArray::FromMatrices,
+                  "matrices"_a,
+                  "Create from an Nx3x4 or Nx4x4 array.")
+      .def_readonly("rotations", &Rigid3dArray::rotations)
+      .def_readonly("translations", &Rigid3dArray::translations)
+      .def("to_matrices", &Rigid3dArray::ToMatrices, "Nx3x4 array.")
+      .def("to_list", &Rigid3dArray::ToList)
+      .def("inverse", &Rigid3dArray::Inverse)
+      .def("apply",
+           &Rigid3dArray::Apply,
+           "points"_a,
+           "Transform Nx3 points, broadcasting a single pose or point.")
+      .def(py::self * py::self)
+      .def("__len__", &Rigid3dArray::Size)
+      .def("__getitem__",
+           [](const Rigid3dArray& self, Eigen::Index idx) {
+             if (idx < 0) idx += self.Size();
+             if (idx < 0 || idx >= self.Size()) throw py::index_error();
+             return self.Get(idx);
+           })
+      .def("__repr__", [](const Rigid3dArray& self) {
+        std::stringstream ss;
+        ss << "Rigid3dArray(size=" << self.Size() << ")";
+        return ss.str();
+      });
+
+  py::class_<Sim3dArray>(m, "Sim3dArray")
+      .def(py::init<>())
+      .def(py::init<const Eigen::VectorXd&,
+                    const QuaternionArray&,
+                    const Vector3dArray&>(),
+           "scales"_a,
+           "rotations"_a,
+           "translations"_a,
+           "N scales, Nx4 quaternions (x, y, z, w), and Nx3 translations.")
+      .def(py::init<const std::vector<Sim3d>&>(), "poses"_a)
+      .def_static("from_matrices",
+                  &Sim3dArray::FromMatrices,
+                  "matrices"_a,
+                  "Create from an Nx3x4 or Nx4x4 array.")
+      .def_readonly("scales", &Sim3dArray::scales)
+      .def_readonly("rotations", &Sim3dArray::rotations)
+      .def_readonly("translations", &Sim3dArray::translations)
+      .def("to_matrices", &Sim3dArray::ToMatrices, "Nx3x4 array.")
+      .def("to_list", &Sim3dArray::ToList)
+      .def("inverse", &Sim3dArray::Inverse)
+      .def("apply",
+           &Sim3dArray::Apply,
+           "points"_a,
+           "Transform Nx3 points, broadcasting a single pose or point.")
+      .def(py::self * py::self)
+      .def("__len__", &Sim3dArray::Size)
+      .def("__getitem__",
+           [](const Sim3dArray& self, Eigen::Index idx) {
+             if (idx < 0) idx += self.Size();
+             if (idx < 0 || idx >= self.Size()) throw py::index_error();
+             return self.Get(idx);
+           })
+      .def("__repr__", [](const Sim3dArray& self) {
+        std::stringstream ss;
+        ss << "Sim3dArray(size=" << self.Size() << ")";
+        return ss.str();
+      });
+
+  m.def("interpolate_trajectory",
+        &InterpolateTrajectory,
+        "times"_a,
+        "poses"_a,
+        "query_times"_a,
+        "num_threads"_a = -1,
+        "Interpolate a trajectory of poses sampled at increasing times at\n"
+        "the query times, as Rigid3d.interpolate between the bracketing\n"
+        "samples. Query times outside of the trajectory are clamped to its\n"
+        "ends. Returns a Rigid3dArray.");
+  m.def(
+      "interpolate_trajectory",
+      [](const Eigen::VectorXd& times,
+         const std::vector<Rigid3d>& poses,
+         const Eigen::VectorXd& query_times,
+         const int num_threads) {
+        return InterpolateTrajectory(
+            times, Rigid3dArray(poses), query_times, num_threads);
+      },
+      "times"_a,
+      "poses"_a,
+      "query_times"_a,
+      "num_threads"_a = -1);
+}
@@ -15,6 +15,7 @@ using namespace pybind11::literals;
 #include <iostream>
 #include <regex>
 #include <string>
+#include <vector>
 
 #include "log_exceptions.h"
 
@@ -191,6 +192,56 @@ inline void make_dataclass(py::class_<T> cls) {
   });
 }
 
+// Repr of a map with at most max_num_items items, followed by the number of
+// omitted items, so that printing large maps stays fast.
+template <typename MapType, typename Func>
+std::string PrintMapTruncated(const MapType& map,
+                              Func&& print_value,
+                              const size_t max_num_items = 10) {
+  std::string repr = "{";
+  size_t num_items = 0;
+  for (auto& pair : map) {
+    if (num_items == max_num_items) {
+      break;
+    }
+    if (num_items > 0) {
+      repr += ", ";
+    }
+    repr += std::to_string(pair.first) + ": " + print_value(pair.second);
+    num_items += 1;
+  }
+  if (map.size() > num_items) {
+    repr += ", ... (" + std::to_string(map.size() - num_items) + " more)";
+  }
+  repr += "}";
+  return repr;
+}
+
+// Keys of a map as a numpy array, in iteration order.
+template <typename MapType>
+py::array_t<typename MapType::key_type> MapKeysArray(const MapType& map) {
+  py::array_t<typename MapType::key_type> keys(map.size());
+  auto keys_data = keys.mutable_unchecked<1>();
+  size_t i = 0;
+  for (auto& pair : map) {
+    keys_data(i++) = pair.first;
+  }
+  return keys;
+}
+
+// Keys of all map items that satisfy a predicate as a numpy array.
+template <typename MapType, typename Func>
+py::array_t<typename MapType::key_type> MapKeysWhere(const MapType& map,
+                                                     Func&& predicate) {
+  std::vector<typename MapType::key_type> keys;
+  for (auto& pair : map) {
+    if (predicate(pair.second)) {
+      keys.push_back(pair.first);
+    }
+  }
+  return py::array_t<typename MapType::key_type>(keys.size(), keys.data());
+}
+
 // Catch python keyboard interrupts
 
 /*
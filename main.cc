@@ -13,7 +13,9 @@ using namespace pybind11::literals;
 #include "estimators/fundamental_matrix.cc"
 #include "estimators/generalized_absolute_pose.cc"
 #include "estimators/homography.cc"
+#include "estimators/triangulation.cc"
 #include "estimators/two_view_geometry.cc"
+#include "geometry/pose_array.cc"
 #include "geometry/quaternion.cc"
 #include "geometry/rigid3.cc"
 #include "geometry/sim3.cc"
@@ -51,6 +53,7 @@ PYBIND11_MODULE(pycolmap, m) {
   init_quaternion(m);
   init_sim3(m);
   init_rigid3(m);
+  init_pose_array(m);
 
   // Estimators
   auto PyRANSACOptions =
@@ -80,6 +83,7 @@ PYBIND11_MODULE(pycolmap, m) {
   bind_homography_estimation(m);
   bind_two_view_geometry_estimation(m);
   bind_alignment(m);
+  bind_triangulation(m);
 
   // Homography Decomposition.
   m.def("homography_decomposition",
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "log_exceptions.h"
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+    const std::string error = Map(path);
+    if (!error.empty()) {
+      Unmap();
+      THROW_CHECK_MSG(false, error + " " + path);
+    }
+  }
+
+  ~MappedFile() { Unmap(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* Begin() const { return data_; }
+  const char* End() const { return data_ + size_; }
+  size_t Size() const { return size_; }
+
+ private:
+  // Map the file and return an error message on failure, after which the
+  // resources acquired so far are released by Unmap.
+  std::string Map(const std::string& path) {
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(),
+                        GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_DELETE,
+                        nullptr,
+                        OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN,
+                        nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      return "Could not open";
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size)) {
+      return "Could not stat";
+    }
+    size_ = static_cast<size_t>(file_size.QuadPart);
+    if (size_ > 0) {
+      // Empty files cannot be mapped.
+      mapping_ =
+          CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping_ == nullptr) {
+        return "Could not map";
+      }
+      data_ = static_cast<const char*>(
+          MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+      if (data_ == nullptr) {
+        return "Could not map";
+      }
+    }
+#else
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      return "Could not open";
+    }
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) != 0) {
+      return "Could not stat";
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+      void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+      if (data == MAP_FAILED) {
+        return "Could not map";
+      }
+      madvise(data, size_, MADV_SEQUENTIAL);
+      data_ = static_cast<const char*>(data);
+    }
+#endif
+    return "";
+  }
+
+  void Unmap() {
+#ifdef _WIN32
+    if (data_ != nullptr) {
+      UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+      CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(file_);
+    }
+    mapping_ = nullptr;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    fd_ = -1;
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Locale-independent and correctly rounded parsing of decimal numbers. The
+// significant digits, at most 19 of which fit into 64 bits, and the decimal
+// exponent are converted with the algorithm of Eisel and Lemire, see "Number
+// Parsing at a Gigabyte per Second", D. Lemire, Software: Practice and
+// Experience 2021, and "Fast Number Parsing Without Fallback", N. Mushtak and
+// D. Lemire, Software: Practice and Experience 2023, as in fast_float. Only
+// numbers with more than 19 significant digits may need a slow fallback.
+
+struct UInt128 {
+  uint64_t high = 0;
+  uint64_t low = 0;
+};
+
+inline UInt128 MultiplyFull(const uint64_t a, const uint64_t b) {
+  UInt128 product;
+#if defined(_MSC_VER) && defined(_M_X64)
+  product.low = _umul128(a, b, &product.high);
+#elif defined(__SIZEOF_INT128__)
+  const unsigned __int128 full = static_cast<unsigned __int128>(a) * b;
+  product.high = static_cast<uint64_t>(full >> 64);
+  product.low = static_cast<uint64_t>(full);
+#else
+  const uint64_t a_low = a & 0xFFFFFFFF;
+  const uint64_t a_high = a >> 32;
+  const uint64_t b_low = b & 0xFFFFFFFF;
+  const uint64_t b_high = b >> 32;
+  const uint64_t low_low = a_low * b_low;
+  const uint64_t high_low = a_high * b_low;
+  const uint64_t low_high = a_low * b_high;
+  const uint64_t middle =
+      (low_low >> 32) + (high_low & 0xFFFFFFFF) + (low_high & 0xFFFFFFFF);
+  product.low = (middle << 32) | (low_low & 0xFFFFFFFF);
+  product.high =
+      a_high * b_high + (high_low >> 32) + (low_high >> 32) + (middle >> 32);
+#endif
+  return product;
+}
+
+inline int CountLeadingZeros(const uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return 63 - static_cast<int>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+  return __builtin_clzll(value);
+#else
+  int count = 0;
+  for (uint64_t bit = uint64_t(1) << 63; (value & bit) == 0; bit >>= 1) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
+// Non-negative integer of base-2^32 limbs, least significant first, with the
+// few operations needed to tabulate the powers of five.
+class SmallBigInt {
+ public:
+  explicit SmallBigInt(const uint32_t value) : limbs_(1, value) {}
+
+  static SmallBigInt PowerOfTwo(const int exponent) {
+    SmallBigInt value(0);
+    value.limbs_.assign(exponent / 32 + 1, 0);
+    value.limbs_.back() = uint32_t(1) << (exponent % 32);
+    return value;
+  }
+
+  void Multiply(const uint32_t factor) {
+    uint64_t carry = 0;
+    for (uint32_t& limb : limbs_) {
+      const uint64_t product = static_cast<uint64_t>(limb) * factor + carry;
+      limb = static_cast<uint32_t>(product);
+      carry = product >> 32;
+    }
+    if (carry != 0) {
+      limbs_.push_back(static_cast<uint32_t>(carry));
+    }
+  }
+
+  // Floor division.
+  void Divide(const uint32_t divisor) {
+    uint64_t remainder = 0;
+    for (size_t i = limbs_.size(); i-- > 0;) {
+      const uint64_t value = (remainder << 32) | limbs_[i];
+      limbs_[i] = static_cast<uint32_t>(value / divisor);
+      remainder = value % divisor;
+    }
+    Trim();
+  }
+
+  void AddOne() {
+    for (uint32_t& limb : limbs_) {
+      if (++limb != 0) {
+        return;
+      }
+    }
+    limbs_.push_back(1);
+  }
+
+  int BitLength() const {
+    return 32 * static_cast<int>(limbs_.size() - 1) +
+           (64 - CountLeadingZeros(limbs_.back()));
+  }
+
+  // The 128 most significant bits, i.e. the value shifted right to a bit
+  // length of 128 or left to a bit length of at most 128.
+  UInt128 Top128() const {
+    const int shift = BitLength() - 128;
+    UInt128 result;
+    for (int bit = 127; bit >= 0; --bit) {
+      const int source_bit = bit + shift;
+      if (source_bit < 0) {
+        break;
+      }
+      if ((limbs_[source_bit / 32] >> (source_bit % 32)) & 1) {
+        if (bit >= 64) {
+          result.high |= uint64_t(1) << (bit - 64);
+        } else {
+          result.low |= uint64_t(1) << bit;
+        }
+      }
+    }
+    return result;
+  }
+
+ private:
+  void Trim() {
+    while (limbs_.size() > 1 && limbs_.back() == 0) {
+      limbs_.pop_back();
+    }
+  }
+
+  std::vector<uint32_t> limbs_;
+};
+
+const int kMinDecimalExponent = -342;
+const int kMaxDecimalExponent = 308;
+
+// The 128-bit mantissas of the powers of five 5^q for q in
+// [kMinDecimalExponent, kMaxDecimalExponent], normalized so that the most
+// significant bit is set. Positive powers are truncated and negative powers
+// rounded up, as in the tables of fast_float, computed once at first use.
+inline const std::vector<UInt128>& PowersOfFive128() {
+  static const std::vector<UInt128> table = [] {
+    std::vector<UInt128> table;
+    table.reserve(kMaxDecimalExponent - kMinDecimalExponent + 1);
+    for (int q = kMinDecimalExponent; q < 0; ++q) {
+      SmallBigInt power_of_five(1);
+      for (int i = 0; i < -q; ++i) {
+        power_of_five.Multiply(5);
+      }
+      // Smallest z with 2^z >= 5^-q, which is never a power of two.
+      const int z = power_of_five.BitLength();
+      SmallBigInt value =
+          SmallBigInt::PowerOfTwo(q >= -27 ? z + 127 : 2 * z + 128);
+      for (int i = 0; i < -q; ++i) {
+        value.Divide(5);
+      }
+      value.AddOne();
+      table.push_back(value.Top128());
+    }
+    SmallBigInt power_of_five(1);
+    for (int q = 0; q <= kMaxDecimalExponent; ++q) {
+      table.push_back(power_of_five.Top128());
+      power_of_five.Multiply(5);
+    }
+    return table;
+  }();
+  return table;
+}
+
+// The correctly rounded double of w * 10^q.
+inline double DecimalToDouble(uint64_t w, const int64_t q) {
+  const int kMantissaBits = 52;
+  const int kInfinitePower = 0x7FF;
+  if (w == 0 || q < kMinDecimalExponent) {
+    return 0;
+  }
+  if (q > kMaxDecimalExponent) {
+    return std::numeric_limits<double>::infinity();
+  }
+  // Exact conversion if both the digits and the power of ten are exact.
+  if (w <= (uint64_t(1) << 53) && q >= -22 && q <= 22) {
+    static const double kPowersOfTen[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const double value = static_cast<double>(w);
+    return q < 0 ? value / kPowersOfTen[-q] : value * kPowersOfTen[q];
+  }
+
+  const int lz = CountLeadingZeros(w);
+  w <<= lz;
+  const UInt128& power_of_five = PowersOfFive128()[q - kMinDecimalExponent];
+  UInt128 product = MultiplyFull(w, power_of_five.high);
+  // The lower half of the power only matters if the bits below the rounded
+  // mantissa may carry.
+  const uint64_t kPrecisionMask = ~uint64_t(0) >> (kMantissaBits + 3);
+  if ((product.high & kPrecisionMask) == kPrecisionMask) {
+    const UInt128 low_product = MultiplyFull(w, power_of_five.low);
+    product.low += low_product.high;
+    if (low_product.high > product.low) {
+      ++product.high;
+    }
+  }
+
+  const int upper_bit = static_cast<int>(product.high >> 63);
+  const int shift = upper_bit + 64 - kMantissaBits - 3;
+  uint64_t mantissa = product.high >> shift;
+  // Binary exponent, with log2(10) ~ 217706 / 2^16, biased by 1023.
+  int64_t power2 = (((152170 + 65536) * q) >> 16) + 63 + upper_bit - lz + 1023;
+  if (power2 <= 0) {
+    // Subnormal numbers.
+    if (-power2 + 1 >= 64) {
+      return 0;
+    }
+    mantissa >>= -power2 + 1;
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    power2 = mantissa < (uint64_t(1) << kMantissaBits) ? 0 : 1;
+  } else {
+    // Round half to even, where ties are only possible for small exponents.
+    if (product.low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+        (mantissa << shift) == product.high) {
+      mantissa &= ~uint64_t(1);
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (uint64_t(2) << kMantissaBits)) {
+      mantissa = uint64_t(1) << kMantissaBits;
+      ++power2;
+    }
+    mantissa &= ~(uint64_t(1) << kMantissaBits);
+    if (power2 >= kInfinitePower) {
+      return std::numeric_limits<double>::infinity();
+    }
+  }
+  const uint64_t bits = mantissa | (static_cast<uint64_t>(power2) << 52);
+  double value;
+  std::memcpy(&value, &bits, sizeof(double));
+  return value;
+}
+
+inline bool EqualsIgnoreCase(const char* begin,
+                             const char* end,
+                             const char* lowercase) {
+  const size_t length = std::strlen(lowercase);
+  if (static_cast<size_t>(end - begin) != length) {
+    return false;
+  }
+  for (size_t i = 0; i < length; ++i) {
+    const char c = begin[i];
+    if ((c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c) != lowercase[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parse the number in [begin, end), in the format written by streams and
+// printf, including inf and nan, and return whether it is valid.
+inline bool ParseDouble(const char* begin, const char* end, double* value) {
+  const char* ptr = begin;
+  const bool negative = ptr < end && *ptr == '-';
+  if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+    ++ptr;
+  }
+  if (EqualsIgnoreCase(ptr, end, "inf") ||
+      EqualsIgnoreCase(ptr, end, "infinity")) {
+    *value = negative ? -std::numeric_limits<double>::infinity()
+                      : std::numeric_limits<double>::infinity();
+    return true;
+  }
+  if (EqualsIgnoreCase(ptr, end, "nan")) {
+    *value = std::numeric_limits<double>::quiet_NaN();
+    return true;
+  }
+
+  const int kMaxNumDigits = 19;
+  uint64_t mantissa = 0;
+  int64_t exponent = 0;
+  int num_digits = 0;
+  bool has_digits = false;
+  // Whether non-zero digits beyond the first kMaxNumDigits were dropped.
+  bool truncated = false;
+  const auto parse_digit = [&](const bool fractional) {
+    has_digits = true;
+    if (num_digits < kMaxNumDigits) {
+      mantissa = 10 * mantissa + static_cast<uint64_t>(*ptr - '0');
+      if (mantissa != 0) {
+        ++num_digits;
+      }
+      if (fractional) {
+        --exponent;
+      }
+    } else {
+      if (!fractional) {
+        ++exponent;
+      }
+      truncated |= *ptr != '0';
+    }
+    ++ptr;
+  };
+  while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+    parse_digit(/*fractional=*/false);
+  }
+  if (ptr < end && *ptr == '.') {
+    ++ptr;
+    while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+      parse_digit(/*fractional=*/true);
+    }
+  }
+  if (!has_digits) {
+    return false;
+  }
+  if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+    ++ptr;
+    const bool negative_exponent = ptr < end && *ptr == '-';
+    if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+      ++ptr;
+    }
+    const char* exponent_begin = ptr;
+    int64_t explicit_exponent = 0;
+    while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+      // Larger exponents overflow or underflow anyway.
+      if (explicit_exponent < 100000) {
+        explicit_exponent = 10 * explicit_exponent + (*ptr - '0');
+      }
+      ++ptr;
+    }
+    if (ptr == exponent_begin) {
+      return false;
+    }
+    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+  }
+  if (ptr != end) {
+    return false;
+  }
+
+  double result = DecimalToDouble(mantissa, exponent);
+  if (truncated && DecimalToDouble(mantissa + 1, exponent) != result) {
+    // The dropped digits decide the rounding: convert with a stream in the
+    // classic locale, which is slow but exact.
+    std::istringstream stream(std::string(begin, end));
+    stream.imbue(std::locale::classic());
+    stream >> result;
+    if (stream.fail()) {
+      return false;
+    }
+    *value = result;
+    return true;
+  }
+  *value = negative ? -result : result;
+  return true;
+}
@@ -7,10 +7,21 @@
 #include "colmap/exe/feature.h"
 #include "colmap/exe/sfm.h"
 #include "colmap/feature/sift.h"
+#include "colmap/scene/database.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/misc.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 using namespace colmap;
 
 #include <pybind11/iostream.h>
@@ -23,8 +34,194 @@ using namespace pybind11::literals;
 
 #include "helpers.h"
 #include "log_exceptions.h"
+#include "pipeline/feature_cache.h"
+#include "pipeline/keypoint_selection.h"
 #include "utils.h"
 
+// The names of the images assigned to a shard by the hash of their names, out
+// of the given names or, if empty, of all files in the image directory.
+std::vector<std::string> ShardImageList(const std::string& image_path,
+                                        std::vector<std::string> image_list,
+                                        const int shard_index,
+                                        const int num_shards) {
+  if (image_list.empty()) {
+    const std::string root = EnsureTrailingSlash(image_path);
+    for (const std::string& path : GetRecursiveFileList(image_path)) {
+      THROW_CHECK(StringStartsWith(path, root));
+      image_list.push_back(path.substr(root.size()));
+    }
+  }
+  std::vector<std::string> shard_image_list;
+  for (const std::string& image_name : image_list) {
+    if (ShardOfKey(image_name, num_shards) ==
+        static_cast<size_t>(shard_index)) {
+      shard_image_list.push_back(image_name);
+    }
+  }
+  std::sort(shard_image_list.begin(), shard_image_list.end());
+  return shard_image_list;
+}
+
+// Serialization of the options that affect the cameras and features that
+// the image reader and the extractor infer from an image file.
+std::string ImageFeatureCacheOptionsKey(
+    const ImageReaderOptions& reader_options,
+    const SiftExtractionOptions& options) {
+  std::ostringstream stream;
+  stream << std::setprecision(17) << SiftExtractionOptionsKey(options) << ","
+         << reader_options.camera_model << "," << reader_options.camera_params
+         << "," << reader_options.default_focal_length_factor << ","
+         << reader_options.single_camera << ","
+         << reader_options.single_camera_per_folder << ","
+         << reader_options.single_camera_per_image;
+  return stream.str();
+}
+
+// Read the camera and features of an image from a database, if it exists and
+// has features.
+bool ReadDatabaseFeatures(const Database& database,
+                          const std::string& image_name,
+                          CachedFeatures* features) {
+  if (!database.ExistsImageWithName(image_name)) {
+    return false;
+  }
+  const Image image = database.ReadImageWithName(image_name);
+  if (!database.ExistsKeypoints(image.ImageId())) {
+    return false;
+  }
+  features->camera = database.ReadCamera(image.CameraId());
+  features->position_prior = image.CamFromWorldPrior().translation;
+  features->keypoints = database.ReadKeypoints(image.ImageId());
+  features->descriptors = database.ReadDescriptors(image.ImageId());
+  return true;
+}
+
+// Write the images with the features given by read_features(i, &features) to
+// the database, in the given order. Cameras are shared as by the image
+// reader, also with the images already in the database, and images whose
+// dimensions differ from those of a shared or existing camera are skipped.
+// Returns the images whose features could not be read.
+template <typename Func>
+std::vector<std::string> WriteImageFeatures(
+    const std::string& database_path,
+    const ImageReaderOptions& reader_options,
+    const std::vector<std::string>& image_names,
+    Func&& read_features) {
+  const camera_t existing_camera_id =
+      static_cast<camera_t>(reader_options.existing_camera_id);
+  const bool shared_cameras = reader_options.single_camera ||
+                              reader_options.single_camera_per_folder;
+  // Images of the same folder, or all images, share a camera.
+  const auto camera_group = [&reader_options](const std::string& image_name) {
+    return reader_options.single_camera_per_folder ? GetParentDir(image_name)
+                                                   : std::string();
+  };
+
+  Database database(database_path);
+  std::unordered_map<std::string, camera_t> camera_ids;
+  if (shared_cameras) {
+    for (const Image& image : database.ReadAllImages()) {
+      camera_ids.emplace(camera_group(image.Name()), image.CameraId());
+    }
+  }
+
+  DatabaseTransaction database_transaction(&database);
+  std::vector<std::string> missing_image_names;
+  for (size_t i = 0; i < image_names.size(); ++i) {
+    CachedFeatures features;
+    if (!read_features(i, &features)) {
+      missing_image_names.push_back(image_names[i]);
+      continue;
+    }
+    // As the image reader, skip the images whose size differs from that of
+    // the camera they would share.
+    camera_t camera_id = existing_camera_id;
+    if (camera_id == kInvalidCameraId && shared_cameras) {
+      const auto group_camera_id =
+          camera_ids.find(camera_group(image_names[i]));
+      if (group_camera_id != camera_ids.end()) {
+        camera_id = group_camera_id->second;
+      }
+    }
+    if (camera_id == kInvalidCameraId) {
+      camera_id = database.WriteCamera(features.camera);
+      if (shared_cameras) {
+        camera_ids.emplace(camera_group(image_names[i]), camera_id);
+      }
+    } else {
+      const Camera camera = database.ReadCamera(camera_id);
+      if (camera.Width() != features.camera.Width() ||
+          camera.Height() != features.camera.Height()) {
+        std::cout << "  Skipping " << image_names[i]
+                  << ": its dimensions differ from those of its camera."
+                  << std::endl;
+        continue;
+      }
+    }
+    Image image;
+    image.SetName(image_names[i]);
+    image.SetCameraId(camera_id);
+    image.CamFromWorldPrior().translation = features.position_prior;
+    const image_t image_id = database.WriteImage(image);
+    database.WriteKeypoints(image_id, features.keypoints);
+    database.WriteDescriptors(image_id, features.descriptors);
+  }
+  return missing_image_names;
+}
+
+// Add the features of the given images of the database to the cache. Files
+// that are not images are not in the database.
+void CacheDatabaseFeatures(const std::string& database_path,
+                           const std::vector<std::string>& image_names,
+                           const std::vector<std::string>& cache_keys,
+                           FeatureCache* cache) {
+  Database database(database_path);
+  for (size_t i = 0; i < image_names.size(); ++i) {
+    CachedFeatures features;
+    if (ReadDatabaseFeatures(database, image_names[i], &features)) {
+      cache->Write(cache_keys[i], features);
+    }
+  }
+}
+
+// Replace the features of all images in the newly extracted database by the
+// selected ones, distributed over the image extents of their cameras. The
+// database is copied one image at a time with the same ids, so that the
+// features of only one image are in memory.
+void SelectDatabaseKeypoints(const std::string& database_path,
+                             const KeypointSelectionOptions& options) {
+  options.Check();
+  const std::string unselected_path = database_path + ".unselected.db";
+  std::remove(unselected_path.c_str());
+  THROW_CHECK_MSG(
+      std::rename(database_path.c_str(), unselected_path.c_str()) == 0,
+      "Could not rename " + database_path);
+  {
+    const Database unselected_database(unselected_path);
+    Database database(database_path);
+    DatabaseTransaction database_transaction(&database);
+    for (const Camera& camera : unselected_database.ReadAllCameras()) {
+      database.WriteCamera(camera, /*use_camera_id=*/true);
+    }
+    for (const Image& image : unselected_database.ReadAllImages()) {
+      database.WriteImage(image, /*use_image_id=*/true);
+      if (!unselected_database.ExistsKeypoints(image.ImageId())) {
+        continue;
+      }
+      const Camera camera = database.ReadCamera(image.CameraId());
+      FeatureKeypoints keypoints =
+          unselected_database.ReadKeypoints(image.ImageId());
+      FeatureDescriptors descriptors =
+          unselected_database.ReadDescriptors(image.ImageId());
+      SelectKeypoints(
+          camera.Width(), camera.Height(), options, &keypoints, &descriptors);
+      database.WriteKeypoints(image.ImageId(), keypoints);
+      database.WriteDescriptors(image.ImageId(), descriptors);
+    }
+  }
+  std::remove(unselected_path.c_str());
+}
+
 void extract_features(const py::object database_path_,
                       const py::object image_path_,
                       const std::vector<std::string> image_list,
@@ -33,7 +230,14 @@ void extract_features(const py::object database_path_,
                       ImageReaderOptions reader_options,
                       SiftExtractionOptions sift_options,
                       const Device device,
-                      bool verbose) {
+                      bool verbose,
+                      const KeypointSelectionOptions& selection_options,
+                      const int shard_index,
+                      const int num_shards,
+                      const FeatureCacheOptions& cache_options) {
+  THROW_CHECK_GT(num_shards, 0);
+  THROW_CHECK_GE(shard_index, 0);
+  THROW_CHECK_LT(shard_index, num_shards);
   std::string database_path = py::str(database_path_).cast<std::string>();
   THROW_CHECK_MSG(!ExistsFile(database_path),
                   database_path + " already exists.");
@@ -50,7 +254,19 @@ void extract_features(const py::object database_path_,
   reader_options.database_path = database_path;
   reader_options.image_path = image_path;
 
-  if (!image_list.empty()) {
+  // The features of an image depend on its mask, which is not hashed.
+  const bool use_cache = cache_options.Enabled() &&
+                         reader_options.mask_path.empty() &&
+                         reader_options.camera_mask_path.empty();
+  if (num_shards > 1 || use_cache) {
+    reader_options.image_list =
+        ShardImageList(image_path, image_list, shard_index, num_shards);
+    if (reader_options.image_list.empty()) {
+      // An empty list would read all images, so only create the database.
+      Database database(database_path);
+      return;
+    }
+  } else if (!image_list.empty()) {
     reader_options.image_list = image_list;
   }
 
@@ -68,11 +284,101 @@ void extract_features(const py::object database_path_,
     oldcout = std::cout.rdbuf(oss.rdbuf());
   }
   py::gil_scoped_release release;
-  std::unique_ptr<Thread> extractor =
-      CreateFeatureExtractorController(reader_options, sift_options);
+  // Without shared cameras, each image gets its own camera, so that its
+  // features and camera do not depend on the other images of the list.
+  const auto extract = [&](const std::vector<std::string>& image_list,
+                           const std::string& output_path,
+                           const bool shared_cameras) {
+    ImageReaderOptions list_reader_options = reader_options;
+    list_reader_options.database_path = output_path;
+    list_reader_options.image_list = image_list;
+    if (!shared_cameras) {
+      list_reader_options.single_camera = false;
+      list_reader_options.single_camera_per_folder = false;
+      list_reader_options.existing_camera_id = -1;
+    }
+    std::unique_ptr<Thread> extractor =
+        CreateFeatureExtractorController(list_reader_options, sift_options);
+    extractor->Start();
+    PyWait(extractor.get());
+  };
+
+  if (use_cache) {
+    FeatureCache cache(cache_options);
+    const std::string options_key =
+        ImageFeatureCacheOptionsKey(reader_options, sift_options);
+    const std::vector<std::string>& image_names = reader_options.image_list;
+    std::vector<std::string> cache_keys(image_names.size());
+    ParallelFor(image_names.size(),
+                sift_options.num_threads,
+                [&](size_t, size_t begin, size_t end) {
+                  for (size_t i = begin; i < end; ++i) {
+                    const MappedFile file(
+                        JoinPaths(image_path, image_names[i]));
+                    cache_keys[i] = FeatureCacheKey(
+                        file.Begin(), file.Size(), options_key);
+                  }
+                });
+    std::vector<std::string> miss_names;
+    std::vector<std::string> miss_keys;
+    for (size_t i = 0; i < image_names.size(); ++i) {
+      if (!cache.Contains(cache_keys[i])) {
+        miss_names.push_back(image_names[i]);
+        miss_keys.push_back(cache_keys[i]);
+      }
+    }
 
-  extractor->Start();
-  PyWait(extractor.get());
+    // The missing features are extracted into a separate database, so that
+    // all images are then written in the order of their names and get the
+    // same ids and cameras whichever of them were cached.
+    const std::string extraction_path = database_path + ".extraction.db";
+    std::remove(extraction_path.c_str());
+    if (!miss_names.empty()) {
+      extract(miss_names, extraction_path, /*shared_cameras=*/false);
+      CacheDatabaseFeatures(extraction_path, miss_names, miss_keys, &cache);
+    }
+    size_t num_cached = 0;
+    std::vector<std::string> missing_names;
+    {
+      const Database extraction_database(extraction_path);
+      missing_names = WriteImageFeatures(
+          database_path,
+          reader_options,
+          image_names,
+          [&](const size_t i, CachedFeatures* features) {
+            if (ReadDatabaseFeatures(
+                    extraction_database, image_names[i], features)) {
+              return true;
+            }
+            if (cache.Read(cache_keys[i], features)) {
+              num_cached += 1;
+              return true;
+            }
+            return false;
+          });
+    }
+    std::remove(extraction_path.c_str());
+
+    // Files that were extracted but are missing are not images. The others
+    // were evicted from the cache by another process in the meantime.
+    std::vector<std::string> evicted_names;
+    std::set_difference(missing_names.begin(),
+                        missing_names.end(),
+                        miss_names.begin(),
+                        miss_names.end(),
+                        std::back_inserter(evicted_names));
+    if (!evicted_names.empty()) {
+      extract(evicted_names, database_path, /*shared_cameras=*/true);
+    }
+    std::cout << "Read the features of " << num_cached << " of "
+              << image_names.size() << " images from the cache." << std::endl;
+  } else {
+    extract(reader_options.image_list, database_path, /*shared_cameras=*/true);
+  }
+
+  if (selection_options.method != KeypointSelectionMethod::NONE) {
+    SelectDatabaseKeypoints(database_path, selection_options);
+  }
 
   if (!verbose) {
     std::cout.rdbuf(oldcout);
@@ -159,6 +465,55 @@ void init_extract_features(py::module& m) {
   make_dataclass(PySiftExtractionOptions);
   auto sift_extraction_options = PySiftExtractionOptions().cast<SEOpts>();
 
+  auto PyKeypointSelectionMethod =
+      py::enum_<KeypointSelectionMethod>(m, "KeypointSelectionMethod")
+          .value("NONE", KeypointSelectionMethod::NONE)
+          .value("ANMS",
+                 KeypointSelectionMethod::ANMS,
+                 "Adaptive non-maximal suppression: keep the keypoints with "
+                 "the largest distance to any significantly stronger "
+                 "keypoint.")
+          .value("GRID",
+                 KeypointSelectionMethod::GRID,
+                 "Select the strongest keypoint of each cell of a grid in "
+                 "turn, then the second strongest, and so on.");
+  AddStringToEnumConstructor(PyKeypointSelectionMethod);
+
+  using KSOpts = KeypointSelectionOptions;
+  auto PyKeypointSelectionOptions =
+      py::class_<KSOpts>(m, "KeypointSelectionOptions")
+          .def(py::init<>())
+          .def_readwrite("method", &KSOpts::method)
+          .def_readwrite("max_num_features",
+                         &KSOpts::max_num_features,
+                         "Number of keypoints to select. The extraction "
+                         "should detect more, see "
+                         "SiftExtractionOptions.max_num_features.")
+          .def_readwrite("anms_robustness",
+                         &KSOpts::anms_robustness,
+                         "A keypoint is only suppressed by keypoints whose "
+                         "scale times the robustness is larger than its own.")
+          .def_readwrite("grid_num_cells",
+                         &KSOpts::grid_num_cells,
+                         "Number of grid cells along the larger image "
+                         "dimension.");
+  make_dataclass(PyKeypointSelectionOptions);
+  auto selection_options = PyKeypointSelectionOptions().cast<KSOpts>();
+
+  using FCOpts = FeatureCacheOptions;
+  auto PyFeatureCacheOptions =
+      py::class_<FCOpts>(m, "FeatureCacheOptions")
+          .def(py::init<>())
+          .def_readwrite("path",
+                         &FCOpts::path,
+                         "Directory of the cache, or empty to disable it.")
+          .def_readwrite("max_size_mb",
+                         &FCOpts::max_size_mb,
+                         "Maximum total size of the cached features, beyond "
+                         "which the least recently used are removed.");
+  make_dataclass(PyFeatureCacheOptions);
+  auto cache_options = PyFeatureCacheOptions().cast<FCOpts>();
+
   /* PIPELINE */
   m.def("extract_features",
         &extract_features,
@@ -171,5 +526,18 @@ void init_extract_features(py::module& m) {
         "sift_options"_a = sift_extraction_options,
         "device"_a = Device::AUTO,
         "verbose"_a = true,
-        "Extract SIFT Features and write them to database");
+        "selection_options"_a = selection_options,
+        "shard_index"_a = 0,
+        "num_shards"_a = 1,
+        "cache_options"_a = cache_options,
+        "Extract SIFT Features and write them to database. With a\n"
+        "selection method, only spatially well-distributed keypoints are\n"
+        "kept among those extracted. With num_shards > 1, only the images\n"
+        "of shard shard_index, assigned by a stable hash of their names, are\n"
+        "extracted, e.g. by separate workers whose databases are then\n"
+        "combined with merge_databases. With a cache path, the features of\n"
+        "image files whose content and options were already extracted are\n"
+        "read from the cache without decoding the images. The images are\n"
+        "then written in the order of their names, so that their ids do not\n"
+        "depend on which were cached.");
 }
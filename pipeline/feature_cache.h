@@ -0,0 +1,332 @@
+#pragma once
+
+#include "colmap/feature/sift.h"
+#include "colmap/feature/types.h"
+#include "colmap/scene/camera.h"
+#include "colmap/sensor/models.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <Eigen/Core>
+#include <boost/filesystem.hpp>
+
+#include "log_exceptions.h"
+#include "mapped_file.h"
+
+struct FeatureCacheOptions {
+  // Directory of the cache, or empty to disable it.
+  std::string path = "";
+
+  // Maximum total size of the cached features, beyond which the least
+  // recently used are removed.
+  int64_t max_size_mb = 10240;
+
+  bool Enabled() const { return !path.empty(); }
+
+  void Check() const { THROW_CHECK_GT(max_size_mb, 0); }
+};
+
+// Features of an image, with the camera and position prior inferred from its
+// file, if any.
+struct CachedFeatures {
+  colmap::Camera camera;
+  Eigen::Vector3d position_prior =
+      Eigen::Vector3d::Constant(std::numeric_limits<double>::quiet_NaN());
+  colmap::FeatureKeypoints keypoints;
+  colmap::FeatureDescriptors descriptors;
+};
+
+// 64-bit FNV-1a hash over words of 8 bytes rather than single bytes, which
+// is several times faster for large images. The xor-shift lets the high bits
+// of the words affect the low bits of the hash.
+inline uint64_t HashBytes(const char* data, const size_t size) {
+  const uint64_t kPrime = 1099511628211ULL;
+  uint64_t hash = 14695981039346656037ULL;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * kPrime;
+    hash ^= hash >> 29;
+  }
+  for (; i < size; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * kPrime;
+  }
+  return hash;
+}
+
+// Serialization of the options that affect the extracted features. The
+// number of threads and the GPU indices do not.
+inline std::string SiftExtractionOptionsKey(
+    const colmap::SiftExtractionOptions& options) {
+  std::ostringstream stream;
+  stream << std::setprecision(17) << options.use_gpu << ","
+         << options.max_image_size << "," << options.max_num_features << ","
+         << options.first_octave << "," << options.num_octaves << ","
+         << options.octave_resolution << "," << options.peak_threshold << ","
+         << options.edge_threshold << "," << options.estimate_affine_shape
+         << "," << options.max_num_orientations << "," << options.upright
+         << "," << options.darkness_adaptivity << ","
+         << options.domain_size_pooling << "," << options.dsp_min_scale << ","
+         << options.dsp_max_scale << "," << options.dsp_num_scales << ","
+         << static_cast<int>(options.normalization);
+  return stream.str();
+}
+
+// Key of the features of the given content, e.g. of an image file, extracted
+// with the options of the given key.
+inline std::string FeatureCacheKey(const char* data,
+                                   const size_t size,
+                                   const std::string& options_key) {
+  std::ostringstream stream;
+  stream << std::hex << std::setfill('0') << std::setw(16)
+         << HashBytes(data, size) << "-" << size << "-" << std::setw(16)
+         << HashBytes(options_key.data(), options_key.size());
+  return stream.str();
+}
+
+// Directory of files of cached features, named by their keys. Files are read
+// by memory mapping and written atomically by renaming, so that several
+// processes can share the cache. The modification time of a file is its last
+// use, by which the least recently used files are removed when the total
+// size exceeds the limit.
+class FeatureCache {
+ public:
+  explicit FeatureCache(const FeatureCacheOptions& options)
+      : path_(options.path),
+        max_size_(static_cast<uint64_t>(options.max_size_mb) << 20) {
+    options.Check();
+    colmap::CreateDirIfNotExists(path_, /*recursive=*/true);
+    for (const Entry& entry : ListEntries()) {
+      size_ += std::get<1>(entry);
+    }
+  }
+
+  bool Contains(const std::string& key) const {
+    return colmap::ExistsFile(EntryPath(key));
+  }
+
+  // Read the features of the key, if they are cached and valid, and mark
+  // them as recently used.
+  bool Read(const std::string& key, CachedFeatures* features) const {
+    const std::string path = EntryPath(key);
+    if (!colmap::ExistsFile(path)) {
+      return false;
+    }
+    try {
+      const MappedFile file(path);
+      if (!Parse(file.Begin(), file.End(), features)) {
+        return false;
+      }
+    } catch (const std::exception&) {
+      // Removed by another process in the meantime.
+      return false;
+    }
+    boost::system::error_code error;
+    boost::filesystem::last_write_time(path, std::time(nullptr), error);
+    return true;
+  }
+
+  void Write(const std::string& key, const CachedFeatures& features) {
+    const colmap::Camera& camera = features.camera;
+    std::string buffer;
+    Append(kMagic, &buffer);
+    Append(kVersion, &buffer);
+    Append(static_cast<int32_t>(camera.ModelId()), &buffer);
+    Append(static_cast<uint64_t>(camera.Width()), &buffer);
+    Append(static_cast<uint64_t>(camera.Height()), &buffer);
+    Append(static_cast<uint8_t>(camera.HasPriorFocalLength()), &buffer);
+    Append(static_cast<uint64_t>(camera.Params().size()), &buffer);
+    for (const double param : camera.Params()) {
+      Append(param, &buffer);
+    }
+    for (int i = 0; i < 3; ++i) {
+      Append(features.position_prior(i), &buffer);
+    }
+    Append(static_cast<uint64_t>(features.keypoints.size()), &buffer);
+    for (const colmap::FeatureKeypoint& keypoint : features.keypoints) {
+      for (const float value : {keypoint.x,
+                                keypoint.y,
+                                keypoint.a11,
+                                keypoint.a12,
+                                keypoint.a21,
+                                keypoint.a22}) {
+        Append(value, &buffer);
+      }
+    }
+    Append(static_cast<uint64_t>(features.descriptors.rows()), &buffer);
+    Append(static_cast<uint64_t>(features.descriptors.cols()), &buffer);
+    buffer.append(reinterpret_cast<const char*>(features.descriptors.data()),
+                  features.descriptors.size());
+
+    // The temporary file is unique across processes by a random token.
+    static const uint64_t process_token =
+        (static_cast<uint64_t>(std::random_device()()) << 32) ^
+        std::random_device()();
+    static std::atomic<uint64_t> num_writes(0);
+    const std::string path = EntryPath(key);
+    const std::string tmp_path = path + "." + std::to_string(process_token) +
+                                 "." + std::to_string(num_writes++);
+    {
+      std::ofstream file(tmp_path, std::ios::trunc | std::ios::binary);
+      THROW_CHECK_MSG(file.is_open(), "Could not open " + tmp_path);
+      file.write(buffer.data(), buffer.size());
+      THROW_CHECK_MSG(file.good(), "Could not write " + tmp_path);
+    }
+    THROW_CHECK_MSG(std::rename(tmp_path.c_str(), path.c_str()) == 0,
+                    "Could not write " + path);
+    size_ += buffer.size();
+    if (size_ > max_size_) {
+      Evict();
+    }
+  }
+
+  // Remove the least recently used files until the total size is within the
+  // limit.
+  void Evict() {
+    std::vector<Entry> entries = ListEntries();
+    std::sort(entries.begin(), entries.end());
+    size_ = 0;
+    for (const Entry& entry : entries) {
+      size_ += std::get<1>(entry);
+    }
+    for (const Entry& entry : entries) {
+      if (size_ <= max_size_) {
+        break;
+      }
+      if (std::remove(std::get<2>(entry).c_str()) == 0) {
+        size_ -= std::get<1>(entry);
+      }
+    }
+  }
+
+ private:
+  // Modification time, size and path of a file.
+  typedef std::tuple<std::time_t, uint64_t, std::string> Entry;
+
+  static constexpr uint32_t kMagic = 0x43464350;  // "PCFC"
+  static constexpr uint32_t kVersion = 1;
+
+  std::string EntryPath(const std::string& key) const {
+    return colmap::JoinPaths(path_, key + ".feat");
+  }
+
+  std::vector<Entry> ListEntries() const {
+    std::vector<Entry> entries;
+    for (const std::string& path : colmap::GetFileList(path_)) {
+      if (!colmap::HasFileExtension(path, ".feat")) {
+        continue;
+      }
+      // Files may be removed by another process in the meantime.
+      boost::system::error_code error;
+      const std::time_t time = boost::filesystem::last_write_time(path, error);
+      if (error) {
+        continue;
+      }
+      const uintmax_t size = boost::filesystem::file_size(path, error);
+      if (!error) {
+        entries.emplace_back(time, static_cast<uint64_t>(size), path);
+      }
+    }
+    return entries;
+  }
+
+  template <typename T>
+  static void Append(const T value, std::string* buffer) {
+    buffer->append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  static bool Next(const char** ptr, const char* end, T* value) {
+    if (end - *ptr < static_cast<std::ptrdiff_t>(sizeof(T))) {
+      return false;
+    }
+    std::memcpy(value, *ptr, sizeof(T));
+    *ptr += sizeof(T);
+    return true;
+  }
+
+  static bool Parse(const char* ptr,
+                    const char* end,
+                    CachedFeatures* features) {
+    uint32_t magic;
+    uint32_t version;
+    int32_t model_id;
+    uint64_t width;
+    uint64_t height;
+    uint8_t prior_focal_length;
+    uint64_t num_params;
+    if (!Next(&ptr, end, &magic) || magic != kMagic ||
+        !Next(&ptr, end, &version) || version != kVersion ||
+        !Next(&ptr, end, &model_id) || !Next(&ptr, end, &width) ||
+        !Next(&ptr, end, &height) || !Next(&ptr, end, &prior_focal_length) ||
+        !Next(&ptr, end, &num_params) ||
+        num_params > static_cast<uint64_t>(end - ptr) / sizeof(double)) {
+      return false;
+    }
+    std::vector<double> params(num_params);
+    for (double& param : params) {
+      Next(&ptr, end, &param);
+    }
+    colmap::Camera& camera = features->camera;
+    if (colmap::ExistsCameraModelWithId(model_id)) {
+      camera.SetModelId(model_id);
+      camera.SetParams(params);
+    }
+    camera.SetWidth(width);
+    camera.SetHeight(height);
+    camera.SetPriorFocalLength(prior_focal_length != 0);
+    for (int i = 0; i < 3; ++i) {
+      if (!Next(&ptr, end, &features->position_prior(i))) {
+        return false;
+      }
+    }
+
+    uint64_t num_keypoints;
+    const size_t keypoint_size = 6 * sizeof(float);
+    if (!Next(&ptr, end, &num_keypoints) ||
+        num_keypoints > static_cast<uint64_t>(end - ptr) / keypoint_size) {
+      return false;
+    }
+    features->keypoints.resize(num_keypoints);
+    for (colmap::FeatureKeypoint& keypoint : features->keypoints) {
+      Next(&ptr, end, &keypoint.x);
+      Next(&ptr, end, &keypoint.y);
+      Next(&ptr, end, &keypoint.a11);
+      Next(&ptr, end, &keypoint.a12);
+      Next(&ptr, end, &keypoint.a21);
+      Next(&ptr, end, &keypoint.a22);
+    }
+
+    uint64_t rows;
+    uint64_t cols;
+    if (!Next(&ptr, end, &rows) || !Next(&ptr, end, &cols) ||
+        rows != num_keypoints ||
+        (rows > 0 && cols > static_cast<uint64_t>(end - ptr) / rows)) {
+      return false;
+    }
+    features->descriptors.resize(rows, cols);
+    std::memcpy(features->descriptors.data(), ptr, rows * cols);
+    return ptr + rows * cols == end;
+  }
+
+  const std::string path_;
+  const uint64_t max_size_;
+  uint64_t size_ = 0;
+};
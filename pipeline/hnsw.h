@@ -0,0 +1,320 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+// Hierarchical navigable small world graph (Malkov and Yashunin, 2018) for
+// approximate nearest-neighbor search of the rows of a matrix, by inner
+// product or Euclidean distance. Nodes can be inserted from several threads
+// concurrently, in which case the graph depends on the order of insertion.
+class HnswIndex {
+ public:
+  typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      Matrix;
+  typedef std::pair<float, uint32_t> Neighbor;
+
+  enum class Metric { INNER_PRODUCT, L2 };
+
+  // The data must outlive the index. max_num_links is the number of links
+  // of the nodes in the upper layers, twice as many are kept in the bottom
+  // layer.
+  HnswIndex(const Matrix& data,
+            const Metric metric,
+            const int max_num_links,
+            const int ef_construction)
+      : data_(data),
+        metric_(metric),
+        max_num_links_(max_num_links),
+        ef_construction_(ef_construction),
+        levels_(data.rows()),
+        links_(data.rows()),
+        node_mutexes_(data.rows()) {
+    const double level_mult = 1.0 / std::log(std::max(max_num_links, 2));
+    for (Eigen::Index i = 0; i < data.rows(); ++i) {
+      // Seeded by node, so that the levels do not depend on the threads.
+      std::mt19937 rng(static_cast<uint32_t>(i));
+      const double u = std::uniform_real_distribution<double>(
+          std::numeric_limits<double>::min(), 1.0)(rng);
+      levels_[i] = static_cast<int>(-std::log(u) * level_mult);
+      links_[i].resize(levels_[i] + 1);
+    }
+  }
+
+  // Insert a node into the graph. Thread-safe.
+  void Insert(const uint32_t node) {
+    std::unique_lock<std::mutex> global_lock(global_mutex_);
+    const int level = levels_[node];
+    const int max_level = max_level_;
+    const uint32_t entry_point = entry_point_;
+    if (max_level < 0) {
+      entry_point_ = node;
+      max_level_ = level;
+      return;
+    }
+    // Keep the lock if the node becomes the new entry point.
+    if (level <= max_level) {
+      global_lock.unlock();
+    }
+
+    const float* query = data_.row(node).data();
+    Neighbor nearest(Distance(query, entry_point), entry_point);
+    for (int l = max_level; l > level; --l) {
+      nearest = SearchGreedy(query, nearest, l, /*lock=*/true);
+    }
+
+    std::unique_ptr<VisitedList> visited = AcquireVisitedList();
+    for (int l = std::min(level, max_level); l >= 0; --l) {
+      std::vector<Neighbor> candidates = SearchLayer(
+          query, nearest, ef_construction_, l, /*lock=*/true, visited.get());
+      nearest = candidates.front();
+      SelectNeighbors(&candidates, max_num_links_);
+      std::vector<uint32_t> node_links(candidates.size());
+      for (size_t i = 0; i < candidates.size(); ++i) {
+        node_links[i] = candidates[i].second;
+      }
+      {
+        std::lock_guard<std::mutex> lock(node_mutexes_[node]);
+        links_[node][l] = node_links;
+      }
+      for (const uint32_t neighbor : node_links) {
+        Link(neighbor, node, l);
+      }
+    }
+    ReleaseVisitedList(std::move(visited));
+
+    if (level > max_level) {
+      entry_point_ = node;
+      max_level_ = level;
+    }
+  }
+
+  // The at most k approximate nearest neighbors of the query sorted by
+  // increasing distance, searched with a beam of max(ef, k) candidates.
+  // Thread-safe, but must not be called concurrently with Insert.
+  void Search(const float* query,
+              const size_t k,
+              const size_t ef,
+              std::vector<Neighbor>* neighbors) const {
+    neighbors->clear();
+    if (max_level_ < 0 || k == 0) {
+      return;
+    }
+    Neighbor nearest(Distance(query, entry_point_), entry_point_);
+    for (int l = max_level_; l > 0; --l) {
+      nearest = SearchGreedy(query, nearest, l, /*lock=*/false);
+    }
+    std::unique_ptr<VisitedList> visited = AcquireVisitedList();
+    *neighbors = SearchLayer(query,
+                             nearest,
+                             std::max(ef, k),
+                             /*level=*/0,
+                             /*lock=*/false,
+                             visited.get());
+    ReleaseVisitedList(std::move(visited));
+    if (neighbors->size() > k) {
+      neighbors->resize(k);
+    }
+  }
+
+ private:
+  // Marks the visited nodes of a search with a tag that is incremented for
+  // each search, so that the marks need not be cleared.
+  struct VisitedList {
+    explicit VisitedList(const size_t num_nodes) : tags(num_nodes, 0) {}
+
+    void Reset() {
+      if (++tag == 0) {
+        std::fill(tags.begin(), tags.end(), 0);
+        tag = 1;
+      }
+    }
+
+    bool Visit(const uint32_t node) {
+      if (tags[node] == tag) {
+        return false;
+      }
+      tags[node] = tag;
+      return true;
+    }
+
+    std::vector<uint32_t> tags;
+    uint32_t tag = 0;
+  };
+
+  float Distance(const float* query, const uint32_t node) const {
+    const Eigen::Map<const Eigen::RowVectorXf> query_vec(query, data_.cols());
+    if (metric_ == Metric::INNER_PRODUCT) {
+      return 1 - query_vec.dot(data_.row(node));
+    }
+    return (query_vec - data_.row(node)).squaredNorm();
+  }
+
+  std::vector<uint32_t> Links(const uint32_t node,
+                              const int level,
+                              const bool lock) const {
+    if (!lock) {
+      return links_[node][level];
+    }
+    std::lock_guard<std::mutex> node_lock(node_mutexes_[node]);
+    return links_[node][level];
+  }
+
+  Neighbor SearchGreedy(const float* query,
+                        Neighbor nearest,
+                        const int level,
+                        const bool lock) const {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (const uint32_t neighbor : Links(nearest.second, level, lock)) {
+        const float distance = Distance(query, neighbor);
+        if (distance < nearest.first) {
+          nearest = Neighbor(distance, neighbor);
+          changed = true;
+        }
+      }
+    }
+    return nearest;
+  }
+
+  // Beam search within a layer. Returns the at most ef nearest nodes found,
+  // sorted by increasing distance.
+  std::vector<Neighbor> SearchLayer(const float* query,
+                                    const Neighbor& entry_point,
+                                    const size_t ef,
+                                    const int level,
+                                    const bool lock,
+                                    VisitedList* visited) const {
+    visited->Reset();
+    visited->Visit(entry_point.second);
+    // Min-heap of the nodes to expand and max-heap of the nearest nodes.
+    std::priority_queue<Neighbor, std::vector<Neighbor>, std::greater<Neighbor>>
+        candidates;
+    std::priority_queue<Neighbor> nearest;
+    candidates.push(entry_point);
+    nearest.push(entry_point);
+    while (!candidates.empty()) {
+      const Neighbor candidate = candidates.top();
+      if (candidate.first > nearest.top().first) {
+        break;
+      }
+      candidates.pop();
+      for (const uint32_t neighbor : Links(candidate.second, level, lock)) {
+        if (!visited->Visit(neighbor)) {
+          continue;
+        }
+        const float distance = Distance(query, neighbor);
+        if (nearest.size() < ef || distance < nearest.top().first) {
+          candidates.emplace(distance, neighbor);
+          nearest.emplace(distance, neighbor);
+          if (nearest.size() > ef) {
+            nearest.pop();
+          }
+        }
+      }
+    }
+    std::vector<Neighbor> neighbors(nearest.size());
+    for (size_t i = neighbors.size(); i > 0; --i) {
+      neighbors[i - 1] = nearest.top();
+      nearest.pop();
+    }
+    return neighbors;
+  }
+
+  // Keep at most max_num_neighbors of the candidates sorted by increasing
+  // distance, skipping those that are closer to an already selected
+  // neighbor than to the query, which keeps links in diverse directions.
+  void SelectNeighbors(std::vector<Neighbor>* candidates,
+                       const size_t max_num_neighbors) const {
+    if (candidates->size() <= max_num_neighbors) {
+      return;
+    }
+    std::vector<Neighbor> selected;
+    selected.reserve(max_num_neighbors);
+    for (const Neighbor& candidate : *candidates) {
+      if (selected.size() >= max_num_neighbors) {
+        break;
+      }
+      const float* candidate_data = data_.row(candidate.second).data();
+      bool keep = true;
+      for (const Neighbor& neighbor : selected) {
+        if (Distance(candidate_data, neighbor.second) < candidate.first) {
+          keep = false;
+          break;
+        }
+      }
+      if (keep) {
+        selected.push_back(candidate);
+      }
+    }
+    *candidates = std::move(selected);
+  }
+
+  // Add a link from node to new_neighbor, pruning the links of node if it
+  // has too many.
+  void Link(const uint32_t node, const uint32_t new_neighbor, const int level) {
+    const size_t max_num_links =
+        level == 0 ? 2 * max_num_links_ : max_num_links_;
+    std::lock_guard<std::mutex> lock(node_mutexes_[node]);
+    std::vector<uint32_t>& node_links = links_[node][level];
+    if (node_links.size() < max_num_links) {
+      node_links.push_back(new_neighbor);
+      return;
+    }
+    const float* node_data = data_.row(node).data();
+    std::vector<Neighbor> candidates;
+    candidates.reserve(node_links.size() + 1);
+    candidates.emplace_back(Distance(node_data, new_neighbor), new_neighbor);
+    for (const uint32_t neighbor : node_links) {
+      candidates.emplace_back(Distance(node_data, neighbor), neighbor);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    SelectNeighbors(&candidates, max_num_links);
+    node_links.resize(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      node_links[i] = candidates[i].second;
+    }
+  }
+
+  std::unique_ptr<VisitedList> AcquireVisitedList() const {
+    {
+      std::lock_guard<std::mutex> lock(visited_lists_mutex_);
+      if (!visited_lists_.empty()) {
+        std::unique_ptr<VisitedList> visited = std::move(visited_lists_.back());
+        visited_lists_.pop_back();
+        return visited;
+      }
+    }
+    return std::unique_ptr<VisitedList>(new VisitedList(data_.rows()));
+  }
+
+  void ReleaseVisitedList(std::unique_ptr<VisitedList> visited) const {
+    std::lock_guard<std::mutex> lock(visited_lists_mutex_);
+    visited_lists_.push_back(std::move(visited));
+  }
+
+  const Matrix& data_;
+  const Metric metric_;
+  const size_t max_num_links_;
+  const size_t ef_construction_;
+  std::vector<int> levels_;
+  // The links of each node in each of its levels.
+  std::vector<std::vector<std::vector<uint32_t>>> links_;
+  mutable std::vector<std::mutex> node_mutexes_;
+  std::mutex global_mutex_;
+  int max_level_ = -1;
+  uint32_t entry_point_ = 0;
+  mutable std::mutex visited_lists_mutex_;
+  mutable std::vector<std::unique_ptr<VisitedList>> visited_lists_;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+// Static kd-tree over 3D points for nearest-neighbor queries bounded by a
+// maximum distance. The tree is implicit: the points are reordered so that
+// each subtree is a contiguous range whose median splits it along the axis of
+// largest extent.
+class KdTree3d {
+ public:
+  explicit KdTree3d(const std::vector<Eigen::Vector3d>& points)
+      : points_(points), idxs_(points.size()), axes_(points.size(), 0) {
+    for (size_t i = 0; i < idxs_.size(); ++i) {
+      idxs_[i] = i;
+    }
+    Build(0, idxs_.size());
+    std::vector<Eigen::Vector3d> ordered_points(points_.size());
+    for (size_t i = 0; i < idxs_.size(); ++i) {
+      ordered_points[i] = points_[idxs_[i]];
+    }
+    points_ = std::move(ordered_points);
+  }
+
+  size_t Size() const { return points_.size(); }
+
+  // The indices of the at most k nearest points within max_distance of the
+  // query, sorted by increasing distance, with their squared distances.
+  void Search(const Eigen::Vector3d& query,
+              const size_t k,
+              const double max_distance,
+              std::vector<std::pair<double, size_t>>* neighbors) const {
+    Search(query, k, max_distance, [](size_t) { return true; }, neighbors);
+  }
+
+  // Same as above, but only for the points whose index satisfies the filter.
+  template <typename Filter>
+  void Search(const Eigen::Vector3d& query,
+              const size_t k,
+              const double max_distance,
+              const Filter& filter,
+              std::vector<std::pair<double, size_t>>* neighbors) const {
+    neighbors->clear();
+    if (k == 0) {
+      return;
+    }
+    SearchState state(k, max_distance * max_distance);
+    Search(query, 0, points_.size(), filter, &state);
+    neighbors->reserve(state.heap.size());
+    while (!state.heap.empty()) {
+      neighbors->emplace_back(state.heap.top().first,
+                              idxs_[state.heap.top().second]);
+      state.heap.pop();
+    }
+    std::reverse(neighbors->begin(), neighbors->end());
+  }
+
+ private:
+  static const size_t kLeafSize = 8;
+
+  struct SearchState {
+    SearchState(const size_t k, const double max_squared_distance)
+        : k(k), max_squared_distance(max_squared_distance) {}
+
+    double MaxSquaredDistance() const {
+      return heap.size() < k ? max_squared_distance : heap.top().first;
+    }
+
+    void Push(const double squared_distance, const size_t idx) {
+      if (squared_distance > MaxSquaredDistance()) {
+        return;
+      }
+      heap.emplace(squared_distance, idx);
+      if (heap.size() > k) {
+        heap.pop();
+      }
+    }
+
+    const size_t k;
+    const double max_squared_distance;
+    // Max-heap of the current neighbors.
+    std::priority_queue<std::pair<double, size_t>> heap;
+  };
+
+  void Build(const size_t begin, const size_t end) {
+    if (end - begin <= kLeafSize) {
+      return;
+    }
+    Eigen::Vector3d min_coords = points_[idxs_[begin]];
+    Eigen::Vector3d max_coords = min_coords;
+    for (size_t i = begin + 1; i < end; ++i) {
+      min_coords = min_coords.cwiseMin(points_[idxs_[i]]);
+      max_coords = max_coords.cwiseMax(points_[idxs_[i]]);
+    }
+    int axis;
+    (max_coords - min_coords).maxCoeff(&axis);
+    const size_t mid = begin + (end - begin) / 2;
+    std::nth_element(idxs_.begin() + begin,
+                     idxs_.begin() + mid,
+                     idxs_.begin() + end,
+                     [this, axis](const size_t idx1, const size_t idx2) {
+                       return points_[idx1](axis) < points_[idx2](axis);
+                     });
+    axes_[mid] = axis;
+    Build(begin, mid);
+    Build(mid + 1, end);
+  }
+
+  template <typename Filter>
+  void Search(const Eigen::Vector3d& query,
+              const size_t begin,
+              const size_t end,
+              const Filter& filter,
+              SearchState* state) const {
+    if (end - begin <= kLeafSize) {
+      for (size_t i = begin; i < end; ++i) {
+        if (filter(idxs_[i])) {
+          state->Push((points_[i] - query).squaredNorm(), i);
+        }
+      }
+      return;
+    }
+    const size_t mid = begin + (end - begin) / 2;
+    const double diff = query(axes_[mid]) - points_[mid](axes_[mid]);
+    if (diff < 0) {
+      Search(query, begin, mid, filter, state);
+    } else {
+      Search(query, mid + 1, end, filter, state);
+    }
+    if (filter(idxs_[mid])) {
+      state->Push((points_[mid] - query).squaredNorm(), mid);
+    }
+    if (diff * diff <= state->MaxSquaredDistance()) {
+      if (diff < 0) {
+        Search(query, mid + 1, end, filter, state);
+      } else {
+        Search(query, begin, mid, filter, state);
+      }
+    }
+  }
+
+  std::vector<Eigen::Vector3d> points_;
+  std::vector<size_t> idxs_;
+  std::vector<int> axes_;
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "colmap/feature/types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "log_exceptions.h"
+
+enum class KeypointSelectionMethod {
+  // Keep all keypoints.
+  NONE,
+  // Adaptive non-maximal suppression: keep the keypoints with the largest
+  // distance to any significantly stronger keypoint. See "Multi-Image
+  // Matching using Multi-Scale Oriented Patches", Brown et al., CVPR 2005.
+  ANMS,
+  // Split the image into a grid of cells and select the strongest keypoint
+  // of each cell in turn, then the second strongest, and so on.
+  GRID,
+};
+
+struct KeypointSelectionOptions {
+  KeypointSelectionMethod method = KeypointSelectionMethod::NONE;
+
+  // Number of keypoints to select.
+  int max_num_features = 2048;
+
+  // A keypoint is only suppressed by keypoints whose strength times the
+  // robustness is larger than its own.
+  double anms_robustness = 0.9;
+
+  // Number of grid cells along the larger image dimension.
+  int grid_num_cells = 16;
+
+  void Check() const {
+    THROW_CHECK_GT(max_num_features, 0);
+    THROW_CHECK_GT(anms_robustness, 0);
+    THROW_CHECK_LE(anms_robustness, 1);
+    THROW_CHECK_GT(grid_num_cells, 0);
+  }
+};
+
+// Uniform grid over the image, whose cells hold indices of keypoints.
+class KeypointGrid {
+ public:
+  KeypointGrid(const int width, const int height, const double cell_size)
+      : cell_size_(cell_size),
+        num_cols_(std::max(1, static_cast<int>(std::ceil(width / cell_size)))),
+        num_rows_(
+            std::max(1, static_cast<int>(std::ceil(height / cell_size)))),
+        cells_(num_cols_ * num_rows_) {}
+
+  int NumCols() const { return num_cols_; }
+  int NumRows() const { return num_rows_; }
+
+  int Col(const float x) const {
+    return std::min(std::max(static_cast<int>(x / cell_size_), 0),
+                    num_cols_ - 1);
+  }
+  int Row(const float y) const {
+    return std::min(std::max(static_cast<int>(y / cell_size_), 0),
+                    num_rows_ - 1);
+  }
+
+  std::vector<size_t>& Cell(const int col, const int row) {
+    return cells_[row * num_cols_ + col];
+  }
+  const std::vector<size_t>& Cell(const int col, const int row) const {
+    return cells_[row * num_cols_ + col];
+  }
+
+  double CellSize() const { return cell_size_; }
+
+ private:
+  const double cell_size_;
+  const int num_cols_;
+  const int num_rows_;
+  std::vector<std::vector<size_t>> cells_;
+};
+
+// Indices of the keypoints sorted by decreasing strength, i.e. scale, as for
+// SiftExtractionOptions.max_num_features, and by index for equal scales.
+inline std::vector<size_t> SortKeypointsByStrength(
+    const colmap::FeatureKeypoints& keypoints,
+    std::vector<float>* strengths) {
+  strengths->resize(keypoints.size());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    (*strengths)[i] = keypoints[i].ComputeScale();
+  }
+  std::vector<size_t> order(keypoints.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(
+      order.begin(), order.end(), [strengths](const size_t i, const size_t j) {
+        return (*strengths)[i] > (*strengths)[j];
+      });
+  return order;
+}
+
+// Suppression radius of each keypoint, i.e. its distance to the nearest
+// keypoint that is stronger by the robustness factor. The stronger keypoints
+// are a prefix of the sorted keypoints, which are inserted into a grid as
+// the strength decreases, so that the nearest one is found by searching
+// rings of cells of increasing size.
+inline std::vector<double> ComputeSuppressionRadii(
+    const colmap::FeatureKeypoints& keypoints,
+    const std::vector<size_t>& order,
+    const std::vector<float>& strengths,
+    const int width,
+    const int height,
+    const double robustness) {
+  const double cell_size =
+      std::max(1.0,
+               std::sqrt(static_cast<double>(width) * height /
+                         std::max<size_t>(1, keypoints.size())));
+  KeypointGrid grid(width, height, cell_size);
+  std::vector<double> radii(keypoints.size(),
+                            std::numeric_limits<double>::infinity());
+  size_t num_inserted = 0;
+  for (const size_t i : order) {
+    while (num_inserted < order.size() &&
+           strengths[order[num_inserted]] * robustness > strengths[i]) {
+      const colmap::FeatureKeypoint& keypoint = keypoints[order[num_inserted]];
+      grid.Cell(grid.Col(keypoint.x), grid.Row(keypoint.y))
+          .push_back(order[num_inserted]);
+      ++num_inserted;
+    }
+    if (num_inserted == 0) {
+      continue;
+    }
+    const int col = grid.Col(keypoints[i].x);
+    const int row = grid.Row(keypoints[i].y);
+    const int max_ring = std::max(grid.NumCols(), grid.NumRows());
+    double min_squared_distance = std::numeric_limits<double>::infinity();
+    for (int ring = 0; ring <= max_ring; ++ring) {
+      // Keypoints in this or further rings are at least this far.
+      const double ring_distance = (ring - 1) * grid.CellSize();
+      if (ring_distance > 0 &&
+          ring_distance * ring_distance >= min_squared_distance) {
+        break;
+      }
+      for (int r = row - ring; r <= row + ring; ++r) {
+        if (r < 0 || r >= grid.NumRows()) {
+          continue;
+        }
+        const bool border_row = r == row - ring || r == row + ring;
+        for (int c = col - ring; c <= col + ring;
+             c += border_row ? 1 : 2 * ring) {
+          if (c < 0 || c >= grid.NumCols()) {
+            continue;
+          }
+          for (const size_t j : grid.Cell(c, r)) {
+            const double dx = keypoints[j].x - keypoints[i].x;
+            const double dy = keypoints[j].y - keypoints[i].y;
+            min_squared_distance =
+                std::min(min_squared_distance, dx * dx + dy * dy);
+          }
+        }
+      }
+    }
+    radii[i] = std::sqrt(min_squared_distance);
+  }
+  return radii;
+}
+
+// Indices of at most options.max_num_features keypoints selected with
+// options.method, or of all keypoints for NONE, sorted by decreasing
+// strength. The image size is used to distribute the keypoints, which may lie
+// outside of it.
+inline std::vector<size_t> SelectKeypoints(
+    const colmap::FeatureKeypoints& keypoints,
+    const int width,
+    const int height,
+    const KeypointSelectionOptions& options) {
+  options.Check();
+  std::vector<float> strengths;
+  const std::vector<size_t> order =
+      SortKeypointsByStrength(keypoints, &strengths);
+  const size_t num_selected =
+      std::min(keypoints.size(), static_cast<size_t>(options.max_num_features));
+  if (options.method == KeypointSelectionMethod::NONE ||
+      num_selected == keypoints.size()) {
+    return order;
+  }
+
+  std::vector<size_t> selected;
+  selected.reserve(num_selected);
+  if (options.method == KeypointSelectionMethod::ANMS) {
+    const std::vector<double> radii = ComputeSuppressionRadii(
+        keypoints, order, strengths, width, height, options.anms_robustness);
+    // Sorting the order, which is by strength, keeps the strongest keypoints
+    // among those with equal radii.
+    selected = order;
+    std::stable_sort(selected.begin(),
+                     selected.end(),
+                     [&radii](const size_t i, const size_t j) {
+                       return radii[i] > radii[j];
+                     });
+    selected.resize(num_selected);
+  } else {
+    KeypointGrid grid(width,
+                      height,
+                      std::max(1.0,
+                               static_cast<double>(std::max(width, height)) /
+                                   options.grid_num_cells));
+    for (const size_t i : order) {
+      grid.Cell(grid.Col(keypoints[i].x), grid.Row(keypoints[i].y))
+          .push_back(i);
+    }
+    // Take the keypoints of rank 0 of all cells, then those of rank 1, etc.
+    for (size_t rank = 0; selected.size() < num_selected; ++rank) {
+      const size_t rank_begin = selected.size();
+      for (int row = 0; row < grid.NumRows(); ++row) {
+        for (int col = 0; col < grid.NumCols(); ++col) {
+          const std::vector<size_t>& cell = grid.Cell(col, row);
+          if (rank < cell.size()) {
+            selected.push_back(cell[rank]);
+          }
+        }
+      }
+      // Keep the strongest keypoints of the last rank.
+      std::sort(selected.begin() + rank_begin,
+                selected.end(),
+                [&strengths](const size_t i, const size_t j) {
+                  return strengths[i] > strengths[j] ||
+                         (strengths[i] == strengths[j] && i < j);
+                });
+      selected.resize(std::min(selected.size(), num_selected));
+    }
+  }
+  std::sort(selected.begin(),
+            selected.end(),
+            [&strengths](const size_t i, const size_t j) {
+              return strengths[i] > strengths[j] ||
+                     (strengths[i] == strengths[j] && i < j);
+            });
+  return selected;
+}
+
+// Keep the selected keypoints and their descriptors.
+inline void SelectKeypoints(const int width,
+                            const int height,
+                            const KeypointSelectionOptions& options,
+                            colmap::FeatureKeypoints* keypoints,
+                            colmap::FeatureDescriptors* descriptors) {
+  THROW_CHECK_EQ(keypoints->size(), descriptors->rows());
+  if (options.method == KeypointSelectionMethod::NONE) {
+    return;
+  }
+  const std::vector<size_t> selected =
+      SelectKeypoints(*keypoints, width, height, options);
+  colmap::FeatureKeypoints selected_keypoints(selected.size());
+  colmap::FeatureDescriptors selected_descriptors(selected.size(),
+                                                  descriptors->cols());
+  for (size_t i = 0; i < selected.size(); ++i) {
+    selected_keypoints[i] = (*keypoints)[selected[i]];
+    selected_descriptors.row(i) = descriptors->row(selected[i]);
+  }
+  *keypoints = std::move(selected_keypoints);
+  *descriptors = std::move(selected_descriptors);
+}
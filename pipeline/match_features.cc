@@ -2,14 +2,22 @@
 
 #include "colmap/controllers/feature_extraction.h"
 #include "colmap/controllers/feature_matching.h"
+#include "colmap/controllers/feature_matching_utils.h"
 #include "colmap/controllers/image_reader.h"
 #include "colmap/controllers/incremental_mapper.h"
 #include "colmap/estimators/two_view_geometry.h"
 #include "colmap/exe/feature.h"
 #include "colmap/exe/sfm.h"
 #include "colmap/feature/sift.h"
+#include "colmap/scene/database.h"
 #include "colmap/util/misc.h"
 
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
 using namespace colmap;
 
 #include <pybind11/iostream.h>
@@ -88,6 +96,61 @@ void verify_matches(const py::object database_path_,
   PyWait(matcher.get());
 }
 
+// Match and verify the given pairs of image ids in blocks, as the image pairs
+// matcher does for the pairs of its match list. Used by the matchers that
+// select the pairs themselves. Must be called without the GIL.
+void MatchImagePairs(
+    const std::string& database_path,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const SiftMatchingOptions& sift_options,
+    const TwoViewGeometryOptions& verification_options,
+    const bool verbose) {
+  Database database(database_path);
+  {
+    std::unordered_set<image_t> image_ids;
+    for (const Image& image : database.ReadAllImages()) {
+      image_ids.insert(image.ImageId());
+    }
+    for (const auto& image_pair : image_pairs) {
+      THROW_CHECK_MSG(image_ids.count(image_pair.first) > 0 &&
+                          image_ids.count(image_pair.second) > 0,
+                      "Image pair with an unknown image id.");
+    }
+  }
+
+  const size_t block_size = ImagePairsMatchingOptions().block_size;
+  FeatureMatcherCache cache(block_size, &database);
+  FeatureMatcherController matcher(
+      sift_options, verification_options, &database, &cache);
+  THROW_CHECK_MSG(matcher.Setup(), "Could not set up the feature matcher.");
+  cache.Setup();
+
+  std::stringstream oss;
+  std::streambuf* oldcout = nullptr;
+  if (!verbose) {
+    oldcout = std::cout.rdbuf(oss.rdbuf());
+  }
+
+  PyInterrupt py_interrupt(2.0);
+  for (size_t begin = 0; begin < image_pairs.size(); begin += block_size) {
+    if (py_interrupt.Raised()) {
+      if (!verbose) {
+        std::cout.rdbuf(oldcout);
+      }
+      throw py::error_already_set();
+    }
+    const size_t end = std::min(begin + block_size, image_pairs.size());
+    const std::vector<std::pair<image_t, image_t>> block_image_pairs(
+        image_pairs.begin() + begin, image_pairs.begin() + end);
+    DatabaseTransaction database_transaction(&database);
+    matcher.Match(block_image_pairs);
+  }
+
+  if (!verbose) {
+    std::cout.rdbuf(oldcout);
+  }
+}
+
 void init_match_features(py::module& m) {
   /* OPTIONS */
   using SMOpts = SiftMatchingOptions;
@@ -0,0 +1,669 @@
+#include "colmap/controllers/feature_matching.h"
+#include "colmap/geometry/gps.h"
+#include "colmap/scene/database.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace colmap;
+
+#include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+#include "helpers.h"
+#include "log_exceptions.h"
+#include "pipeline/hnsw.h"
+#include "pipeline/kd_tree.h"
+#include "pipeline/vocab_tree.cc"
+#include "utils.h"
+
+typedef std::vector<std::pair<image_t, image_t>> ImagePairs;
+
+py::array_t<image_t> ImagePairsToArray(const ImagePairs& image_pairs) {
+  py::array_t<image_t> array(std::vector<size_t>{image_pairs.size(), 2});
+  auto array_ = array.mutable_unchecked<2>();
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    array_(i, 0) = image_pairs[i].first;
+    array_(i, 1) = image_pairs[i].second;
+  }
+  return array;
+}
+
+ImagePairs ImagePairsFromArray(const py::array_t<image_t>& array) {
+  THROW_CHECK_EQ(array.ndim(), 2);
+  THROW_CHECK_EQ(array.shape(1), 2);
+  auto array_ = array.unchecked<2>();
+  ImagePairs image_pairs(array.shape(0));
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    image_pairs[i] = std::make_pair(array_(i, 0), array_(i, 1));
+  }
+  return image_pairs;
+}
+
+std::vector<image_t> ReadImageIds(const Database& database) {
+  std::vector<image_t> image_ids;
+  for (const Image& image : database.ReadAllImages()) {
+    image_ids.push_back(image.ImageId());
+  }
+  std::sort(image_ids.begin(), image_ids.end());
+  return image_ids;
+}
+
+// All pairs of images, in the order of the exhaustive matcher.
+ImagePairs GenerateExhaustivePairs(const std::string& database_path) {
+  const std::vector<image_t> image_ids = ReadImageIds(Database(database_path));
+  ImagePairs image_pairs;
+  if (image_ids.size() > 1) {
+    image_pairs.reserve(image_ids.size() * (image_ids.size() - 1) / 2);
+  }
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    for (size_t j = i + 1; j < image_ids.size(); ++j) {
+      image_pairs.emplace_back(image_ids[i], image_ids[j]);
+    }
+  }
+  return image_pairs;
+}
+
+// Same selection of image pairs as the sequential matcher: the images are
+// ordered by name and each image is paired with its successors and, with loop
+// detection, every loop_detection_period images with the most similar images
+// retrieved from the index.
+ImagePairs GenerateSequentialPairs(const std::string& database_path,
+                                   const SequentialMatchingOptions& options,
+                                   const int num_threads,
+                                   VisualIndex* index) {
+  THROW_CHECK(options.Check());
+  const Database database(database_path);
+  std::vector<Image> images = database.ReadAllImages();
+  std::sort(images.begin(),
+            images.end(),
+            [](const Image& image1, const Image& image2) {
+              return image1.Name() < image2.Name();
+            });
+
+  std::set<std::pair<image_t, image_t>> image_pairs;
+  const auto add_pair = [&image_pairs](const image_t image_id1,
+                                       const image_t image_id2) {
+    image_pairs.emplace(std::min(image_id1, image_id2),
+                        std::max(image_id1, image_id2));
+  };
+  for (size_t i = 0; i < images.size(); ++i) {
+    for (size_t j = i + 1; j < std::min(i + options.overlap + 1, images.size());
+         ++j) {
+      add_pair(images[i].ImageId(), images[j].ImageId());
+    }
+    if (options.quadratic_overlap) {
+      for (int k = 0; k < options.overlap; ++k) {
+        const size_t j = i + (static_cast<size_t>(1) << k);
+        if (j >= images.size()) {
+          break;
+        }
+        add_pair(images[i].ImageId(), images[j].ImageId());
+      }
+    }
+  }
+
+  if (options.loop_detection) {
+    std::unique_ptr<VisualIndex> owned_index;
+    if (index == nullptr) {
+      owned_index.reset(new VisualIndex(options.vocab_tree_path));
+      index = owned_index.get();
+    }
+    index->AddDatabase(database_path,
+                       options.loop_detection_max_num_features,
+                       /*num_neighbors=*/1,
+                       options.loop_detection_num_checks,
+                       num_threads);
+    std::vector<image_t> query_image_ids;
+    for (size_t i = 0; i < images.size(); ++i) {
+      if (i % options.loop_detection_period == 0) {
+        query_image_ids.push_back(images[i].ImageId());
+      }
+    }
+    VisualIndexType::QueryOptions query_options;
+    query_options.max_num_images = options.loop_detection_num_images;
+    query_options.num_neighbors = options.loop_detection_num_nearest_neighbors;
+    query_options.num_checks = options.loop_detection_num_checks;
+    query_options.num_images_after_verification =
+        options.loop_detection_num_images_after_verification;
+    RetrieveImagePairs(database,
+                       query_image_ids,
+                       query_options,
+                       options.loop_detection_max_num_features,
+                       num_threads,
+                       index,
+                       &image_pairs);
+  }
+  return {image_pairs.begin(), image_pairs.end()};
+}
+
+// Pairs of each image with the images of its nearest location priors, at
+// most options.max_num_neighbors within options.max_distance, found with a
+// kd-tree queried in parallel. The count of neighbors includes the image
+// itself, as in the spatial matcher. With timestamps, only images at least
+// min_time_gap and, if max_time_diff > 0, at most max_time_diff apart in time
+// are paired.
+ImagePairs SpatialPairsFromPriors(const std::vector<image_t>& image_ids,
+                                  std::vector<Eigen::Vector3d> locations,
+                                  const SpatialMatchingOptions& options,
+                                  const std::vector<double>& timestamps,
+                                  const double max_time_diff,
+                                  const double min_time_gap,
+                                  const int num_threads) {
+  THROW_CHECK(options.Check());
+  THROW_CHECK_EQ(image_ids.size(), locations.size());
+  THROW_CHECK(timestamps.empty() || timestamps.size() == locations.size());
+  THROW_CHECK_GE(min_time_gap, 0);
+  // As in the spatial matcher, ignore_z zeroes the altitude of GPS priors
+  // before their conversion to ECEF coordinates, not the ECEF Z coordinate.
+  if (options.ignore_z) {
+    for (Eigen::Vector3d& location : locations) {
+      location.z() = 0;
+    }
+  }
+  if (options.is_gps) {
+    locations = GPSTransform(GPSTransform::WGS84).EllToXYZ(locations);
+  }
+
+  const KdTree3d tree(locations);
+  const size_t num_neighbors =
+      std::min(static_cast<size_t>(options.max_num_neighbors),
+               locations.size());
+  std::vector<ImagePairs> chunk_image_pairs(
+      NumParallelChunks(locations.size(), num_threads));
+  ParallelFor(
+      locations.size(),
+      num_threads,
+      [&](size_t chunk_idx, size_t begin, size_t end) {
+        std::vector<std::pair<double, size_t>> neighbors;
+        for (size_t i = begin; i < end; ++i) {
+          const auto filter = [&](const size_t j) {
+            if (timestamps.empty() || j == i) {
+              return true;
+            }
+            const double time_diff = std::abs(timestamps[i] - timestamps[j]);
+            return time_diff >= min_time_gap &&
+                   (max_time_diff <= 0 || time_diff <= max_time_diff);
+          };
+          tree.Search(locations[i],
+                      num_neighbors,
+                      options.max_distance,
+                      filter,
+                      &neighbors);
+          for (const auto& neighbor : neighbors) {
+            if (neighbor.second != i) {
+              const image_t image_id = image_ids[neighbor.second];
+              chunk_image_pairs[chunk_idx].emplace_back(
+                  std::min(image_ids[i], image_id),
+                  std::max(image_ids[i], image_id));
+            }
+          }
+        }
+      });
+  std::set<std::pair<image_t, image_t>> image_pairs;
+  for (const ImagePairs& pairs : chunk_image_pairs) {
+    image_pairs.insert(pairs.begin(), pairs.end());
+  }
+  return {image_pairs.begin(), image_pairs.end()};
+}
+
+// Same selection of image pairs as the spatial matcher, from the location
+// priors of the database. Images without a location prior, i.e. with zero
+// coordinates, are ignored.
+ImagePairs GenerateSpatialPairs(const std::string& database_path,
+                                const SpatialMatchingOptions& options,
+                                const int num_threads) {
+  std::vector<image_t> image_ids;
+  std::vector<Eigen::Vector3d> locations;
+  for (const Image& image : Database(database_path).ReadAllImages()) {
+    const Eigen::Vector3d& location = image.CamFromWorldPrior().translation;
+    if (!location.allFinite() ||
+        (location.x() == 0 && location.y() == 0 &&
+         (options.ignore_z || location.z() == 0))) {
+      continue;
+    }
+    image_ids.push_back(image.ImageId());
+    locations.push_back(location);
+  }
+  return SpatialPairsFromPriors(image_ids,
+                                std::move(locations),
+                                options,
+                                /*timestamps=*/{},
+                                /*max_time_diff=*/0,
+                                /*min_time_gap=*/0,
+                                num_threads);
+}
+
+enum class DescriptorMetric { COSINE, INNER_PRODUCT, L2 };
+
+struct HnswOptions {
+  // Maximum number of links per node in the upper layers of the graph, twice
+  // as many in the bottom layer.
+  int max_num_links = 16;
+
+  // Size of the beam when inserting nodes into the graph.
+  int ef_construction = 200;
+
+  // Size of the beam when searching, at least the number of neighbors.
+  int ef_search = 64;
+
+  void Check() const {
+    THROW_CHECK_GT(max_num_links, 1);
+    THROW_CHECK_GT(ef_construction, 0);
+    THROW_CHECK_GT(ef_search, 0);
+  }
+};
+
+// The k nearest neighbors of each row among the other rows, sorted by
+// increasing distance, by brute force. The distances are computed as matrix
+// products of blocks of rows, with a heap of the nearest neighbors per row.
+std::vector<std::vector<HnswIndex::Neighbor>> ExactNearestNeighbors(
+    const HnswIndex::Matrix& data,
+    const HnswIndex::Metric metric,
+    const size_t k,
+    const int num_threads) {
+  const Eigen::Index kBlockSize = 1024;
+  const Eigen::Index num_rows = data.rows();
+  const Eigen::VectorXf squared_norms = data.rowwise().squaredNorm();
+  std::vector<std::vector<HnswIndex::Neighbor>> neighbors(num_rows);
+  ParallelFor(num_rows, num_threads, [&](size_t, size_t begin, size_t end) {
+    const Eigen::Index queries_end = end;
+    Eigen::MatrixXf distances;
+    for (Eigen::Index query_begin = begin; query_begin < queries_end;
+         query_begin += kBlockSize) {
+      const Eigen::Index num_queries =
+          std::min(kBlockSize, queries_end - query_begin);
+      for (Eigen::Index begin2 = 0; begin2 < num_rows; begin2 += kBlockSize) {
+        const Eigen::Index num_rows2 = std::min(kBlockSize, num_rows - begin2);
+        // Column-major, so that the distances of a query are contiguous.
+        distances.noalias() = data.middleRows(begin2, num_rows2) *
+                              data.middleRows(query_begin, num_queries)
+                                  .transpose();
+        if (metric == HnswIndex::Metric::INNER_PRODUCT) {
+          distances = 1 - distances.array();
+        } else {
+          distances = ((-2 * distances).colwise() +
+                       squared_norms.segment(begin2, num_rows2))
+                          .rowwise() +
+                      squared_norms.segment(query_begin, num_queries)
+                          .transpose();
+        }
+        for (Eigen::Index i = 0; i < num_queries; ++i) {
+          // Max-heap of the current nearest neighbors.
+          std::vector<HnswIndex::Neighbor>& heap = neighbors[query_begin + i];
+          for (Eigen::Index j = 0; j < num_rows2; ++j) {
+            if (begin2 + j == query_begin + i) {
+              continue;
+            }
+            const float distance = distances(j, i);
+            if (heap.size() < k) {
+              heap.emplace_back(distance, begin2 + j);
+              std::push_heap(heap.begin(), heap.end());
+            } else if (distance < heap.front().first) {
+              std::pop_heap(heap.begin(), heap.end());
+              heap.back() = HnswIndex::Neighbor(distance, begin2 + j);
+              std::push_heap(heap.begin(), heap.end());
+            }
+          }
+        }
+      }
+      for (Eigen::Index i = 0; i < num_queries; ++i) {
+        std::sort_heap(neighbors[query_begin + i].begin(),
+                       neighbors[query_begin + i].end());
+      }
+    }
+  });
+  return neighbors;
+}
+
+// The approximate k nearest neighbors of each row among the other rows,
+// sorted by increasing distance, from an HNSW graph built in parallel.
+std::vector<std::vector<HnswIndex::Neighbor>> ApproximateNearestNeighbors(
+    const HnswIndex::Matrix& data,
+    const HnswIndex::Metric metric,
+    const size_t k,
+    const HnswOptions& options,
+    const int num_threads) {
+  HnswIndex index(data, metric, options.max_num_links, options.ef_construction);
+  if (data.rows() > 0) {
+    // The first node is the entry point of the concurrent insertions.
+    index.Insert(0);
+  }
+  ParallelFor(data.rows() - std::min<Eigen::Index>(data.rows(), 1),
+              num_threads,
+              [&](size_t, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                  index.Insert(i + 1);
+                }
+              });
+  std::vector<std::vector<HnswIndex::Neighbor>> neighbors(data.rows());
+  ParallelFor(data.rows(), num_threads, [&](size_t, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      // The row itself is usually its nearest neighbor.
+      index.Search(
+          data.row(i).data(), k + 1, options.ef_search, &neighbors[i]);
+      const auto it = std::find_if(
+          neighbors[i].begin(),
+          neighbors[i].end(),
+          [i](const HnswIndex::Neighbor& neighbor) {
+            return neighbor.second == i;
+          });
+      if (it != neighbors[i].end()) {
+        neighbors[i].erase(it);
+      }
+      if (neighbors[i].size() > k) {
+        neighbors[i].resize(k);
+      }
+    }
+  });
+  return neighbors;
+}
+
+// Pairs of each image with the images of its k nearest global descriptors,
+// deduplicated and ordered by image id.
+ImagePairs PairsFromGlobalDescriptors(HnswIndex::Matrix descriptors,
+                                      const std::vector<image_t>& image_ids,
+                                      const int k,
+                                      const DescriptorMetric metric,
+                                      const bool approx,
+                                      const HnswOptions& options,
+                                      const int num_threads) {
+  THROW_CHECK_GT(k, 0);
+  THROW_CHECK_EQ(image_ids.size(), descriptors.rows());
+  options.Check();
+  if (metric == DescriptorMetric::COSINE) {
+    descriptors.rowwise().normalize();
+  }
+  const HnswIndex::Metric index_metric = metric == DescriptorMetric::L2
+                                             ? HnswIndex::Metric::L2
+                                             : HnswIndex::Metric::INNER_PRODUCT;
+  const std::vector<std::vector<HnswIndex::Neighbor>> neighbors =
+      approx ? ApproximateNearestNeighbors(
+                   descriptors, index_metric, k, options, num_threads)
+             : ExactNearestNeighbors(descriptors, index_metric, k, num_threads);
+  ImagePairs image_pairs;
+  image_pairs.reserve(neighbors.size() * k);
+  for (size_t i = 0; i < neighbors.size(); ++i) {
+    for (const HnswIndex::Neighbor& neighbor : neighbors[i]) {
+      const image_t image_id = image_ids[neighbor.second];
+      image_pairs.emplace_back(std::min(image_ids[i], image_id),
+                               std::max(image_ids[i], image_id));
+    }
+  }
+  std::sort(image_pairs.begin(), image_pairs.end());
+  image_pairs.erase(std::unique(image_pairs.begin(), image_pairs.end()),
+                    image_pairs.end());
+  return image_pairs;
+}
+
+void match_pairs_from_array(py::object database_path_,
+                            const py::array_t<image_t>& pairs,
+                            SiftMatchingOptions sift_options,
+                            const TwoViewGeometryOptions& verification_options,
+                            const Device device,
+                            bool verbose) {
+  const std::string database_path = py::str(database_path_).cast<std::string>();
+  THROW_CHECK_FILE_EXISTS(database_path);
+  const ImagePairs image_pairs = ImagePairsFromArray(pairs);
+  sift_options.use_gpu = IsGPU(device);
+  VerifyGPUParams(sift_options.use_gpu);
+  py::gil_scoped_release release;
+  MatchImagePairs(database_path,
+                  image_pairs,
+                  sift_options,
+                  verification_options,
+                  verbose);
+}
+
+void init_pairs(py::module& m) {
+  auto sift_matching_options =
+      m.attr("SiftMatchingOptions")().cast<SiftMatchingOptions>();
+  auto exhaustive_options =
+      m.attr("ExhaustiveMatchingOptions")().cast<ExhaustiveMatchingOptions>();
+  auto sequential_options =
+      m.attr("SequentialMatchingOptions")().cast<SequentialMatchingOptions>();
+  auto spatial_options =
+      m.attr("SpatialMatchingOptions")().cast<SpatialMatchingOptions>();
+  auto vocabtree_options =
+      m.attr("VocabTreeMatchingOptions")().cast<VocabTreeMatchingOptions>();
+  auto verification_options =
+      m.attr("TwoViewGeometryOptions")().cast<TwoViewGeometryOptions>();
+
+  m.def(
+      "generate_pairs_exhaustive",
+      [](py::object database_path_, const ExhaustiveMatchingOptions&) {
+        const std::string database_path =
+            py::str(database_path_).cast<std::string>();
+        THROW_CHECK_FILE_EXISTS(database_path);
+        ImagePairs image_pairs;
+        {
+          py::gil_scoped_release release;
+          image_pairs = GenerateExhaustivePairs(database_path);
+        }
+        return ImagePairsToArray(image_pairs);
+      },
+      "database_path"_a,
+      "matching_options"_a = exhaustive_options,
+      "Mx2 array of the image ids of all pairs of images in the database.");
+
+  m.def(
+      "generate_pairs_sequential",
+      [](py::object database_path_,
+         const SequentialMatchingOptions& options,
+         VisualIndex* index,
+         const int num_threads) {
+        const std::string database_path =
+            py::str(database_path_).cast<std::string>();
+        THROW_CHECK_FILE_EXISTS(database_path);
+        ImagePairs image_pairs;
+        {
+          py::gil_scoped_release release;
+          image_pairs = GenerateSequentialPairs(
+              database_path, options, num_threads, index);
+        }
+        return ImagePairsToArray(image_pairs);
+      },
+      "database_path"_a,
+      "matching_options"_a = sequential_options,
+      "index"_a = py::none(),
+      "num_threads"_a = -1,
+      "Mx2 array of the image ids of the pairs selected by the sequential\n"
+      "matcher. The loop detection uses the given VisualIndex, if any,\n"
+      "instead of matching_options.vocab_tree_path.");
+
+  m.def(
+      "generate_pairs_spatial",
+      [](py::object database_path_,
+         const SpatialMatchingOptions& options,
+         const int num_threads) {
+        const std::string database_path =
+            py::str(database_path_).cast<std::string>();
+        THROW_CHECK_FILE_EXISTS(database_path);
+        ImagePairs image_pairs;
+        {
+          py::gil_scoped_release release;
+          image_pairs =
+              GenerateSpatialPairs(database_path, options, num_threads);
+        }
+        return ImagePairsToArray(image_pairs);
+      },
+      "database_path"_a,
+      "matching_options"_a = spatial_options,
+      "num_threads"_a = -1,
+      "Mx2 array of the image ids of the pairs selected by the spatial\n"
+      "matcher, i.e. the nearest neighbors of the location priors.");
+
+  m.def(
+      "pairs_from_spatial_priors",
+      [](const Eigen::MatrixX3d& priors,
+         const SpatialMatchingOptions& options,
+         const py::object& timestamps_,
+         const double max_time_diff,
+         const double min_time_gap,
+         const py::object& image_ids_,
+         const int num_threads) {
+        std::vector<Eigen::Vector3d> locations(priors.rows());
+        for (Eigen::Index i = 0; i < priors.rows(); ++i) {
+          locations[i] = priors.row(i).transpose();
+        }
+        std::vector<image_t> image_ids(priors.rows());
+        if (image_ids_.is_none()) {
+          // Image ids of the database start at 1.
+          std::iota(image_ids.begin(), image_ids.end(), 1);
+        } else {
+          image_ids = image_ids_.cast<std::vector<image_t>>();
+        }
+        std::vector<double> timestamps;
+        if (!timestamps_.is_none()) {
+          timestamps = timestamps_.cast<std::vector<double>>();
+        }
+        ImagePairs image_pairs;
+        {
+          py::gil_scoped_release release;
+          image_pairs = SpatialPairsFromPriors(image_ids,
+                                               std::move(locations),
+                                               options,
+                                               timestamps,
+                                               max_time_diff,
+                                               min_time_gap,
+                                               num_threads);
+        }
+        return ImagePairsToArray(image_pairs);
+      },
+      "priors"_a,
+      "matching_options"_a = spatial_options,
+      "timestamps"_a = py::none(),
+      "max_time_diff"_a = -1.0,
+      "min_time_gap"_a = 0.0,
+      "image_ids"_a = py::none(),
+      "num_threads"_a = -1,
+      "Mx2 array of the pairs selected by the spatial matcher from Nx3\n"
+      "location priors, XYZ or, if matching_options.is_gps, latitude,\n"
+      "longitude and altitude. With N timestamps, only images at least\n"
+      "min_time_gap and, if max_time_diff > 0, at most max_time_diff apart\n"
+      "are paired. The pairs are of the given image ids of the priors or,\n"
+      "by default, of their row indices plus one, i.e. the ids of a\n"
+      "database whose images are in the order of the rows.");
+
+  m.def(
+      "generate_pairs_vocabtree",
+      [](py::object database_path_,
+         const VocabTreeMatchingOptions& options,
+         VisualIndex* index,
+         const int num_threads) {
+        const std::string database_path =
+            py::str(database_path_).cast<std::string>();
+        THROW_CHECK_FILE_EXISTS(database_path);
+        ImagePairs image_pairs;
+        {
+          py::gil_scoped_release release;
+          std::unique_ptr<VisualIndex> owned_index;
+          if (index == nullptr) {
+            THROW_CHECK_FILE_EXISTS(options.vocab_tree_path);
+            owned_index.reset(new VisualIndex(options.vocab_tree_path));
+            index = owned_index.get();
+          }
+          image_pairs = RetrieveVocabTreeImagePairs(
+              database_path, options, num_threads, index);
+        }
+        return ImagePairsToArray(image_pairs);
+      },
+      "database_path"_a,
+      "matching_options"_a = vocabtree_options,
+      "index"_a = py::none(),
+      "num_threads"_a = -1,
+      "Mx2 array of the image ids of the pairs selected by the vocab tree\n"
+      "matcher. Uses the given VisualIndex, if any, instead of\n"
+      "matching_options.vocab_tree_path.");
+
+  auto PyDescriptorMetric =
+      py::enum_<DescriptorMetric>(m, "DescriptorMetric")
+          .value("COSINE", DescriptorMetric::COSINE)
+          .value("INNER_PRODUCT", DescriptorMetric::INNER_PRODUCT)
+          .value("L2", DescriptorMetric::L2);
+  AddStringToEnumConstructor(PyDescriptorMetric);
+
+  auto PyHnswOptions =
+      py::class_<HnswOptions>(m, "HnswOptions")
+          .def(py::init<>())
+          .def_readwrite("max_num_links",
+                         &HnswOptions::max_num_links,
+                         "Maximum number of links per node in the upper "
+                         "layers of the graph, twice as many in the bottom "
+                         "layer.")
+          .def_readwrite("ef_construction",
+                         &HnswOptions::ef_construction,
+                         "Size of the beam when inserting nodes.")
+          .def_readwrite("ef_search",
+                         &HnswOptions::ef_search,
+                         "Size of the beam when searching, at least the "
+                         "number of neighbors.");
+  make_dataclass(PyHnswOptions);
+  auto hnsw_options = PyHnswOptions().cast<HnswOptions>();
+
+  m.def(
+      "pairs_from_global_descriptors",
+      [](const HnswIndex::Matrix& descriptors,
+         const int k,
+         const DescriptorMetric metric,
+         const bool approx,
+         const py::object& image_ids_,
+         const HnswOptions& options,
+         const int num_threads) {
+        std::vector<image_t> image_ids(descriptors.rows());
+        if (image_ids_.is_none()) {
+          // Image ids of the database start at 1.
+          std::iota(image_ids.begin(), image_ids.end(), 1);
+        } else {
+          image_ids = image_ids_.cast<std::vector<image_t>>();
+        }
+        ImagePairs image_pairs;
+        {
+          py::gil_scoped_release release;
+          image_pairs = PairsFromGlobalDescriptors(descriptors,
+                                                   image_ids,
+                                                   k,
+                                                   metric,
+                                                   approx,
+                                                   options,
+                                                   num_threads);
+        }
+        return ImagePairsToArray(image_pairs);
+      },
+      "descriptors"_a,
+      "k"_a,
+      "metric"_a = DescriptorMetric::COSINE,
+      "approx"_a = true,
+      "image_ids"_a = py::none(),
+      "hnsw_options"_a = hnsw_options,
+      "num_threads"_a = -1,
+      "Mx2 array of the pairs of each image with the images of its k\n"
+      "nearest NxD global descriptors, by exhaustive blocked matrix\n"
+      "products or approximately with an HNSW graph. The pairs are of the\n"
+      "given image ids of the descriptors or, by default, of their row\n"
+      "indices plus one, i.e. the ids of a database whose images are in the\n"
+      "order of the rows.");
+
+  m.def("match_pairs_from_array",
+        &match_pairs_from_array,
+        "database_path"_a,
+        "pairs"_a,
+        "sift_options"_a = sift_matching_options,
+        "verification_options"_a = verification_options,
+        "device"_a = Device::AUTO,
+        "verbose"_a = true,
+        "Match and verify the Mx2 array of image ids of pairs, e.g. from\n"
+        "the generate_pairs_* functions.");
+}
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+
+#include "log_exceptions.h"
+#include "utils.h"
+
+struct ProductQuantizerOptions {
+  // Number of subspaces, i.e. bytes per code.
+  int num_subspaces = 16;
+
+  // Dimension of the PCA projection of the descriptors before quantization,
+  // or -1 to keep all dimensions. The projection also decorrelates the
+  // dimensions across subspaces.
+  int pca_dim = -1;
+
+  // Number of k-means iterations per subspace.
+  int num_iterations = 20;
+
+  // Maximum number of randomly selected training descriptors.
+  int max_num_training = 65536;
+
+  int seed = 0;
+
+  int num_threads = -1;
+
+  void Check() const {
+    THROW_CHECK_GT(num_subspaces, 0);
+    THROW_CHECK(pca_dim == -1 || pca_dim >= num_subspaces);
+    THROW_CHECK_GT(num_iterations, 0);
+    THROW_CHECK_GT(max_num_training, 0);
+  }
+};
+
+// Product quantizer (Jegou et al., PAMI 2011) with an optional PCA
+// projection. The projected descriptors are split into subspaces, each
+// quantized to one of 256 centroids, so that a descriptor is encoded in one
+// byte per subspace. Distances between a descriptor and codes are computed
+// asymmetrically, i.e. without quantizing the descriptor, from a table of its
+// distances to all centroids.
+class ProductQuantizer {
+ public:
+  typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      Matrix;
+  typedef Eigen::
+      Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+          Codes;
+  static constexpr int kNumCentroids = 256;
+
+  ProductQuantizer() = default;
+
+  explicit ProductQuantizer(const std::string& path) { Read(path); }
+
+  bool IsTrained() const { return !centroids_.empty(); }
+  int Dim() const { return static_cast<int>(mean_.size()); }
+  int ProjectedDim() const { return static_cast<int>(rotation_.cols()); }
+  int NumSubspaces() const { return static_cast<int>(centroids_.size()); }
+
+  void Fit(const Matrix& data, const ProductQuantizerOptions& options) {
+    options.Check();
+    THROW_CHECK_GT(data.rows(), 0);
+    const int pca_dim = options.pca_dim > 0 ? options.pca_dim
+                                            : static_cast<int>(data.cols());
+    THROW_CHECK_LE(pca_dim, data.cols());
+    THROW_CHECK_LE(options.num_subspaces, pca_dim);
+
+    std::mt19937 prng(options.seed);
+    std::vector<Eigen::Index> sample(data.rows());
+    std::iota(sample.begin(), sample.end(), 0);
+    if (sample.size() > static_cast<size_t>(options.max_num_training)) {
+      std::shuffle(sample.begin(), sample.end(), prng);
+      sample.resize(options.max_num_training);
+    }
+    Matrix training(sample.size(), data.cols());
+    for (size_t i = 0; i < sample.size(); ++i) {
+      training.row(i) = data.row(sample[i]);
+    }
+
+    // The principal components by decreasing variance.
+    mean_ = training.colwise().mean();
+    training.rowwise() -= mean_;
+    const Eigen::MatrixXf covariance =
+        training.transpose() * training / training.rows();
+    const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> solver(covariance);
+    rotation_ = solver.eigenvectors().rowwise().reverse().leftCols(pca_dim);
+    const Matrix projected = training * rotation_;
+
+    subspace_offsets_.resize(options.num_subspaces + 1);
+    for (int s = 0; s <= options.num_subspaces; ++s) {
+      subspace_offsets_[s] = s * pca_dim / options.num_subspaces;
+    }
+    centroids_.resize(options.num_subspaces);
+    std::vector<uint32_t> seeds(options.num_subspaces);
+    for (uint32_t& seed : seeds) {
+      seed = prng();
+    }
+    ParallelFor(options.num_subspaces,
+                options.num_threads,
+                [&](size_t, size_t begin, size_t end) {
+                  for (size_t s = begin; s < end; ++s) {
+                    centroids_[s] = KMeans(
+                        projected.middleCols(subspace_offsets_[s],
+                                             SubspaceDim(s)),
+                        options.num_iterations,
+                        seeds[s]);
+                  }
+                });
+  }
+
+  // Descriptors projected by the PCA, as used for the distance tables.
+  Matrix Project(const Matrix& data) const {
+    THROW_CHECK(IsTrained());
+    THROW_CHECK_EQ(data.cols(), Dim());
+    return (data.rowwise() - mean_) * rotation_;
+  }
+
+  Codes Encode(const Matrix& data, const int num_threads) const {
+    const Matrix projected = Project(data);
+    Codes codes(data.rows(), NumSubspaces());
+    ParallelFor(
+        data.rows(), num_threads, [&](size_t, size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            for (int s = 0; s < NumSubspaces(); ++s) {
+              Eigen::Index centroid_idx;
+              (centroids_[s].rowwise() -
+               projected.row(i).segment(subspace_offsets_[s], SubspaceDim(s)))
+                  .rowwise()
+                  .squaredNorm()
+                  .minCoeff(&centroid_idx);
+              codes(i, s) = static_cast<uint8_t>(centroid_idx);
+            }
+          }
+        });
+    return codes;
+  }
+
+  // The projected descriptors reconstructed from their codes.
+  Matrix Reconstruct(const Codes& codes) const {
+    THROW_CHECK(IsTrained());
+    THROW_CHECK_EQ(codes.cols(), NumSubspaces());
+    Matrix projected(codes.rows(), ProjectedDim());
+    for (Eigen::Index i = 0; i < codes.rows(); ++i) {
+      for (int s = 0; s < NumSubspaces(); ++s) {
+        projected.block(i, subspace_offsets_[s], 1, SubspaceDim(s)) =
+            centroids_[s].row(codes(i, s));
+      }
+    }
+    return projected;
+  }
+
+  // The descriptors reconstructed from their codes, in the original space.
+  Matrix Decode(const Codes& codes) const {
+    Matrix decoded = Reconstruct(codes) * rotation_.transpose();
+    decoded.rowwise() += mean_;
+    return decoded;
+  }
+
+  // Squared distances of a projected descriptor to the centroids of each
+  // subspace, as a NumSubspaces() x kNumCentroids table.
+  void ComputeDistanceTable(const float* projected, Matrix* table) const {
+    table->resize(NumSubspaces(), kNumCentroids);
+    for (int s = 0; s < NumSubspaces(); ++s) {
+      const Eigen::Map<const Eigen::RowVectorXf> sub_projected(
+          projected + subspace_offsets_[s], SubspaceDim(s));
+      table->row(s) =
+          (centroids_[s].rowwise() - sub_projected).rowwise().squaredNorm();
+    }
+  }
+
+  // Approximate squared distance of a code to the projected descriptor of a
+  // distance table.
+  float AsymmetricDistance(const Matrix& table, const uint8_t* code) const {
+    float distance = 0;
+    for (int s = 0; s < NumSubspaces(); ++s) {
+      distance += table(s, code[s]);
+    }
+    return distance;
+  }
+
+  void Write(const std::string& path) const {
+    THROW_CHECK(IsTrained());
+    std::ofstream file(path, std::ios::binary);
+    THROW_CHECK_MSG(file.is_open(), "Could not open " + path);
+    const int32_t header[3] = {Dim(), ProjectedDim(), NumSubspaces()};
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(subspace_offsets_.data()),
+               subspace_offsets_.size() * sizeof(int32_t));
+    file.write(reinterpret_cast<const char*>(mean_.data()),
+               mean_.size() * sizeof(float));
+    file.write(reinterpret_cast<const char*>(rotation_.data()),
+               rotation_.size() * sizeof(float));
+    for (const Matrix& centroids : centroids_) {
+      file.write(reinterpret_cast<const char*>(centroids.data()),
+                 centroids.size() * sizeof(float));
+    }
+  }
+
+  void Read(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    THROW_CHECK_MSG(file.is_open(), "Could not open " + path);
+    int32_t header[3];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    THROW_CHECK_MSG(file.good() && header[0] > 0 && header[1] > 0 &&
+                        header[2] > 0 && header[1] <= header[0] &&
+                        header[2] <= header[1],
+                    "Invalid product quantizer file " + path);
+    subspace_offsets_.resize(header[2] + 1);
+    file.read(reinterpret_cast<char*>(subspace_offsets_.data()),
+              subspace_offsets_.size() * sizeof(int32_t));
+    // The subspaces must be non-empty and partition the projected dimension.
+    bool valid_offsets = file.good() && subspace_offsets_.front() == 0 &&
+                         subspace_offsets_.back() == header[1];
+    for (int s = 0; valid_offsets && s < header[2]; ++s) {
+      valid_offsets = subspace_offsets_[s] < subspace_offsets_[s + 1];
+    }
+    THROW_CHECK_MSG(valid_offsets, "Invalid product quantizer file " + path);
+    mean_.resize(header[0]);
+    file.read(reinterpret_cast<char*>(mean_.data()),
+              mean_.size() * sizeof(float));
+    rotation_.resize(header[0], header[1]);
+    file.read(reinterpret_cast<char*>(rotation_.data()),
+              rotation_.size() * sizeof(float));
+    centroids_.resize(header[2]);
+    for (int s = 0; s < header[2]; ++s) {
+      centroids_[s].resize(kNumCentroids, SubspaceDim(s));
+      file.read(reinterpret_cast<char*>(centroids_[s].data()),
+                centroids_[s].size() * sizeof(float));
+    }
+    THROW_CHECK_MSG(file.good(), "Invalid product quantizer file " + path);
+  }
+
+ private:
+  int SubspaceDim(const int s) const {
+    return subspace_offsets_[s + 1] - subspace_offsets_[s];
+  }
+
+  // Lloyd's algorithm initialized with random samples. Empty clusters are
+  // reinitialized with random samples.
+  static Matrix KMeans(const Matrix& data,
+                       const int num_iterations,
+                       const uint32_t seed) {
+    std::mt19937 prng(seed);
+    std::uniform_int_distribution<Eigen::Index> random_row(0, data.rows() - 1);
+    Matrix centroids(kNumCentroids, data.cols());
+    for (int k = 0; k < kNumCentroids; ++k) {
+      centroids.row(k) = data.row(random_row(prng));
+    }
+    std::vector<int> assignments(data.rows());
+    Matrix sums(kNumCentroids, data.cols());
+    std::vector<int> counts(kNumCentroids);
+    for (int iter = 0; iter < num_iterations; ++iter) {
+      for (Eigen::Index i = 0; i < data.rows(); ++i) {
+        Eigen::Index centroid_idx;
+        (centroids.rowwise() - data.row(i))
+            .rowwise()
+            .squaredNorm()
+            .minCoeff(&centroid_idx);
+        assignments[i] = static_cast<int>(centroid_idx);
+      }
+      sums.setZero();
+      std::fill(counts.begin(), counts.end(), 0);
+      for (Eigen::Index i = 0; i < data.rows(); ++i) {
+        sums.row(assignments[i]) += data.row(i);
+        counts[assignments[i]] += 1;
+      }
+      for (int k = 0; k < kNumCentroids; ++k) {
+        if (counts[k] > 0) {
+          centroids.row(k) = sums.row(k) / counts[k];
+        } else {
+          centroids.row(k) = data.row(random_row(prng));
+        }
+      }
+    }
+    return centroids;
+  }
+
+  Eigen::RowVectorXf mean_;
+  // The principal components as columns.
+  Eigen::MatrixXf rotation_;
+  // The first dimension of each subspace and the projected dimension.
+  std::vector<int32_t> subspace_offsets_;
+  // The kNumCentroids x subspace dimension centroids of each subspace.
+  std::vector<Matrix> centroids_;
+};
+
+// Definition for ODR-uses, e.g. by std::min, which bind it by reference.
+constexpr int ProductQuantizer::kNumCentroids;
+
+// Angle between two SIFT descriptors of the given squared Euclidean distance.
+// The uint8 descriptors of COLMAP are normalized to a length of 512, and its
+// matching options are defined on these angles.
+inline float DescriptorAngle(const float squared_distance) {
+  const float kSquaredNorm = 512.0f * 512.0f;
+  const float cos_angle = 1.0f - squared_distance / (2.0f * kSquaredNorm);
+  return std::acos(std::max(-1.0f, std::min(1.0f, cos_angle)));
+}
+
+// Nearest neighbor of each descriptor of the first image among those of the
+// second image, or -1 if it fails the ratio test or its distance exceeds
+// max_distance. The distances are computed asymmetrically between the
+// projected descriptors of the first image and the codes of the second image.
+// If the raw descriptors of both images are given, the num_rerank nearest
+// codes are reranked by their exact distances. As for SiftMatchingOptions,
+// max_ratio and max_distance apply to the angles between the descriptors,
+// which are returned in distances.
+inline std::vector<int> NearestNeighborsADC(
+    const ProductQuantizer& quantizer,
+    const ProductQuantizer::Matrix& projected1,
+    const ProductQuantizer::Codes& codes2,
+    const ProductQuantizer::Matrix* raw1,
+    const ProductQuantizer::Matrix* raw2,
+    const double max_ratio,
+    const double max_distance,
+    const int num_rerank,
+    std::vector<float>* distances) {
+  const bool rerank = raw1 != nullptr && raw2 != nullptr;
+  const size_t num_candidates =
+      std::min<size_t>(codes2.rows(), rerank ? std::max(num_rerank, 2) : 2);
+  std::vector<int> nearest(projected1.rows(), -1);
+  distances->assign(projected1.rows(), std::numeric_limits<float>::max());
+  if (num_candidates < 2) {
+    // The ratio test requires a second nearest neighbor.
+    return nearest;
+  }
+  ProductQuantizer::Matrix table;
+  std::vector<std::pair<float, int>> candidates;
+  for (Eigen::Index i = 0; i < projected1.rows(); ++i) {
+    quantizer.ComputeDistanceTable(projected1.row(i).data(), &table);
+    // Max-heap of the nearest codes.
+    candidates.clear();
+    for (Eigen::Index j = 0; j < codes2.rows(); ++j) {
+      const float distance =
+          quantizer.AsymmetricDistance(table, codes2.row(j).data());
+      if (candidates.size() < num_candidates) {
+        candidates.emplace_back(distance, static_cast<int>(j));
+        std::push_heap(candidates.begin(), candidates.end());
+      } else if (distance < candidates.front().first) {
+        std::pop_heap(candidates.begin(), candidates.end());
+        candidates.back() = std::make_pair(distance, static_cast<int>(j));
+        std::push_heap(candidates.begin(), candidates.end());
+      }
+    }
+    if (rerank) {
+      for (std::pair<float, int>& candidate : candidates) {
+        candidate.first =
+            (raw1->row(i) - raw2->row(candidate.second)).squaredNorm();
+      }
+    }
+    std::partial_sort(
+        candidates.begin(), candidates.begin() + 2, candidates.end());
+    const float best_angle = DescriptorAngle(candidates[0].first);
+    const float second_best_angle = DescriptorAngle(candidates[1].first);
+    if (best_angle <= max_distance &&
+        best_angle < max_ratio * second_best_angle) {
+      nearest[i] = candidates[0].second;
+      (*distances)[i] = best_angle;
+    }
+  }
+  return nearest;
+}
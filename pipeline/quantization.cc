@@ -0,0 +1,324 @@
+#include "colmap/estimators/two_view_geometry.h"
+#include "colmap/feature/sift.h"
+#include "colmap/feature/types.h"
+#include "colmap/scene/database.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace colmap;
+
+#include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+#include "helpers.h"
+#include "log_exceptions.h"
+#include "pipeline/product_quantizer.h"
+#include "utils.h"
+
+// Replace the descriptors of all images in the database by their codes, i.e.
+// descriptors with one byte per subspace of the quantizer.
+void CompressDatabase(const std::string& database_path,
+                      const ProductQuantizer& quantizer,
+                      const int num_threads) {
+  THROW_CHECK(quantizer.IsTrained());
+  Database database(database_path);
+  const std::vector<Image> images = database.ReadAllImages();
+  std::vector<FeatureDescriptors> codes(images.size());
+  for (size_t i = 0; i < images.size(); ++i) {
+    const FeatureDescriptors descriptors =
+        database.ReadDescriptors(images[i].ImageId());
+    THROW_CHECK_MSG(descriptors.cols() == quantizer.Dim(),
+                    "Descriptors of image " + images[i].Name() +
+                        " do not match the quantizer, are they compressed?");
+    codes[i] = quantizer.Encode(descriptors.cast<float>(), num_threads);
+  }
+  DatabaseTransaction database_transaction(&database);
+  database.ClearDescriptors();
+  for (size_t i = 0; i < images.size(); ++i) {
+    database.WriteDescriptors(images[i].ImageId(), codes[i]);
+  }
+}
+
+// Match the given pairs of images of a compressed database by asymmetric
+// distances, with the ratio test, maximum distance and optional cross check
+// of the options, and write the matches to the database. Pairs that are
+// already matched are skipped. The raw descriptors of the images, if any,
+// are used as queries and for reranking. Must be called without the GIL.
+// Beyond max_num_matches, the matches of smallest distances are kept.
+void MatchCompressedImagePairs(
+    const std::string& database_path,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const ProductQuantizer& quantizer,
+    const std::string& raw_database_path,
+    const SiftMatchingOptions& options,
+    const int num_rerank) {
+  THROW_CHECK(quantizer.IsTrained());
+  Database database(database_path);
+  std::unique_ptr<Database> raw_database;
+  if (!raw_database_path.empty()) {
+    raw_database.reset(new Database(raw_database_path));
+  }
+  std::mutex database_mutex;
+  ParallelFor(
+      image_pairs.size(),
+      options.num_threads,
+      [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          const image_t image_id1 = image_pairs[i].first;
+          const image_t image_id2 = image_pairs[i].second;
+          ProductQuantizer::Codes codes1;
+          ProductQuantizer::Codes codes2;
+          ProductQuantizer::Matrix raw1;
+          ProductQuantizer::Matrix raw2;
+          {
+            std::lock_guard<std::mutex> lock(database_mutex);
+            if (database.ExistsMatches(image_id1, image_id2)) {
+              continue;
+            }
+            codes1 = database.ReadDescriptors(image_id1);
+            codes2 = database.ReadDescriptors(image_id2);
+            if (raw_database) {
+              raw1 = raw_database->ReadDescriptors(image_id1).cast<float>();
+              raw2 = raw_database->ReadDescriptors(image_id2).cast<float>();
+            }
+          }
+          THROW_CHECK_EQ(codes1.cols(), quantizer.NumSubspaces());
+          THROW_CHECK_EQ(codes2.cols(), quantizer.NumSubspaces());
+          if (raw_database) {
+            THROW_CHECK_EQ(raw1.rows(), codes1.rows());
+            THROW_CHECK_EQ(raw2.rows(), codes2.rows());
+          }
+          const ProductQuantizer::Matrix* raw1_ptr =
+              raw_database ? &raw1 : nullptr;
+          const ProductQuantizer::Matrix* raw2_ptr =
+              raw_database ? &raw2 : nullptr;
+
+          std::vector<float> distances12;
+          const std::vector<int> nearest12 = NearestNeighborsADC(
+              quantizer,
+              raw_database ? quantizer.Project(raw1)
+                           : quantizer.Reconstruct(codes1),
+              codes2,
+              raw1_ptr,
+              raw2_ptr,
+              options.max_ratio,
+              options.max_distance,
+              num_rerank,
+              &distances12);
+          std::vector<int> nearest21;
+          std::vector<float> distances21;
+          if (options.cross_check) {
+            nearest21 = NearestNeighborsADC(
+                quantizer,
+                raw_database ? quantizer.Project(raw2)
+                             : quantizer.Reconstruct(codes2),
+                codes1,
+                raw2_ptr,
+                raw1_ptr,
+                options.max_ratio,
+                options.max_distance,
+                num_rerank,
+                &distances21);
+          }
+          FeatureMatches matches;
+          for (size_t idx1 = 0; idx1 < nearest12.size(); ++idx1) {
+            const int idx2 = nearest12[idx1];
+            if (idx2 >= 0 && (!options.cross_check ||
+                              nearest21[idx2] == static_cast<int>(idx1))) {
+              matches.emplace_back(idx1, idx2);
+            }
+          }
+          // Keep the matches of smallest distances, in the order of idx1.
+          if (options.max_num_matches > 0 &&
+              matches.size() > static_cast<size_t>(options.max_num_matches)) {
+            const auto by_distance = [&distances12](const FeatureMatch& a,
+                                                    const FeatureMatch& b) {
+              return distances12[a.point2D_idx1] <
+                         distances12[b.point2D_idx1] ||
+                     (distances12[a.point2D_idx1] ==
+                          distances12[b.point2D_idx1] &&
+                      a.point2D_idx1 < b.point2D_idx1);
+            };
+            std::nth_element(matches.begin(),
+                             matches.begin() + options.max_num_matches,
+                             matches.end(),
+                             by_distance);
+            matches.resize(options.max_num_matches);
+            std::sort(matches.begin(),
+                      matches.end(),
+                      [](const FeatureMatch& a, const FeatureMatch& b) {
+                        return a.point2D_idx1 < b.point2D_idx1;
+                      });
+          }
+
+          std::lock_guard<std::mutex> lock(database_mutex);
+          database.WriteMatches(image_id1, image_id2, matches);
+        }
+      });
+}
+
+void init_quantization(py::module& m) {
+  using PQOpts = ProductQuantizerOptions;
+  auto PyProductQuantizerOptions =
+      py::class_<PQOpts>(m, "ProductQuantizerOptions")
+          .def(py::init<>())
+          .def_readwrite("num_subspaces",
+                         &PQOpts::num_subspaces,
+                         "Number of subspaces, i.e. bytes per code.")
+          .def_readwrite("pca_dim",
+                         &PQOpts::pca_dim,
+                         "Dimension of the PCA projection of the descriptors "
+                         "before quantization, or -1 to keep all dimensions.")
+          .def_readwrite("num_iterations",
+                         &PQOpts::num_iterations,
+                         "Number of k-means iterations per subspace.")
+          .def_readwrite("max_num_training",
+                         &PQOpts::max_num_training,
+                         "Maximum number of randomly selected training "
+                         "descriptors.")
+          .def_readwrite("seed", &PQOpts::seed)
+          .def_readwrite("num_threads", &PQOpts::num_threads);
+  make_dataclass(PyProductQuantizerOptions);
+  auto quantizer_options = PyProductQuantizerOptions().cast<PQOpts>();
+
+  py::class_<ProductQuantizer>(m, "ProductQuantizer")
+      .def(py::init<>())
+      .def(py::init<const std::string&>(), "path"_a)
+      .def_property_readonly("is_trained", &ProductQuantizer::IsTrained)
+      .def_property_readonly("dim", &ProductQuantizer::Dim)
+      .def_property_readonly("projected_dim", &ProductQuantizer::ProjectedDim)
+      .def_property_readonly("num_subspaces", &ProductQuantizer::NumSubspaces)
+      .def("fit",
+           &ProductQuantizer::Fit,
+           "descriptors"_a,
+           "options"_a = quantizer_options,
+           "Fit the PCA and the codebooks to NxD float descriptors.",
+           py::call_guard<py::gil_scoped_release>())
+      .def(
+          "fit_database",
+          [](ProductQuantizer& self,
+             const py::object& database_path_,
+             const int max_num_images,
+             const int max_num_features,
+             const ProductQuantizerOptions& options) {
+            const std::string database_path =
+                py::str(database_path_).cast<std::string>();
+            THROW_CHECK_FILE_EXISTS(database_path);
+            py::gil_scoped_release release;
+            self.Fit(LoadTrainingDescriptors(database_path,
+                                             max_num_images,
+                                             max_num_features,
+                                             options.max_num_training)
+                         .cast<float>(),
+                     options);
+          },
+          "database_path"_a,
+          "max_num_images"_a = -1,
+          "max_num_features"_a = -1,
+          "options"_a = quantizer_options,
+          "Fit the PCA and the codebooks to the descriptors of a random\n"
+          "subset of the images of a database, with at most\n"
+          "max_num_features largest-scale features per image. Only a\n"
+          "random subset of options.max_num_training of these descriptors\n"
+          "is loaded.")
+      .def("encode",
+           &ProductQuantizer::Encode,
+           "descriptors"_a,
+           "num_threads"_a = -1,
+           "Encode NxD float descriptors into NxM uint8 codes.",
+           py::call_guard<py::gil_scoped_release>())
+      .def("decode",
+           &ProductQuantizer::Decode,
+           "codes"_a,
+           "Reconstruct the NxD descriptors of NxM uint8 codes.")
+      .def("write",
+           &ProductQuantizer::Write,
+           "path"_a,
+           py::call_guard<py::gil_scoped_release>());
+
+  m.def(
+      "compress_database",
+      [](const py::object& database_path_,
+         const ProductQuantizer& quantizer,
+         const int num_threads) {
+        const std::string database_path =
+            py::str(database_path_).cast<std::string>();
+        THROW_CHECK_FILE_EXISTS(database_path);
+        py::gil_scoped_release release;
+        CompressDatabase(database_path, quantizer, num_threads);
+      },
+      "database_path"_a,
+      "quantizer"_a,
+      "num_threads"_a = -1,
+      "Replace the descriptors of all images in the database by their\n"
+      "product quantization codes, in place. Keep a copy of the database\n"
+      "to rerank matches with the raw descriptors.");
+
+  auto sift_matching_options =
+      m.attr("SiftMatchingOptions")().cast<SiftMatchingOptions>();
+  auto verification_options =
+      m.attr("TwoViewGeometryOptions")().cast<TwoViewGeometryOptions>();
+
+  m.def(
+      "match_pairs_compressed",
+      [](const py::object& database_path_,
+         const py::array_t<image_t>& pairs,
+         const ProductQuantizer& quantizer,
+         const py::object& raw_database_path_,
+         SiftMatchingOptions sift_options,
+         const TwoViewGeometryOptions& verification_options,
+         const int num_rerank,
+         const bool verbose) {
+        const std::string database_path =
+            py::str(database_path_).cast<std::string>();
+        THROW_CHECK_FILE_EXISTS(database_path);
+        std::string raw_database_path;
+        if (!raw_database_path_.is_none()) {
+          raw_database_path = py::str(raw_database_path_).cast<std::string>();
+          THROW_CHECK_FILE_EXISTS(raw_database_path);
+        }
+        THROW_CHECK_GT(num_rerank, 1);
+        const ImagePairs image_pairs = ImagePairsFromArray(pairs);
+        // The matches are verified on the CPU, since they already exist.
+        sift_options.use_gpu = false;
+        py::gil_scoped_release release;
+        MatchCompressedImagePairs(database_path,
+                                  image_pairs,
+                                  quantizer,
+                                  raw_database_path,
+                                  sift_options,
+                                  num_rerank);
+        MatchImagePairs(database_path,
+                        image_pairs,
+                        sift_options,
+                        verification_options,
+                        verbose);
+      },
+      "database_path"_a,
+      "pairs"_a,
+      "quantizer"_a,
+      "raw_database_path"_a = py::none(),
+      "sift_options"_a = sift_matching_options,
+      "verification_options"_a = verification_options,
+      "num_rerank"_a = 32,
+      "verbose"_a = true,
+      "Match and verify the Mx2 array of image ids of pairs of a database\n"
+      "compressed with compress_database, by asymmetric distances to the\n"
+      "codes. With the uncompressed database, its descriptors are used as\n"
+      "queries and the num_rerank nearest codes are reranked by their\n"
+      "exact distances. Uses max_ratio, max_distance, cross_check,\n"
+      "max_num_matches and num_threads of sift_options, with distances\n"
+      "converted to angles as by COLMAP. Beyond max_num_matches, the\n"
+      "matches of smallest distances are kept.");
+}
@@ -24,6 +24,9 @@ using namespace pybind11::literals;
 #include "pipeline/extract_features.cc"
 #include "pipeline/images.cc"
 #include "pipeline/match_features.cc"
+#include "pipeline/pairs.cc"
+#include "pipeline/quantization.cc"
+#include "pipeline/sharding.cc"
 
 std::shared_ptr<Reconstruction> triangulate_points(
     const std::shared_ptr<Reconstruction> reconstruction,
@@ -123,6 +126,10 @@ void init_sfm(py::module& m) {
   init_images(m);
   init_extract_features(m);
   init_match_features(m);
+  init_vocab_tree(m);
+  init_pairs(m);
+  init_quantization(m);
+  init_sharding(m);
 
   using Opts = IncrementalMapperOptions;
   auto PyIncrementalMapperOptions =
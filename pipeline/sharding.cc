@@ -0,0 +1,172 @@
+#include "colmap/estimators/two_view_geometry.h"
+#include "colmap/scene/database.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace colmap;
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+#include "helpers.h"
+#include "log_exceptions.h"
+#include "utils.h"
+
+// The pairs assigned to a shard by the hash of their unordered image ids, so
+// that both orders of a pair fall into the same shard.
+ImagePairs ShardImagePairs(const ImagePairs& image_pairs,
+                           const int shard_index,
+                           const int num_shards) {
+  THROW_CHECK_GT(num_shards, 0);
+  THROW_CHECK_GE(shard_index, 0);
+  THROW_CHECK_LT(shard_index, num_shards);
+  ImagePairs shard_image_pairs;
+  for (const auto& image_pair : image_pairs) {
+    const std::string key =
+        std::to_string(std::min(image_pair.first, image_pair.second)) + "," +
+        std::to_string(std::max(image_pair.first, image_pair.second));
+    if (ShardOfKey(key, num_shards) == static_cast<size_t>(shard_index)) {
+      shard_image_pairs.push_back(image_pair);
+    }
+  }
+  return shard_image_pairs;
+}
+
+// Merge the databases of shards into a new database, in the given order so
+// that the ids of the output are deterministic. Images are identified by
+// their names: the first shard with an image provides its camera and
+// features, and the matches and two-view geometries of the later shards are
+// remapped to its id, which requires the same number of keypoints. Cameras
+// are copied per shard, even if equal.
+void MergeDatabases(const std::vector<std::string>& shard_paths,
+                    const std::string& output_path) {
+  Database output(output_path);
+  for (const std::string& shard_path : shard_paths) {
+    Database shard(shard_path);
+    std::vector<Image> images = shard.ReadAllImages();
+    std::sort(images.begin(),
+              images.end(),
+              [](const Image& image1, const Image& image2) {
+                return image1.ImageId() < image2.ImageId();
+              });
+
+    DatabaseTransaction database_transaction(&output);
+    std::unordered_map<camera_t, camera_t> camera_ids;
+    std::unordered_map<image_t, image_t> image_ids;
+    for (Image& image : images) {
+      const image_t shard_image_id = image.ImageId();
+      if (output.ExistsImageWithName(image.Name())) {
+        const image_t image_id =
+            output.ReadImageWithName(image.Name()).ImageId();
+        // The matches of the shard index its own keypoints.
+        THROW_CHECK_MSG(output.NumKeypointsForImage(image_id) ==
+                            shard.NumKeypointsForImage(shard_image_id),
+                        "Image " + image.Name() + " of " + shard_path +
+                            " has different keypoints than in a previous "
+                            "shard.");
+        image_ids.emplace(shard_image_id, image_id);
+        continue;
+      }
+      auto camera_id = camera_ids.find(image.CameraId());
+      if (camera_id == camera_ids.end()) {
+        camera_id =
+            camera_ids
+                .emplace(image.CameraId(),
+                         output.WriteCamera(shard.ReadCamera(image.CameraId())))
+                .first;
+      }
+      image.SetCameraId(camera_id->second);
+      const image_t image_id = output.WriteImage(image);
+      image_ids.emplace(shard_image_id, image_id);
+      if (shard.ExistsKeypoints(shard_image_id)) {
+        output.WriteKeypoints(image_id, shard.ReadKeypoints(shard_image_id));
+      }
+      if (shard.ExistsDescriptors(shard_image_id)) {
+        output.WriteDescriptors(image_id,
+                                shard.ReadDescriptors(shard_image_id));
+      }
+    }
+
+    // The database swaps the matches and geometries if the order of the ids
+    // of a pair changes.
+    for (const auto& pair_matches : shard.ReadAllMatches()) {
+      image_t image_id1;
+      image_t image_id2;
+      Database::PairIdToImagePair(pair_matches.first, &image_id1, &image_id2);
+      image_id1 = image_ids.at(image_id1);
+      image_id2 = image_ids.at(image_id2);
+      if (!output.ExistsMatches(image_id1, image_id2)) {
+        output.WriteMatches(image_id1, image_id2, pair_matches.second);
+      }
+    }
+
+    std::vector<image_pair_t> pair_ids;
+    std::vector<TwoViewGeometry> two_view_geometries;
+    shard.ReadTwoViewGeometries(&pair_ids, &two_view_geometries);
+    for (size_t i = 0; i < pair_ids.size(); ++i) {
+      image_t image_id1;
+      image_t image_id2;
+      Database::PairIdToImagePair(pair_ids[i], &image_id1, &image_id2);
+      image_id1 = image_ids.at(image_id1);
+      image_id2 = image_ids.at(image_id2);
+      if (!output.ExistsInlierMatches(image_id1, image_id2)) {
+        output.WriteTwoViewGeometry(
+            image_id1, image_id2, two_view_geometries[i]);
+      }
+    }
+  }
+}
+
+void init_sharding(py::module& m) {
+  m.def(
+      "shard_pairs",
+      [](const py::array_t<image_t>& pairs,
+         const int shard_index,
+         const int num_shards) {
+        return ImagePairsToArray(ShardImagePairs(
+            ImagePairsFromArray(pairs), shard_index, num_shards));
+      },
+      "pairs"_a,
+      "shard_index"_a,
+      "num_shards"_a,
+      "Rows of the Mx2 array of image ids of pairs assigned to shard\n"
+      "shard_index by a stable hash of their ids, independent of the order\n"
+      "of the ids, e.g. to match a copy of the database per worker.");
+
+  m.def(
+      "merge_databases",
+      [](const std::vector<py::object>& shard_paths_,
+         const py::object& output_path_) {
+        std::vector<std::string> shard_paths;
+        for (const py::object& shard_path_ : shard_paths_) {
+          shard_paths.push_back(py::str(shard_path_).cast<std::string>());
+          THROW_CHECK_FILE_EXISTS(shard_paths.back());
+        }
+        const std::string output_path =
+            py::str(output_path_).cast<std::string>();
+        THROW_CHECK_MSG(!ExistsFile(output_path),
+                        output_path + " already exists.");
+        THROW_CHECK_HAS_FILE_EXTENSION(output_path, ".db");
+        py::gil_scoped_release release;
+        MergeDatabases(shard_paths, output_path);
+      },
+      "shards"_a,
+      "output_path"_a,
+      "Merge the databases of shards, e.g. of extract_features with\n"
+      "num_shards or of matching on shard_pairs, into a new database.\n"
+      "Images with the same name are merged, keeping the camera and\n"
+      "features of the first shard, and the matches and two-view\n"
+      "geometries are remapped to the new image ids. Their features must\n"
+      "thus be the same in all shards, and an error is raised if their\n"
+      "numbers of keypoints differ. Cameras of different shards are not\n"
+      "merged.");
+}
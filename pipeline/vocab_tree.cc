@@ -0,0 +1,582 @@
+#include "colmap/controllers/feature_matching.h"
+#include "colmap/feature/types.h"
+#include "colmap/feature/utils.h"
+#include "colmap/retrieval/visual_index.h"
+#include "colmap/scene/database.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace colmap;
+
+#include <pybind11/eigen.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+#include "helpers.h"
+#include "log_exceptions.h"
+#include "utils.h"
+
+typedef retrieval::VisualIndex<uint8_t, 128, 64> VisualIndexType;
+typedef Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    ImageIdsMatrix;
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    ImageScoresMatrix;
+
+// Vocabulary tree with an inverted index of images that persists across
+// queries and matching runs. It is loaded once from a vocabulary tree file,
+// images are added incrementally, and the index with all its images can be
+// written back to a file, so that the images are indexed only once.
+class VisualIndex {
+ public:
+  explicit VisualIndex(const std::string& path) {
+    THROW_CHECK_FILE_EXISTS(path);
+    index_.Read(path);
+  }
+
+  size_t NumVisualWords() const { return index_.NumVisualWords(); }
+
+  bool Contains(const int image_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.ImageIndexed(image_id);
+  }
+
+  void Write(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.Write(path);
+  }
+
+  // Index the features of an image. Images that are already indexed are
+  // ignored.
+  void Add(const int image_id,
+           const FeatureKeypoints& keypoints,
+           const VisualIndexType::DescType& descriptors,
+           const int num_neighbors,
+           const int num_checks,
+           const int num_threads) {
+    THROW_CHECK_EQ(keypoints.size(), descriptors.rows());
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.ImageIndexed(image_id)) {
+      return;
+    }
+    VisualIndexType::IndexOptions options;
+    options.num_neighbors = num_neighbors;
+    options.num_checks = num_checks;
+    options.num_threads = num_threads;
+    index_.Add(options, image_id, keypoints, descriptors);
+    prepared_ = false;
+  }
+
+  // Index the images of a database that are not yet indexed, with at most
+  // max_num_features of their largest-scale features.
+  void AddDatabase(const std::string& database_path,
+                   const int max_num_features,
+                   const int num_neighbors,
+                   const int num_checks,
+                   const int num_threads) {
+    const Database database(database_path);
+    for (const Image& image : database.ReadAllImages()) {
+      if (Contains(image.ImageId())) {
+        continue;
+      }
+      FeatureKeypoints keypoints = database.ReadKeypoints(image.ImageId());
+      FeatureDescriptors descriptors =
+          database.ReadDescriptors(image.ImageId());
+      if (max_num_features > 0) {
+        ExtractTopScaleFeatures(&keypoints, &descriptors, max_num_features);
+      }
+      Add(image.ImageId(),
+          keypoints,
+          descriptors,
+          num_neighbors,
+          num_checks,
+          num_threads);
+    }
+  }
+
+  // Retrieve the most similar indexed images of each query in parallel. The
+  // keypoints are only required for spatial verification, i.e. if
+  // options.num_images_after_verification > 0, and may otherwise be empty.
+  std::vector<std::vector<retrieval::ImageScore>> Query(
+      const std::vector<FeatureKeypoints>& keypoints,
+      const std::vector<VisualIndexType::DescType>& descriptors,
+      VisualIndexType::QueryOptions options,
+      const int num_threads) {
+    const bool verify = options.num_images_after_verification > 0;
+    if (verify) {
+      THROW_CHECK_EQ(keypoints.size(), descriptors.size());
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!prepared_) {
+      index_.Prepare();
+      prepared_ = true;
+    }
+    // Parallelize over the queries instead of within each query.
+    options.num_threads = 1;
+    std::vector<std::vector<retrieval::ImageScore>> image_scores(
+        descriptors.size());
+    ParallelFor(descriptors.size(),
+                num_threads,
+                [&](size_t, size_t begin, size_t end) {
+                  for (size_t i = begin; i < end; ++i) {
+                    if (verify) {
+                      index_.Query(options,
+                                   keypoints[i],
+                                   descriptors[i],
+                                   &image_scores[i]);
+                    } else {
+                      index_.Query(options, descriptors[i], &image_scores[i]);
+                    }
+                  }
+                });
+    return image_scores;
+  }
+
+ private:
+  VisualIndexType index_;
+  // The index must be prepared after adding images and before querying.
+  bool prepared_ = false;
+  std::mutex mutex_;
+};
+
+// Retrieve the images similar to the query images and add them to the set of
+// image pairs, ordered by image id. The features of the queries are read from
+// the database in blocks, which are then retrieved in parallel.
+void RetrieveImagePairs(const Database& database,
+                        const std::vector<image_t>& query_image_ids,
+                        const VisualIndexType::QueryOptions& query_options,
+                        const int max_num_features,
+                        const int num_threads,
+                        VisualIndex* index,
+                        std::set<std::pair<image_t, image_t>>* image_pairs) {
+  const size_t kBlockSize = 256;
+  std::vector<FeatureKeypoints> keypoints;
+  std::vector<VisualIndexType::DescType> descriptors;
+  for (size_t begin = 0; begin < query_image_ids.size(); begin += kBlockSize) {
+    const size_t end = std::min(begin + kBlockSize, query_image_ids.size());
+    keypoints.resize(end - begin);
+    descriptors.resize(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      keypoints[i - begin] = database.ReadKeypoints(query_image_ids[i]);
+      FeatureDescriptors image_descriptors =
+          database.ReadDescriptors(query_image_ids[i]);
+      if (max_num_features > 0) {
+        ExtractTopScaleFeatures(
+            &keypoints[i - begin], &image_descriptors, max_num_features);
+      }
+      descriptors[i - begin] = image_descriptors;
+    }
+    const std::vector<std::vector<retrieval::ImageScore>> image_scores =
+        index->Query(keypoints, descriptors, query_options, num_threads);
+    for (size_t i = begin; i < end; ++i) {
+      for (const retrieval::ImageScore& image_score : image_scores[i - begin]) {
+        const image_t image_id = static_cast<image_t>(image_score.image_id);
+        if (image_id != query_image_ids[i]) {
+          image_pairs->emplace(std::min(image_id, query_image_ids[i]),
+                               std::max(image_id, query_image_ids[i]));
+        }
+      }
+    }
+  }
+}
+
+// Same selection of image pairs as the vocabulary tree matcher, with the
+// images retrieved from a persistent index. The images of the database that
+// are not yet indexed are added to the index.
+std::vector<std::pair<image_t, image_t>> RetrieveVocabTreeImagePairs(
+    const std::string& database_path,
+    const VocabTreeMatchingOptions& options,
+    const int num_threads,
+    VisualIndex* index) {
+  index->AddDatabase(database_path,
+                     options.max_num_features,
+                     /*num_neighbors=*/1,
+                     options.num_checks,
+                     num_threads);
+
+  const Database database(database_path);
+  std::vector<image_t> query_image_ids;
+  if (options.match_list_path.empty()) {
+    for (const Image& image : database.ReadAllImages()) {
+      query_image_ids.push_back(image.ImageId());
+    }
+  } else {
+    for (const std::string& image_name :
+         ReadTextFileLines(options.match_list_path)) {
+      THROW_CHECK_MSG(database.ExistsImageWithName(image_name),
+                      "Image " + image_name + " does not exist.");
+      query_image_ids.push_back(
+          database.ReadImageWithName(image_name).ImageId());
+    }
+  }
+
+  VisualIndexType::QueryOptions query_options;
+  query_options.max_num_images = options.num_images;
+  query_options.num_neighbors = options.num_nearest_neighbors;
+  query_options.num_checks = options.num_checks;
+  query_options.num_images_after_verification =
+      options.num_images_after_verification;
+  std::set<std::pair<image_t, image_t>> image_pairs;
+  RetrieveImagePairs(database,
+                     query_image_ids,
+                     query_options,
+                     options.max_num_features,
+                     num_threads,
+                     index,
+                     &image_pairs);
+  return {image_pairs.begin(), image_pairs.end()};
+}
+
+void match_vocabtree_with_index(
+    py::object database_path_,
+    VisualIndex& index,
+    SiftMatchingOptions sift_options,
+    const VocabTreeMatchingOptions& options,
+    const TwoViewGeometryOptions& verification_options,
+    const Device device,
+    bool verbose) {
+  const std::string database_path = py::str(database_path_).cast<std::string>();
+  THROW_CHECK_FILE_EXISTS(database_path);
+  sift_options.use_gpu = IsGPU(device);
+  VerifyGPUParams(sift_options.use_gpu);
+  py::gil_scoped_release release;
+  MatchImagePairs(database_path,
+                  RetrieveVocabTreeImagePairs(
+                      database_path, options, sift_options.num_threads, &index),
+                  sift_options,
+                  verification_options,
+                  verbose);
+}
+
+struct VocabTreeTrainingOptions {
+  // Number of visual words, i.e. leaves of the tree.
+  int num_visual_words = 256 * 256;
+
+  // Branching factor of the hierarchical k-means.
+  int branching = 256;
+
+  // Number of k-means iterations at each level of the tree.
+  int num_iterations = 11;
+
+  // Number of nearest-neighbor checks when quantizing descriptors.
+  int num_checks = 256;
+
+  // Maximum number of randomly selected images whose descriptors are used
+  // for training, or -1 for all images.
+  int max_num_images = -1;
+
+  // Maximum number of largest-scale features per image, or -1 for all.
+  int max_num_features = -1;
+
+  int num_threads = -1;
+
+  void Check() const {
+    THROW_CHECK_GT(num_visual_words, 0);
+    THROW_CHECK_GT(branching, 1);
+    THROW_CHECK_GT(num_iterations, 0);
+    THROW_CHECK_GT(num_checks, 0);
+  }
+};
+
+// Build the vocabulary tree from the stacked descriptors and write it in the
+// format of VocabTreeMatchingOptions.vocab_tree_path.
+void TrainVocabTree(const VisualIndexType::DescType& descriptors,
+                    const VocabTreeTrainingOptions& options,
+                    const std::string& output_path) {
+  THROW_CHECK_GE(descriptors.rows(), options.num_visual_words);
+  VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = options.num_visual_words;
+  build_options.branching = options.branching;
+  build_options.num_iterations = options.num_iterations;
+  build_options.num_checks = options.num_checks;
+  build_options.num_threads = options.num_threads;
+  VisualIndexType index;
+  index.Build(build_options, descriptors);
+  index.Write(output_path);
+}
+
+// Stack the descriptors of a random subset of max_num_images images of a
+// database, with at most max_num_features per image, or all if -1. Of these,
+// only a uniformly random subset of max_num_descriptors is read, or all if
+// -1, so that memory is bounded by the subset. The subsets are seeded, so
+// that the training is reproducible.
+VisualIndexType::DescType LoadTrainingDescriptors(
+    const std::string& database_path,
+    const int max_num_images,
+    const int max_num_features,
+    const int max_num_descriptors) {
+  const Database database(database_path);
+  std::vector<Image> images = database.ReadAllImages();
+  std::mt19937 prng(0);
+  if (max_num_images >= 0 &&
+      images.size() > static_cast<size_t>(max_num_images)) {
+    std::shuffle(images.begin(), images.end(), prng);
+    images.resize(max_num_images);
+  }
+
+  std::vector<size_t> num_image_descriptors(images.size());
+  size_t num_candidates = 0;
+  for (size_t i = 0; i < images.size(); ++i) {
+    num_image_descriptors[i] =
+        database.NumKeypointsForImage(images[i].ImageId());
+    if (max_num_features > 0) {
+      num_image_descriptors[i] = std::min(
+          num_image_descriptors[i], static_cast<size_t>(max_num_features));
+    }
+    num_candidates += num_image_descriptors[i];
+  }
+  size_t num_descriptors = num_candidates;
+  if (max_num_descriptors >= 0) {
+    num_descriptors =
+        std::min(num_descriptors, static_cast<size_t>(max_num_descriptors));
+  }
+
+  // Selection sampling (Knuth, TAOCP Vol. 2, Algorithm S) over the candidates
+  // in order, so that only the images with selected descriptors are read.
+  VisualIndexType::DescType descriptors(num_descriptors, 128);
+  size_t row = 0;
+  size_t num_remaining = num_candidates;
+  std::vector<Eigen::Index> selected_rows;
+  for (size_t i = 0; i < images.size(); ++i) {
+    selected_rows.clear();
+    for (size_t j = 0; j < num_image_descriptors[i]; ++j) {
+      const size_t num_needed = num_descriptors - row - selected_rows.size();
+      if (num_needed >= num_remaining ||
+          std::uniform_int_distribution<size_t>(0, num_remaining - 1)(prng) <
+              num_needed) {
+        selected_rows.push_back(j);
+      }
+      --num_remaining;
+    }
+    if (selected_rows.empty()) {
+      continue;
+    }
+    FeatureKeypoints keypoints = database.ReadKeypoints(images[i].ImageId());
+    FeatureDescriptors image_descriptors =
+        database.ReadDescriptors(images[i].ImageId());
+    if (max_num_features > 0) {
+      ExtractTopScaleFeatures(&keypoints, &image_descriptors, max_num_features);
+    }
+    THROW_CHECK_EQ(static_cast<size_t>(image_descriptors.rows()),
+                   num_image_descriptors[i]);
+    for (const Eigen::Index selected_row : selected_rows) {
+      descriptors.row(row++) = image_descriptors.row(selected_row);
+    }
+  }
+  return descriptors;
+}
+
+void init_vocab_tree(py::module& m) {
+  py::class_<VisualIndex>(m, "VisualIndex")
+      .def(py::init<const std::string&>(),
+           "path"_a,
+           "Load a vocabulary tree, possibly with indexed images, as written\n"
+           "by COLMAP or VisualIndex.write.")
+      .def_property_readonly("num_visual_words", &VisualIndex::NumVisualWords)
+      .def("__contains__", &VisualIndex::Contains, "image_id"_a)
+      .def("write",
+           &VisualIndex::Write,
+           "path"_a,
+           "Write the vocabulary tree and the indexed images.",
+           py::call_guard<py::gil_scoped_release>())
+      .def(
+          "add",
+          [](VisualIndex& self,
+             const int image_id,
+             const VisualIndexType::DescType& descriptors,
+             const py::object& keypoints,
+             const int num_neighbors,
+             const int num_checks,
+             const int num_threads) {
+            FeatureKeypoints image_keypoints(descriptors.rows());
+            if (!keypoints.is_none()) {
+              const Eigen::MatrixXf xy = keypoints.cast<Eigen::MatrixXf>();
+              THROW_CHECK_EQ(xy.rows(), descriptors.rows());
+              THROW_CHECK_GE(xy.cols(), 2);
+              for (Eigen::Index i = 0; i < xy.rows(); ++i) {
+                image_keypoints[i] = FeatureKeypoint(xy(i, 0), xy(i, 1));
+              }
+            }
+            py::gil_scoped_release release;
+            self.Add(image_id,
+                     image_keypoints,
+                     descriptors,
+                     num_neighbors,
+                     num_checks,
+                     num_threads);
+          },
+          "image_id"_a,
+          "descriptors"_a,
+          "keypoints"_a = py::none(),
+          "num_neighbors"_a = 1,
+          "num_checks"_a = 256,
+          "num_threads"_a = -1,
+          "Index the Nx128 uint8 descriptors of an image. The Nx2 keypoints\n"
+          "are only needed for spatial verification of the queries.")
+      .def("add_database",
+           &VisualIndex::AddDatabase,
+           "database_path"_a,
+           "max_num_features"_a = -1,
+           "num_neighbors"_a = 1,
+           "num_checks"_a = 256,
+           "num_threads"_a = -1,
+           "Index the images of a database that are not yet indexed.",
+           py::call_guard<py::gil_scoped_release>())
+      .def(
+          "query",
+          [](VisualIndex& self,
+             const std::vector<VisualIndexType::DescType>& descriptors,
+             const int num_images,
+             const int num_neighbors,
+             const int num_checks,
+             const int num_threads) {
+            THROW_CHECK_GT(num_images, 0);
+            VisualIndexType::QueryOptions options;
+            options.max_num_images = num_images;
+            options.num_neighbors = num_neighbors;
+            options.num_checks = num_checks;
+            ImageIdsMatrix image_ids =
+                ImageIdsMatrix::Constant(descriptors.size(), num_images, -1);
+            ImageScoresMatrix scores =
+                ImageScoresMatrix::Zero(descriptors.size(), num_images);
+            {
+              py::gil_scoped_release release;
+              const std::vector<std::vector<retrieval::ImageScore>>
+                  image_scores =
+                      self.Query({}, descriptors, options, num_threads);
+              for (size_t i = 0; i < image_scores.size(); ++i) {
+                for (size_t j = 0; j < image_scores[i].size(); ++j) {
+                  image_ids(i, j) = image_scores[i][j].image_id;
+                  scores(i, j) = image_scores[i][j].score;
+                }
+              }
+            }
+            return py::make_tuple(image_ids, scores);
+          },
+          "descriptors"_a,
+          "num_images"_a = 100,
+          "num_neighbors"_a = 5,
+          "num_checks"_a = 256,
+          "num_threads"_a = -1,
+          "Retrieve the num_images most similar indexed images for each of\n"
+          "the given Nx128 uint8 descriptors, in parallel. Returns QxK\n"
+          "arrays of image ids and scores, sorted by decreasing score and\n"
+          "padded with -1 and 0.");
+
+  auto sift_matching_options =
+      m.attr("SiftMatchingOptions")().cast<SiftMatchingOptions>();
+  auto vocabtree_options =
+      m.attr("VocabTreeMatchingOptions")().cast<VocabTreeMatchingOptions>();
+  auto verification_options =
+      m.attr("TwoViewGeometryOptions")().cast<TwoViewGeometryOptions>();
+
+  m.def("match_vocabtree",
+        &match_vocabtree_with_index,
+        "database_path"_a,
+        "index"_a,
+        "sift_options"_a = sift_matching_options,
+        "matching_options"_a = vocabtree_options,
+        "verification_options"_a = verification_options,
+        "device"_a = Device::AUTO,
+        "verbose"_a = true,
+        "Vocab tree feature matching with a persistent VisualIndex, which\n"
+        "replaces matching_options.vocab_tree_path. Images of the database\n"
+        "that are not yet in the index are added to it.");
+
+  auto PyTrainingOptions =
+      py::class_<VocabTreeTrainingOptions>(m, "VocabTreeTrainingOptions")
+          .def(py::init<>())
+          .def_readwrite("num_visual_words",
+                         &VocabTreeTrainingOptions::num_visual_words)
+          .def_readwrite("branching", &VocabTreeTrainingOptions::branching)
+          .def_readwrite("num_iterations",
+                         &VocabTreeTrainingOptions::num_iterations)
+          .def_readwrite("num_checks", &VocabTreeTrainingOptions::num_checks)
+          .def_readwrite("max_num_images",
+                         &VocabTreeTrainingOptions::max_num_images,
+                         "Maximum number of random training images of the "
+                         "database, or -1 for all.")
+          .def_readwrite("max_num_features",
+                         &VocabTreeTrainingOptions::max_num_features,
+                         "Maximum number of largest-scale features per "
+                         "image, or -1 for all.")
+          .def_readwrite("num_threads",
+                         &VocabTreeTrainingOptions::num_threads);
+  make_dataclass(PyTrainingOptions);
+  auto training_options = PyTrainingOptions().cast<VocabTreeTrainingOptions>();
+
+  m.def(
+      "train_vocab_tree",
+      [](const py::object& database_path_,
+         const py::object& output_path_,
+         const VocabTreeTrainingOptions& options) {
+        options.Check();
+        const std::string database_path =
+            py::str(database_path_).cast<std::string>();
+        THROW_CHECK_FILE_EXISTS(database_path);
+        const std::string output_path =
+            py::str(output_path_).cast<std::string>();
+        THROW_CHECK_FILE_OPEN(output_path);
+        {
+          py::gil_scoped_release release;
+          TrainVocabTree(
+              LoadTrainingDescriptors(database_path,
+                                      options.max_num_images,
+                                      options.max_num_features,
+                                      /*max_num_descriptors=*/-1),
+              options,
+              output_path);
+        }
+        return std::unique_ptr<VisualIndex>(new VisualIndex(output_path));
+      },
+      "database_path"_a,
+      "output_path"_a,
+      "options"_a = training_options,
+      "Train a vocabulary tree by hierarchical k-means on the descriptors\n"
+      "of a database, write it to output_path in the format of\n"
+      "VocabTreeMatchingOptions.vocab_tree_path, and return it as an empty\n"
+      "VisualIndex.");
+
+  m.def(
+      "train_vocab_tree",
+      [](const std::vector<VisualIndexType::DescType>& descriptors,
+         const py::object& output_path_,
+         const VocabTreeTrainingOptions& options) {
+        options.Check();
+        const std::string output_path =
+            py::str(output_path_).cast<std::string>();
+        THROW_CHECK_FILE_OPEN(output_path);
+        {
+          py::gil_scoped_release release;
+          Eigen::Index num_descriptors = 0;
+          for (const auto& image_descriptors : descriptors) {
+            num_descriptors += image_descriptors.rows();
+          }
+          VisualIndexType::DescType stacked_descriptors(num_descriptors, 128);
+          Eigen::Index row = 0;
+          for (const auto& image_descriptors : descriptors) {
+            stacked_descriptors.middleRows(row, image_descriptors.rows()) =
+                image_descriptors;
+            row += image_descriptors.rows();
+          }
+          TrainVocabTree(stacked_descriptors, options, output_path);
+        }
+        return std::unique_ptr<VisualIndex>(new VisualIndex(output_path));
+      },
+      "descriptors"_a,
+      "output_path"_a,
+      "options"_a = training_options,
+      "Train a vocabulary tree on a list of Nx128 uint8 descriptor arrays.\n"
+      "max_num_images and max_num_features are ignored.");
+}
@@ -14,6 +14,7 @@ using namespace colmap;
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+#include "helpers.h"
 #include "log_exceptions.h"
 
 PYBIND11_MAKE_OPAQUE(std::unordered_map<camera_t, Camera>);
@@ -34,19 +35,13 @@ void init_camera(py::module& m) {
   using CameraMap = std::unordered_map<camera_t, Camera>;
 
   py::bind_map<CameraMap>(m, "MapCameraIdCamera")
-      .def("__repr__", [](const CameraMap& self) {
-        std::string repr = "{";
-        bool is_first = true;
-        for (auto& pair : self) {
-          if (!is_first) {
-            repr += ", ";
-          }
-          is_first = false;
-          repr += std::to_string(pair.first) + ": " + PrintCamera(pair.second);
-        }
-        repr += "}";
-        return repr;
-      });
+      .def("__repr__",
+           [](const CameraMap& self) {
+             return PrintMapTruncated(self, PrintCamera);
+           })
+      .def("keys_array",
+           &MapKeysArray<CameraMap>,
+           "Keys as a numpy array, in iteration order.");
 
   py::class_<Camera, std::shared_ptr<Camera>>(m, "Camera")
       .def(py::init<>())
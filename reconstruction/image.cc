@@ -16,6 +16,7 @@ using namespace colmap;
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+#include "helpers.h"
 #include "log_exceptions.h"
 
 PYBIND11_MAKE_OPAQUE(std::unordered_map<image_t, Image>);
@@ -53,19 +54,35 @@ std::shared_ptr<Image> MakeImage(const std::string& name,
 void init_image(py::module& m) {
   using ImageMap = std::unordered_map<image_t, Image>;
   py::bind_map<ImageMap>(m, "MapImageIdImage")
-      .def("__repr__", [](const ImageMap& self) {
-        std::string repr = "{";
-        bool is_first = true;
-        for (auto& pair : self) {
-          if (!is_first) {
-            repr += ", ";
-          }
-          is_first = false;
-          repr += std::to_string(pair.first) + ": " + PrintImage(pair.second);
-        }
-        repr += "}";
-        return repr;
-      });
+      .def("__repr__",
+           [](const ImageMap& self) {
+             return PrintMapTruncated(self, PrintImage);
+           })
+      .def("keys_array",
+           &MapKeysArray<ImageMap>,
+           "Keys as a numpy array, in iteration order.")
+      .def(
+          "where",
+          [](const ImageMap& self,
+             const py::object& registered,
+             const py::object& camera_id) {
+            const bool check_registered = !registered.is_none();
+            const bool is_registered =
+                check_registered && registered.cast<bool>();
+            const bool check_camera_id = !camera_id.is_none();
+            const camera_t required_camera_id =
+                check_camera_id ? camera_id.cast<camera_t>()
+                                : kInvalidCameraId;
+            return MapKeysWhere(self, [&](const Image& image) {
+              return (!check_registered ||
+                      image.IsRegistered() == is_registered) &&
+                     (!check_camera_id ||
+                      image.CameraId() == required_camera_id);
+            });
+          },
+          "registered"_a = py::none(),
+          "camera_id"_a = py::none(),
+          "Ids of the images that match all given filters as a numpy array.");
 
   py::class_<Image, std::shared_ptr<Image>>(m, "Image")
       .def(py::init<>())
@@ -15,6 +15,7 @@ using namespace colmap;
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+#include "helpers.h"
 #include "log_exceptions.h"
 
 PYBIND11_MAKE_OPAQUE(std::unordered_map<point3D_t, Point3D>);
@@ -31,19 +32,55 @@ void init_point3D(py::module& m) {
   using Point3DMap = std::unordered_map<point3D_t, Point3D>;
 
   py::bind_map<Point3DMap>(m, "MapPoint3DIdPoint3D")
-      .def("__repr__", [](const Point3DMap& self) {
-        std::string repr = "{";
-        bool is_first = true;
-        for (auto& pair : self) {
-          if (!is_first) {
-            repr += ", ";
-          }
-          is_first = false;
-          repr += std::to_string(pair.first) + ": " + PrintPoint3D(pair.second);
-        }
-        repr += "}";
-        return repr;
-      });
+      .def("__repr__",
+           [](const Point3DMap& self) {
+             return PrintMapTruncated(self, PrintPoint3D);
+           })
+      .def("keys_array",
+           &MapKeysArray<Point3DMap>,
+           "Keys as a numpy array, in iteration order.")
+      .def(
+          "where",
+          [](const Point3DMap& self,
+             const size_t min_track_length,
+             const int max_track_length,
+             const double max_error) {
+            return MapKeysWhere(self, [&](const Point3D& point3D) {
+              const size_t track_length = point3D.Track().Length();
+              return track_length >= min_track_length &&
+                     (max_track_length < 0 ||
+                      track_length <= static_cast<size_t>(max_track_length)) &&
+                     point3D.Error() <= max_error;
+            });
+          },
+          "min_track_length"_a = 0,
+          "max_track_length"_a = -1,
+          "max_error"_a = std::numeric_limits<double>::infinity(),
+          "Ids of the points that match all given filters as a numpy array.\n"
+          "A negative max_track_length disables the upper bound.")
+      .def(
+          "xyz_array",
+          [](const Point3DMap& self) {
+            Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor> xyz(
+                self.size(), 3);
+            size_t i = 0;
+            for (auto& pair : self) {
+              xyz.row(i++) = pair.second.XYZ();
+            }
+            return xyz;
+          },
+          "Nx3 array of the point positions, in the order of keys_array.")
+      .def(
+          "errors_array",
+          [](const Point3DMap& self) {
+            Eigen::VectorXd errors(self.size());
+            size_t i = 0;
+            for (auto& pair : self) {
+              errors(i++) = pair.second.Error();
+            }
+            return errors;
+          },
+          "Reprojection errors, in the order of keys_array.");
 
   py::class_<Point3D, std::shared_ptr<Point3D>>(m, "Point3D")
       .def(py::init<>())
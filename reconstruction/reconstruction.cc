@@ -1,13 +1,22 @@
 // Author: Philipp Lindenberger (Phil26AT)
 #include "colmap/scene/reconstruction.h"
 
+#include "colmap/geometry/pose.h"
+#include "colmap/geometry/sim3.h"
+#include "colmap/sensor/bitmap.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/ply.h"
 #include "colmap/util/types.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
 #include <memory>
 
+#include <FreeImage.h>
+
 using namespace colmap;
 
 #include <pybind11/eigen.h>
@@ -23,7 +32,9 @@ using namespace pybind11::literals;
 #include "reconstruction/image.cc"
 #include "reconstruction/point2D.cc"
 #include "reconstruction/point3D.cc"
+#include "reconstruction/text_io.cc"
 #include "reconstruction/track.cc"
+#include "utils.h"
 
 void init_track(py::module&);
 void init_point2D(py::module&);
@@ -67,6 +78,326 @@ bool ExistsReconstruction(const std::string& path) {
       std::invalid_argument,                          \
       std::string("cameras, images, points3D not found at ") + input_path);
 
+// Reconstruction only exposes const views of its images and 3D points. The
+// reconstruction itself is mutable here, so writing through them is
+// well-defined as long as no element is inserted or erased.
+std::unordered_map<image_t, Image>& MutableImages(
+    Reconstruction& reconstruction) {
+  return const_cast<std::unordered_map<image_t, Image>&>(
+      reconstruction.Images());
+}
+
+std::unordered_map<point3D_t, Point3D>& MutablePoints3D(
+    Reconstruction& reconstruction) {
+  return const_cast<std::unordered_map<point3D_t, Point3D>&>(
+      reconstruction.Points3D());
+}
+
+// Same as Reconstruction::Transform but processes chunks of the image and
+// 3D point storage in parallel.
+void TransformReconstruction(Reconstruction& reconstruction,
+                             const Sim3d& new_from_old_world,
+                             const int num_threads) {
+  ParallelForEachInMap(
+      MutableImages(reconstruction), num_threads, [&](size_t, auto& image) {
+        image.second.CamFromWorld() = TransformCameraWorld(
+            new_from_old_world, image.second.CamFromWorld());
+      });
+  ParallelForEachInMap(
+      MutablePoints3D(reconstruction), num_threads, [&](size_t, auto& point) {
+        point.second.XYZ() = new_from_old_world * point.second.XYZ();
+      });
+}
+
+// Same as Reconstruction::Normalize but gathers the coordinates in parallel
+// and computes the robust bounds with selection instead of sorting.
+void NormalizeReconstruction(Reconstruction& reconstruction,
+                             const double extent,
+                             const double p0,
+                             const double p1,
+                             const bool use_images,
+                             const int num_threads) {
+  THROW_CHECK_GT(extent, 0);
+  THROW_CHECK_GE(p0, 0);
+  THROW_CHECK_LE(p0, 1);
+  THROW_CHECK_GE(p1, 0);
+  THROW_CHECK_LE(p1, 1);
+  THROW_CHECK_LE(p0, p1);
+
+  const size_t num_elements = use_images ? reconstruction.NumRegImages()
+                                         : reconstruction.NumPoints3D();
+  if (num_elements < 2) {
+    return;
+  }
+
+  // Coordinates of image centers or point locations.
+  std::array<std::vector<double>, 3> coords;
+  for (auto& coord : coords) {
+    coord.resize(num_elements);
+  }
+  if (use_images) {
+    const std::vector<image_t>& reg_image_ids = reconstruction.RegImageIds();
+    ParallelFor(
+        num_elements, num_threads, [&](size_t, size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const Eigen::Vector3d proj_center =
+                reconstruction.Image(reg_image_ids[i]).ProjectionCenter();
+            for (int d = 0; d < 3; ++d) {
+              coords[d][i] = proj_center(d);
+            }
+          }
+        });
+  } else {
+    // Bucket ranges have a variable number of points, so first compute the
+    // output offset of each chunk.
+    const auto& points3D = reconstruction.Points3D();
+    const size_t num_buckets = points3D.bucket_count();
+    const size_t num_chunks = NumParallelChunks(num_buckets, num_threads);
+    std::vector<size_t> chunk_offsets(num_chunks + 1, 0);
+    ParallelFor(
+        num_buckets,
+        num_threads,
+        [&](size_t chunk_idx, size_t begin, size_t end) {
+          for (size_t bucket = begin; bucket < end; ++bucket) {
+            chunk_offsets[chunk_idx + 1] += points3D.bucket_size(bucket);
+          }
+        });
+    for (size_t i = 0; i < num_chunks; ++i) {
+      chunk_offsets[i + 1] += chunk_offsets[i];
+    }
+    ParallelFor(
+        num_buckets,
+        num_threads,
+        [&](size_t chunk_idx, size_t begin, size_t end) {
+          size_t i = chunk_offsets[chunk_idx];
+          for (size_t bucket = begin; bucket < end; ++bucket) {
+            for (auto it = points3D.begin(bucket); it != points3D.end(bucket);
+                 ++it, ++i) {
+              for (int d = 0; d < 3; ++d) {
+                coords[d][i] = it->second.XYZ()(d);
+              }
+            }
+          }
+        });
+  }
+
+  // Determine robust bounding box and mean.
+  const size_t P0 = static_cast<size_t>(
+      (num_elements > 3) ? p0 * (num_elements - 1) : 0);
+  const size_t P1 = static_cast<size_t>(
+      (num_elements > 3) ? p1 * (num_elements - 1) : num_elements - 1);
+  Eigen::Vector3d bbox_min;
+  Eigen::Vector3d bbox_max;
+  Eigen::Vector3d mean_coord;
+  ParallelFor(3, num_threads, [&](size_t, size_t begin, size_t end) {
+    for (size_t d = begin; d < end; ++d) {
+      std::vector<double>& coord = coords[d];
+      std::nth_element(coord.begin(), coord.begin() + P0, coord.end());
+      std::nth_element(coord.begin() + P0, coord.begin() + P1, coord.end());
+      bbox_min(d) = coord[P0];
+      bbox_max(d) = coord[P1];
+      double sum = 0;
+      for (size_t i = P0; i <= P1; ++i) {
+        sum += coord[i];
+      }
+      mean_coord(d) = sum / (P1 - P0 + 1);
+    }
+  });
+
+  // Calculate scale and translation, such that
+  // translation is applied before scaling.
+  const double old_extent = (bbox_max - bbox_min).norm();
+  double scale;
+  if (old_extent < std::numeric_limits<double>::epsilon()) {
+    scale = 1;
+  } else {
+    scale = extent / old_extent;
+  }
+
+  const Sim3d tform(
+      scale, Eigen::Quaterniond::Identity(), -scale * mean_coord);
+  TransformReconstruction(reconstruction, tform, num_threads);
+}
+
+// Read an image as RGB for color extraction. For scale < 1, JPEG files are
+// decoded directly at reduced resolution by the JPEG codec (which only
+// supports downscaling by powers of two, so the decoded size is at least the
+// requested size). Other formats are always decoded at full resolution.
+bool ReadBitmapForColors(const std::string& path,
+                         const Camera& camera,
+                         const double scale,
+                         Bitmap* bitmap) {
+  if (scale < 1 && FreeImage_GetFileType(path.c_str(), 0) == FIF_JPEG) {
+    const int requested_size = std::max<int>(
+        1, std::ceil(scale * std::max(camera.Width(), camera.Height())));
+    FIBITMAP* data = FreeImage_Load(
+        FIF_JPEG, path.c_str(), JPEG_ACCURATE | (requested_size << 16));
+    if (data == nullptr) {
+      return false;
+    }
+    if (FreeImage_GetBPP(data) != 24 ||
+        FreeImage_GetColorType(data) != FIC_RGB) {
+      FIBITMAP* converted_data = FreeImage_ConvertTo24Bits(data);
+      FreeImage_Unload(data);
+      if (converted_data == nullptr) {
+        return false;
+      }
+      data = converted_data;
+    }
+    *bitmap = Bitmap(data);
+    return true;
+  }
+  return bitmap->Read(path, /*as_rgb=*/true);
+}
+
+// Same as Reconstruction::ExtractColorsForAllImages but decodes the images on
+// num_threads threads, so that at most num_threads images are held in memory
+// at any time. Each thread accumulates the colors in its own buffer and the
+// buffers are reduced at the end.
+void ExtractColorsForAllImages(Reconstruction& reconstruction,
+                               const std::string& path,
+                               const double scale,
+                               const int num_threads) {
+  THROW_CHECK_GT(scale, 0);
+  THROW_CHECK_LE(scale, 1);
+
+  struct ColorSum {
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    size_t count = 0;
+  };
+  using ColorSums = std::unordered_map<point3D_t, ColorSum>;
+
+  const std::vector<image_t>& reg_image_ids = reconstruction.RegImageIds();
+  const size_t num_chunks =
+      NumParallelChunks(reg_image_ids.size(), num_threads);
+  std::vector<ColorSums> chunk_color_sums(num_chunks);
+  std::vector<std::vector<std::string>> chunk_failed_paths(num_chunks);
+  ParallelFor(
+      reg_image_ids.size(),
+      num_threads,
+      [&](size_t chunk_idx, size_t begin, size_t end) {
+        ColorSums& color_sums = chunk_color_sums[chunk_idx];
+        for (size_t i = begin; i < end; ++i) {
+          const Image& image = reconstruction.Image(reg_image_ids[i]);
+          const Camera& camera = reconstruction.Camera(image.CameraId());
+          const std::string image_path = JoinPaths(path, image.Name());
+          Bitmap bitmap;
+          if (!ReadBitmapForColors(image_path, camera, scale, &bitmap)) {
+            chunk_failed_paths[chunk_idx].push_back(image_path);
+            continue;
+          }
+          const double scale_x =
+              static_cast<double>(bitmap.Width()) / camera.Width();
+          const double scale_y =
+              static_cast<double>(bitmap.Height()) / camera.Height();
+          for (const Point2D& point2D : image.Points2D()) {
+            if (!point2D.HasPoint3D()) {
+              continue;
+            }
+            BitmapColor<float> color;
+            // COLMAP assumes that the upper left pixel center is (0.5, 0.5).
+            if (bitmap.InterpolateBilinear(scale_x * point2D.xy(0) - 0.5,
+                                           scale_y * point2D.xy(1) - 0.5,
+                                           &color)) {
+              ColorSum& color_sum = color_sums[point2D.point3D_id];
+              color_sum.sum += Eigen::Vector3d(color.r, color.g, color.b);
+              color_sum.count += 1;
+            }
+          }
+        }
+      });
+
+  for (const auto& failed_paths : chunk_failed_paths) {
+    for (const auto& failed_path : failed_paths) {
+      std::cout << "Could not read image at path " << failed_path << "."
+                << std::endl;
+    }
+  }
+
+  const Eigen::Vector3ub kBlackColor(0, 0, 0);
+  ParallelForEachInMap(
+      MutablePoints3D(reconstruction), num_threads, [&](size_t, auto& point) {
+        ColorSum total;
+        for (const ColorSums& color_sums : chunk_color_sums) {
+          const auto it = color_sums.find(point.first);
+          if (it != color_sums.end()) {
+            total.sum += it->second.sum;
+            total.count += it->second.count;
+          }
+        }
+        if (total.count == 0) {
+          point.second.Color() = kBlackColor;
+          return;
+        }
+        Eigen::Vector3d color = total.sum / total.count;
+        for (Eigen::Index i = 0; i < color.size(); ++i) {
+          color[i] = std::round(color[i]);
+        }
+        point.second.Color() = color.cast<uint8_t>();
+      });
+}
+
+// Summary statistics of a reconstruction. The observation counts are
+// maintained per image by COLMAP and are gathered in O(num_reg_images), so
+// only the reprojection error requires a (parallel) pass over the points.
+struct ReconstructionStats {
+  size_t num_reg_images = 0;
+  size_t num_cameras = 0;
+  size_t num_points3D = 0;
+  size_t num_observations = 0;
+  double mean_track_length = 0;
+  double mean_observations_per_reg_image = 0;
+  double mean_reprojection_error = 0;
+};
+
+size_t ComputeNumObservations(const Reconstruction& reconstruction) {
+  size_t num_observations = 0;
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    num_observations += reconstruction.Image(image_id).NumPoints3D();
+  }
+  return num_observations;
+}
+
+ReconstructionStats ComputeReconstructionStats(
+    const Reconstruction& reconstruction, const int num_threads) {
+  ReconstructionStats stats;
+  stats.num_reg_images = reconstruction.NumRegImages();
+  stats.num_cameras = reconstruction.NumCameras();
+  stats.num_points3D = reconstruction.NumPoints3D();
+  stats.num_observations = ComputeNumObservations(reconstruction);
+  if (stats.num_points3D > 0) {
+    stats.mean_track_length =
+        static_cast<double>(stats.num_observations) / stats.num_points3D;
+  }
+  if (stats.num_reg_images > 0) {
+    stats.mean_observations_per_reg_image =
+        static_cast<double>(stats.num_observations) / stats.num_reg_images;
+  }
+
+  const auto& points3D = reconstruction.Points3D();
+  const size_t num_chunks =
+      NumParallelChunks(points3D.bucket_count(), num_threads);
+  std::vector<double> chunk_error_sums(num_chunks, 0);
+  std::vector<size_t> chunk_num_valid_errors(num_chunks, 0);
+  ParallelForEachInMap(
+      points3D, num_threads, [&](size_t chunk_idx, const auto& point) {
+        if (point.second.HasError()) {
+          chunk_error_sums[chunk_idx] += point.second.Error();
+          chunk_num_valid_errors[chunk_idx] += 1;
+        }
+      });
+  double error_sum = 0;
+  size_t num_valid_errors = 0;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    error_sum += chunk_error_sums[i];
+    num_valid_errors += chunk_num_valid_errors[i];
+  }
+  if (num_valid_errors > 0) {
+    stats.mean_reprojection_error = error_sum / num_valid_errors;
+  }
+  return stats;
+}
+
 // Reconstruction Bindings
 void init_reconstruction(py::module& m) {
   // STL Containers, required for fast looping over members (avoids copying)
@@ -110,21 +441,39 @@ void init_reconstruction(py::module& m) {
           },
           "output_dir"_a,
           "Write reconstruction in COLMAP binary format.")
-      .def("read_text",
-           [](Reconstruction& self, const std::string& input_path) {
-             THROW_CHECK_RECONSTRUCTION_TEXT_EXISTS(input_path);
-             self.ReadText(input_path);
-           })
+      .def(
+          "read_text",
+          [](Reconstruction& self,
+             const std::string& input_path,
+             const int num_threads) {
+            THROW_CHECK_RECONSTRUCTION_TEXT_EXISTS(input_path);
+            py::gil_scoped_release release;
+            ReadReconstructionText(self, input_path, num_threads);
+          },
+          "input_path"_a,
+          "num_threads"_a = -1,
+          "Read reconstruction in COLMAP text format. The files are parsed "
+          "in\n"
+          "parallel chunks using num_threads threads (-1 for all cores).")
       .def("read_binary",
            [](Reconstruction& self, const std::string& input_path) {
              THROW_CHECK_RECONSTRUCTION_BIN_EXISTS(input_path);
              self.ReadBinary(input_path);
            })
-      .def("write_text",
-           [](const Reconstruction& self, const std::string& path) {
-             THROW_CHECK_DIR_EXISTS(path);
-             self.WriteText(path);
-           })
+      .def(
+          "write_text",
+          [](const Reconstruction& self,
+             const std::string& path,
+             const int num_threads) {
+            THROW_CHECK_DIR_EXISTS(path);
+            py::gil_scoped_release release;
+            WriteReconstructionText(self, path, num_threads);
+          },
+          "output_path"_a,
+          "num_threads"_a = -1,
+          "Write reconstruction in COLMAP text format. The lines are "
+          "formatted in\n"
+          "parallel chunks using num_threads threads (-1 for all cores).")
       .def("write_binary",
            [](const Reconstruction& self, const std::string& path) {
              THROW_CHECK_DIR_EXISTS(path);
@@ -222,7 +571,21 @@ void init_reconstruction(py::module& m) {
            "Check if image is registered.")
       .def(
           "normalize",
-          &Reconstruction::Normalize,
+          [](Reconstruction& self,
+             const double extent,
+             const double p0,
+             const double p1,
+             const bool use_images,
+             const int num_threads) {
+            py::gil_scoped_release release;
+            NormalizeReconstruction(
+                self, extent, p0, p1, use_images, num_threads);
+          },
+          "extent"_a = 10.0,
+          "p0"_a = 0.1,
+          "p1"_a = 0.9,
+          "use_images"_a = true,
+          "num_threads"_a = -1,
           "Normalize scene by scaling and translation to avoid degenerate\n"
           "visualization after bundle adjustment and to improve numerical\n"
           "stability of algorithms.\n\n"
@@ -231,10 +594,24 @@ void init_reconstruction(py::module& m) {
           "Scales scene such that the minimum and maximum camera centers are "
           "at the\n"
           "given `extent`, whereas `p0` and `p1` determine the minimum and\n"
-          "maximum percentiles of the camera centers considered.")
-      .def("transform",
-           &Reconstruction::Transform,
-           "Apply the 3D similarity transformation to all images and points.")
+          "maximum percentiles of the camera centers considered.\n\n"
+          "The images and points are processed in parallel with "
+          "`num_threads`\n"
+          "threads (-1 uses all available cores).")
+      .def(
+          "transform",
+          [](Reconstruction& self,
+             const Sim3d& new_from_old_world,
+             const int num_threads) {
+            py::gil_scoped_release release;
+            TransformReconstruction(self, new_from_old_world, num_threads);
+          },
+          "new_from_old_world"_a,
+          "num_threads"_a = -1,
+          "Apply the 3D similarity transformation to all images and points.\n"
+          "The images and points are processed in parallel with "
+          "`num_threads`\n"
+          "threads (-1 uses all available cores).")
       .def("compute_bounding_box",
            &Reconstruction::ComputeBoundingBox,
            "p0"_a = 0.0,
@@ -417,15 +794,31 @@ void init_reconstruction(py::module& m) {
            "the\n"
            "                     root path and the name of the image.\n\n"
            "@return              True if image could be read at given path.")
-      .def("extract_colors_for_all_images",
-           &Reconstruction::ExtractColorsForAllImages,
-           "Extract colors for all 3D points by computing the mean color of "
-           "all images.\n\n"
-           "@param path          Absolute or relative path to root folder of "
-           "image.\n"
-           "                     The image path is determined by concatenating "
-           "the\n"
-           "                     root path and the name of the image.")
+      .def(
+          "extract_colors_for_all_images",
+          [](Reconstruction& self,
+             const std::string& path,
+             const int num_threads,
+             const double scale) {
+            py::gil_scoped_release release;
+            ExtractColorsForAllImages(self, path, scale, num_threads);
+          },
+          "path"_a,
+          "num_threads"_a = -1,
+          "scale"_a = 1.0,
+          "Extract colors for all 3D points by computing the mean color of "
+          "all images.\n\n"
+          "@param path          Absolute or relative path to root folder of "
+          "image.\n"
+          "                     The image path is determined by concatenating "
+          "the\n"
+          "                     root path and the name of the image.\n"
+          "@param num_threads   Number of images decoded concurrently.\n"
+          "@param scale         Relative resolution in (0, 1] at which JPEG "
+          "images\n"
+          "                     are decoded. Other formats are decoded at "
+          "full\n"
+          "                     resolution.")
       .def("create_image_dirs",
            &Reconstruction::CreateImageDirs,
            "Create all image sub-directories in the given path.")
@@ -464,22 +857,56 @@ void init_reconstruction(py::module& m) {
              ss << "<Reconstruction 'num_reg_images=" << self.NumRegImages()
                 << ", num_cameras=" << self.NumCameras()
                 << ", num_points3D=" << self.NumPoints3D()
-                << ", num_observations=" << self.ComputeNumObservations()
+                << ", num_observations=" << ComputeNumObservations(self)
                 << "'>";
              return ss.str();
            })
-      .def("summary", [](const Reconstruction& self) {
-        std::stringstream ss;
-        ss << "Reconstruction:"
-           << "\n\tnum_reg_images = " << self.NumRegImages()
-           << "\n\tnum_cameras = " << self.NumCameras()
-           << "\n\tnum_points3D = " << self.NumPoints3D()
-           << "\n\tnum_observations = " << self.ComputeNumObservations()
-           << "\n\tmean_track_length = " << self.ComputeMeanTrackLength()
-           << "\n\tmean_observations_per_image = "
-           << self.ComputeMeanObservationsPerRegImage()
-           << "\n\tmean_reprojection_error = "
-           << self.ComputeMeanReprojectionError();
-        return ss.str();
-      });
+      .def(
+          "summary",
+          [](const Reconstruction& self, const int num_threads) {
+            ReconstructionStats stats;
+            {
+              py::gil_scoped_release release;
+              stats = ComputeReconstructionStats(self, num_threads);
+            }
+            std::stringstream ss;
+            ss << "Reconstruction:"
+               << "\n\tnum_reg_images = " << stats.num_reg_images
+               << "\n\tnum_cameras = " << stats.num_cameras
+               << "\n\tnum_points3D = " << stats.num_points3D
+               << "\n\tnum_observations = " << stats.num_observations
+               << "\n\tmean_track_length = " << stats.mean_track_length
+               << "\n\tmean_observations_per_image = "
+               << stats.mean_observations_per_reg_image
+               << "\n\tmean_reprojection_error = "
+               << stats.mean_reprojection_error;
+            return ss.str();
+          },
+          "num_threads"_a = -1)
+      .def(
+          "stats",
+          [](const Reconstruction& self, const int num_threads) {
+            ReconstructionStats stats;
+            {
+              py::gil_scoped_release release;
+              stats = ComputeReconstructionStats(self, num_threads);
+            }
+            py::dict dict;
+            dict["num_reg_images"] = stats.num_reg_images;
+            dict["num_cameras"] = stats.num_cameras;
+            dict["num_points3D"] = stats.num_points3D;
+            dict["num_observations"] = stats.num_observations;
+            dict["mean_track_length"] = stats.mean_track_length;
+            dict["mean_observations_per_image"] =
+                stats.mean_observations_per_reg_image;
+            dict["mean_reprojection_error"] = stats.mean_reprojection_error;
+            return dict;
+          },
+          "num_threads"_a = -1,
+          "Summary statistics of the reconstruction as a dict. The "
+          "observation\n"
+          "counts are gathered from the images and only the mean "
+          "reprojection\n"
+          "error requires a pass over the 3D points, using num_threads "
+          "threads.");
 }
@@ -0,0 +1,630 @@
+// Parallel reader and writer for the COLMAP text reconstruction format.
+
+#include "colmap/scene/reconstruction.h"
+#include "colmap/sensor/models.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/types.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace colmap;
+
+#include "log_exceptions.h"
+#include "mapped_file.h"
+#include "parse_double.h"
+#include "utils.h"
+
+// Tokenizer over a single line of whitespace-separated values.
+class TextLineParser {
+ public:
+  TextLineParser(const char* begin, const char* end) : ptr_(begin), end_(end) {
+    // Ignore trailing whitespace and carriage returns.
+    while (end_ > ptr_ && IsSpace(*(end_ - 1))) {
+      --end_;
+    }
+  }
+
+  bool AtEnd() {
+    SkipSpaces();
+    return ptr_ == end_;
+  }
+
+  uint64_t NextUInt64() {
+    SkipSpaces();
+    const char* begin = ptr_;
+    uint64_t value = 0;
+    while (ptr_ < end_ && *ptr_ >= '0' && *ptr_ <= '9') {
+      value = 10 * value + static_cast<uint64_t>(*ptr_ - '0');
+      ++ptr_;
+    }
+    CheckTokenEnd(begin);
+    return value;
+  }
+
+  int64_t NextInt64() {
+    SkipSpaces();
+    const bool negative = ptr_ < end_ && *ptr_ == '-';
+    if (negative || (ptr_ < end_ && *ptr_ == '+')) {
+      ++ptr_;
+    }
+    const int64_t value = static_cast<int64_t>(NextUInt64());
+    return negative ? -value : value;
+  }
+
+  double NextDouble() {
+    SkipSpaces();
+    const char* begin = ptr_;
+    while (ptr_ < end_ && !IsSpace(*ptr_)) {
+      ++ptr_;
+    }
+    THROW_CHECK_MSG(ptr_ > begin, "Expected a number: " + Line());
+    double value;
+    THROW_CHECK_MSG(ParseDouble(begin, ptr_, &value),
+                    "Invalid number: " + Line());
+    return value;
+  }
+
+  std::string NextToken() {
+    SkipSpaces();
+    const char* begin = ptr_;
+    while (ptr_ < end_ && !IsSpace(*ptr_)) {
+      ++ptr_;
+    }
+    return std::string(begin, ptr_);
+  }
+
+  // Remainder of the line without surrounding whitespace.
+  std::string Remainder() {
+    SkipSpaces();
+    std::string remainder(ptr_, end_);
+    ptr_ = end_;
+    return remainder;
+  }
+
+ private:
+  static bool IsSpace(const char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  void SkipSpaces() {
+    while (ptr_ < end_ && IsSpace(*ptr_)) {
+      ++ptr_;
+    }
+  }
+
+  void CheckTokenEnd(const char* begin) {
+    THROW_CHECK_MSG(ptr_ > begin && (ptr_ == end_ || IsSpace(*ptr_)),
+                    "Invalid integer: " + Line());
+  }
+
+  std::string Line() const { return std::string(ptr_, end_); }
+
+  const char* ptr_;
+  const char* end_;
+};
+
+// Split [begin, end) into up to num_chunks ranges aligned to line starts.
+std::vector<const char*> SplitAtLineBoundaries(const char* begin,
+                                               const char* end,
+                                               const size_t num_chunks) {
+  std::vector<const char*> bounds = {begin};
+  const size_t size = end - begin;
+  for (size_t i = 1; i < num_chunks; ++i) {
+    const char* bound = begin + size * i / num_chunks;
+    if (bound <= bounds.back()) {
+      continue;
+    }
+    const char* newline =
+        static_cast<const char*>(std::memchr(bound, '\n', end - bound));
+    bound = newline == nullptr ? end : newline + 1;
+    if (bound > bounds.back() && bound < end) {
+      bounds.push_back(bound);
+    }
+  }
+  bounds.push_back(end);
+  return bounds;
+}
+
+// Call func(line_begin, line_end) for every non-empty, non-comment line.
+template <typename Func>
+void ForEachDataLine(const char* begin, const char* end, Func&& func) {
+  while (begin < end) {
+    const char* newline =
+        static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    const char* line_end = newline == nullptr ? end : newline;
+    const char* first = begin;
+    while (first < line_end && (*first == ' ' || *first == '\r')) {
+      ++first;
+    }
+    if (first < line_end && *first != '#') {
+      func(first, line_end);
+    }
+    begin = line_end + 1;
+  }
+}
+
+void ReadCamerasText(const std::string& path, Reconstruction* reconstruction) {
+  const MappedFile file(path);
+  ForEachDataLine(
+      file.Begin(), file.End(), [&](const char* begin, const char* end) {
+        TextLineParser parser(begin, end);
+        Camera camera;
+        camera.SetCameraId(static_cast<camera_t>(parser.NextUInt64()));
+        const std::string model_name = parser.NextToken();
+        THROW_CHECK_MSG(ExistsCameraModelWithName(model_name),
+                        "Invalid camera model: " + model_name);
+        camera.SetModelIdFromName(model_name);
+        camera.SetWidth(parser.NextUInt64());
+        camera.SetHeight(parser.NextUInt64());
+        std::vector<double> params;
+        while (!parser.AtEnd()) {
+          params.push_back(parser.NextDouble());
+        }
+        camera.SetParams(params);
+        const std::string camera_id = std::to_string(camera.CameraId());
+        THROW_CHECK_MSG(camera.VerifyParams(),
+                        "Invalid number of camera parameters for camera " +
+                            camera_id);
+        THROW_CHECK_MSG(!reconstruction->ExistsCamera(camera.CameraId()),
+                        "Duplicate camera " + camera_id);
+        reconstruction->AddCamera(std::move(camera));
+      });
+}
+
+// Parse images.txt in parallel and add the images as registered. The
+// observations of 3D points are set by their tracks in points3D.txt.
+void ReadImagesText(const std::string& path,
+                    const int num_threads,
+                    Reconstruction* reconstruction) {
+  const MappedFile file(path);
+
+  // Images span two lines and the second one may be empty, so the pairs of
+  // lines are determined in a fast sequential scan before parsing.
+  std::vector<const char*> line_bounds;
+  bool expect_points_line = false;
+  const char* ptr = file.Begin();
+  while (ptr < file.End()) {
+    const char* newline =
+        static_cast<const char*>(std::memchr(ptr, '\n', file.End() - ptr));
+    const char* line_end = newline == nullptr ? file.End() : newline;
+    if (expect_points_line) {
+      line_bounds.push_back(line_end);
+      expect_points_line = false;
+    } else {
+      const char* first = ptr;
+      while (first < line_end && (*first == ' ' || *first == '\r')) {
+        ++first;
+      }
+      if (first < line_end && *first != '#') {
+        line_bounds.push_back(first);
+        line_bounds.push_back(line_end);
+        expect_points_line = true;
+      }
+    }
+    ptr = line_end + 1;
+  }
+  if (expect_points_line) {
+    // The last image has no points line.
+    line_bounds.push_back(file.End());
+  }
+
+  const size_t num_images = line_bounds.size() / 3;
+  std::vector<Image> images(num_images);
+  ParallelFor(
+      num_images, num_threads, [&](size_t, size_t begin, size_t end) {
+        std::vector<Eigen::Vector2d> points2D;
+        for (size_t i = begin; i < end; ++i) {
+          const char* image_line_begin = line_bounds[3 * i];
+          const char* image_line_end = line_bounds[3 * i + 1];
+          const char* points_line_begin =
+              std::min(image_line_end + 1, file.End());
+          const char* points_line_end = line_bounds[3 * i + 2];
+
+          Image& image = images[i];
+          TextLineParser image_parser(image_line_begin, image_line_end);
+          image.SetImageId(static_cast<image_t>(image_parser.NextUInt64()));
+          Rigid3d& cam_from_world = image.CamFromWorld();
+          cam_from_world.rotation.w() = image_parser.NextDouble();
+          cam_from_world.rotation.x() = image_parser.NextDouble();
+          cam_from_world.rotation.y() = image_parser.NextDouble();
+          cam_from_world.rotation.z() = image_parser.NextDouble();
+          cam_from_world.rotation.normalize();
+          for (int k = 0; k < 3; ++k) {
+            cam_from_world.translation(k) = image_parser.NextDouble();
+          }
+          image.SetCameraId(static_cast<camera_t>(image_parser.NextUInt64()));
+          image.SetName(image_parser.Remainder());
+
+          points2D.clear();
+          TextLineParser points_parser(points_line_begin, points_line_end);
+          while (!points_parser.AtEnd()) {
+            const double x = points_parser.NextDouble();
+            const double y = points_parser.NextDouble();
+            points_parser.NextInt64();
+            points2D.emplace_back(x, y);
+          }
+          image.SetPoints2D(points2D);
+        }
+      });
+
+  for (Image& image : images) {
+    const image_t image_id = image.ImageId();
+    THROW_CHECK_MSG(!reconstruction->ExistsImage(image_id),
+                    "Duplicate image " + std::to_string(image_id));
+    THROW_CHECK_MSG(reconstruction->ExistsCamera(image.CameraId()),
+                    "Invalid camera of image " + std::to_string(image_id));
+    reconstruction->AddImage(std::move(image));
+    reconstruction->RegisterImage(image_id);
+  }
+}
+
+struct TextPoint3D {
+  point3D_t point3D_id;
+  Eigen::Vector3d xyz;
+  Eigen::Vector3ub color;
+  double error;
+  Track track;
+};
+
+// Parse points3D.txt in parallel chunks into points sorted by their ids.
+std::vector<TextPoint3D> ReadPoints3DText(const std::string& path,
+                                          const int num_threads) {
+  const MappedFile file(path);
+  const std::vector<const char*> chunk_bounds = SplitAtLineBoundaries(
+      file.Begin(),
+      file.End(),
+      NumParallelChunks(file.Size(), num_threads));
+
+  const size_t num_chunks = chunk_bounds.size() - 1;
+  std::vector<std::vector<TextPoint3D>> chunk_points3D(num_chunks);
+  ParallelFor(
+      num_chunks, num_threads, [&](size_t, size_t begin, size_t end) {
+        std::vector<TrackElement> sorted_elements;
+        for (size_t chunk_idx = begin; chunk_idx < end; ++chunk_idx) {
+          ForEachDataLine(
+              chunk_bounds[chunk_idx],
+              chunk_bounds[chunk_idx + 1],
+              [&](const char* line_begin, const char* line_end) {
+                TextLineParser parser(line_begin, line_end);
+                TextPoint3D point3D;
+                point3D.point3D_id =
+                    static_cast<point3D_t>(parser.NextUInt64());
+                for (int k = 0; k < 3; ++k) {
+                  point3D.xyz(k) = parser.NextDouble();
+                }
+                for (int k = 0; k < 3; ++k) {
+                  point3D.color(k) = static_cast<uint8_t>(parser.NextUInt64());
+                }
+                point3D.error = parser.NextDouble();
+                while (!parser.AtEnd()) {
+                  const image_t image_id =
+                      static_cast<image_t>(parser.NextUInt64());
+                  const point2D_t point2D_idx =
+                      static_cast<point2D_t>(parser.NextUInt64());
+                  point3D.track.AddElement(image_id, point2D_idx);
+                }
+
+                // Reconstruction::AddPoint3D aborts on repeated observations.
+                sorted_elements = point3D.track.Elements();
+                const auto less = [](const TrackElement& element1,
+                                     const TrackElement& element2) {
+                  return std::make_pair(element1.image_id,
+                                        element1.point2D_idx) <
+                         std::make_pair(element2.image_id,
+                                        element2.point2D_idx);
+                };
+                const auto equal = [](const TrackElement& element1,
+                                      const TrackElement& element2) {
+                  return element1.image_id == element2.image_id &&
+                         element1.point2D_idx == element2.point2D_idx;
+                };
+                std::sort(sorted_elements.begin(), sorted_elements.end(), less);
+                THROW_CHECK_MSG(
+                    std::adjacent_find(sorted_elements.begin(),
+                                       sorted_elements.end(),
+                                       equal) == sorted_elements.end(),
+                    "Repeated observation in the track of 3D point " +
+                        std::to_string(point3D.point3D_id));
+                chunk_points3D[chunk_idx].push_back(std::move(point3D));
+              });
+        }
+      });
+
+  std::vector<TextPoint3D> points3D;
+  for (std::vector<TextPoint3D>& chunk : chunk_points3D) {
+    points3D.insert(points3D.end(),
+                    std::make_move_iterator(chunk.begin()),
+                    std::make_move_iterator(chunk.end()));
+    chunk.clear();
+    chunk.shrink_to_fit();
+  }
+  std::sort(points3D.begin(),
+            points3D.end(),
+            [](const TextPoint3D& point3D1, const TextPoint3D& point3D2) {
+              return point3D1.point3D_id < point3D2.point3D_id;
+            });
+  for (size_t i = 0; i < points3D.size(); ++i) {
+    const point3D_t point3D_id = points3D[i].point3D_id;
+    THROW_CHECK_MSG(point3D_id != 0 && point3D_id != kInvalidPoint3DId,
+                    "Invalid 3D point id " + std::to_string(point3D_id));
+    THROW_CHECK_MSG(i == 0 || points3D[i - 1].point3D_id != point3D_id,
+                    "Duplicate 3D point " + std::to_string(point3D_id));
+  }
+  return points3D;
+}
+
+// Add a 3D point with the given id. COLMAP 3.9 has no AddPoint3D overload
+// with an id, so this relies on the invariant that Reconstruction::AddPoint3D
+// assigns the ids 1, 2, 3, ... in order, starting at 1 in a new
+// Reconstruction and never reusing the ids of deleted points. The ids between
+// the last added point and the given id are thus allocated to empty points
+// that are deleted right away, which requires adding the points by
+// increasing id.
+point3D_t AddPoint3DWithId(const point3D_t point3D_id,
+                           const Eigen::Vector3d& xyz,
+                           Track track,
+                           const Eigen::Vector3ub& color,
+                           point3D_t* next_point3D_id,
+                           Reconstruction* reconstruction) {
+  THROW_CHECK_GE(point3D_id, *next_point3D_id);
+  for (; *next_point3D_id < point3D_id; ++*next_point3D_id) {
+    const point3D_t placeholder_id =
+        reconstruction->AddPoint3D(Eigen::Vector3d::Zero(), Track());
+    THROW_CHECK_EQ(placeholder_id, *next_point3D_id);
+    reconstruction->DeletePoint3D(placeholder_id);
+  }
+  const point3D_t added_point3D_id =
+      reconstruction->AddPoint3D(xyz, std::move(track), color);
+  THROW_CHECK_EQ(added_point3D_id, point3D_id);
+  *next_point3D_id = point3D_id + 1;
+  return added_point3D_id;
+}
+
+// Add the points, sorted by id, with their ids to a new reconstruction.
+void AddPoints3D(std::vector<TextPoint3D>* points3D,
+                 Reconstruction* reconstruction) {
+  point3D_t next_point3D_id = 1;
+  for (TextPoint3D& point3D : *points3D) {
+    // Reconstruction::AddPoint3D aborts on invalid observations.
+    for (const TrackElement& element : point3D.track.Elements()) {
+      THROW_CHECK_MSG(
+          reconstruction->ExistsImage(element.image_id) &&
+              element.point2D_idx <
+                  reconstruction->Image(element.image_id).NumPoints2D() &&
+              !reconstruction->Image(element.image_id)
+                   .Point2D(element.point2D_idx)
+                   .HasPoint3D(),
+          "Invalid observation in the track of 3D point " +
+              std::to_string(point3D.point3D_id));
+    }
+    const point3D_t point3D_id = AddPoint3DWithId(point3D.point3D_id,
+                                                  point3D.xyz,
+                                                  std::move(point3D.track),
+                                                  point3D.color,
+                                                  &next_point3D_id,
+                                                  reconstruction);
+    reconstruction->Point3D(point3D_id).SetError(point3D.error);
+  }
+}
+
+// Read a text reconstruction by parsing images.txt and points3D.txt in
+// parallel chunks of the memory-mapped files, and build it in memory. Files
+// with very sparse 3D point ids, which would require many placeholder points,
+// are read by Reconstruction::ReadText instead.
+void ReadReconstructionText(Reconstruction& reconstruction,
+                            const std::string& path,
+                            const int num_threads) {
+  std::vector<TextPoint3D> points3D =
+      ReadPoints3DText(JoinPaths(path, "points3D.txt"), num_threads);
+  const uint64_t num_unused_point3D_ids =
+      points3D.empty() ? 0 : points3D.back().point3D_id - points3D.size();
+  if (num_unused_point3D_ids > 4 * points3D.size() + (1 << 20)) {
+    points3D.clear();
+    reconstruction.ReadText(path);
+    return;
+  }
+  reconstruction = Reconstruction();
+  ReadCamerasText(JoinPaths(path, "cameras.txt"), &reconstruction);
+  ReadImagesText(JoinPaths(path, "images.txt"), num_threads, &reconstruction);
+  AddPoints3D(&points3D, &reconstruction);
+}
+
+// Append a double with the same formatting as a stream with precision 17.
+inline void AppendDouble(const double value, std::string* buffer) {
+  char chars[32];
+  const int length = std::snprintf(chars, sizeof(chars), "%.17g", value);
+  // The decimal point of printf depends on the C locale.
+  for (int i = 0; i < length; ++i) {
+    if (chars[i] == ',') {
+      chars[i] = '.';
+    }
+  }
+  buffer->append(chars, length);
+}
+
+inline void AppendUInt64(const uint64_t value, std::string* buffer) {
+  char chars[24];
+  char* ptr = chars + sizeof(chars);
+  uint64_t remainder = value;
+  do {
+    *--ptr = static_cast<char>('0' + remainder % 10);
+    remainder /= 10;
+  } while (remainder != 0);
+  buffer->append(ptr, chars + sizeof(chars) - ptr);
+}
+
+// Format num_items items in batches, each of which is formatted in parallel
+// chunks and then written in order, so that memory use stays bounded.
+template <typename Func>
+void WriteChunked(std::ofstream& file,
+                  const size_t num_items,
+                  const int num_threads,
+                  Func&& format_items) {
+  const size_t kMaxNumItemsPerChunk = 1 << 16;
+  const size_t num_chunks = NumParallelChunks(num_items, num_threads);
+  const size_t batch_size = num_chunks * kMaxNumItemsPerChunk;
+  std::vector<std::string> chunk_buffers(num_chunks);
+  for (size_t batch_begin = 0; batch_begin < num_items;
+       batch_begin += batch_size) {
+    const size_t batch_end = std::min(batch_begin + batch_size, num_items);
+    ParallelFor(batch_end - batch_begin,
+                num_threads,
+                [&](size_t chunk_idx, size_t begin, size_t end) {
+                  std::string& buffer = chunk_buffers[chunk_idx];
+                  buffer.clear();
+                  format_items(batch_begin + begin, batch_begin + end, &buffer);
+                });
+    for (std::string& buffer : chunk_buffers) {
+      file.write(buffer.data(), buffer.size());
+      buffer.clear();
+    }
+  }
+}
+
+// Write a text reconstruction in the same format as Reconstruction::WriteText
+// with the lines of images.txt and points3D.txt formatted in parallel.
+void WriteReconstructionText(const Reconstruction& reconstruction,
+                             const std::string& path,
+                             const int num_threads) {
+  {
+    const std::string cameras_path = JoinPaths(path, "cameras.txt");
+    std::ofstream file(cameras_path, std::ios::trunc);
+    THROW_CHECK_MSG(file.is_open(), "Could not open " + cameras_path);
+    std::string buffer =
+        "# Camera list with one line of data per camera:\n"
+        "#   CAMERA_ID, MODEL, WIDTH, HEIGHT, PARAMS[]\n"
+        "# Number of cameras: ";
+    AppendUInt64(reconstruction.NumCameras(), &buffer);
+    buffer += "\n";
+    for (const auto& camera : reconstruction.Cameras()) {
+      AppendUInt64(camera.first, &buffer);
+      buffer += " " + camera.second.ModelName() + " ";
+      AppendUInt64(camera.second.Width(), &buffer);
+      buffer += " ";
+      AppendUInt64(camera.second.Height(), &buffer);
+      for (const double param : camera.second.Params()) {
+        buffer += " ";
+        AppendDouble(param, &buffer);
+      }
+      buffer += "\n";
+    }
+    file.write(buffer.data(), buffer.size());
+  }
+
+  {
+    const std::string images_path = JoinPaths(path, "images.txt");
+    std::ofstream file(images_path, std::ios::trunc);
+    THROW_CHECK_MSG(file.is_open(), "Could not open " + images_path);
+    std::string header =
+        "# Image list with two lines of data per image:\n"
+        "#   IMAGE_ID, QW, QX, QY, QZ, TX, TY, TZ, CAMERA_ID, NAME\n"
+        "#   POINTS2D[] as (X, Y, POINT3D_ID)\n"
+        "# Number of images: ";
+    AppendUInt64(reconstruction.NumRegImages(), &header);
+    header += ", mean observations per image: ";
+    AppendDouble(reconstruction.ComputeMeanObservationsPerRegImage(), &header);
+    header += "\n";
+    file.write(header.data(), header.size());
+
+    const std::vector<image_t>& reg_image_ids = reconstruction.RegImageIds();
+    WriteChunked(
+        file,
+        reg_image_ids.size(),
+        num_threads,
+        [&](size_t begin, size_t end, std::string* buffer) {
+          for (size_t i = begin; i < end; ++i) {
+            const Image& image = reconstruction.Image(reg_image_ids[i]);
+            const Rigid3d& cam_from_world = image.CamFromWorld();
+            AppendUInt64(image.ImageId(), buffer);
+            for (const double value : {cam_from_world.rotation.w(),
+                                       cam_from_world.rotation.x(),
+                                       cam_from_world.rotation.y(),
+                                       cam_from_world.rotation.z(),
+                                       cam_from_world.translation(0),
+                                       cam_from_world.translation(1),
+                                       cam_from_world.translation(2)}) {
+              *buffer += " ";
+              AppendDouble(value, buffer);
+            }
+            *buffer += " ";
+            AppendUInt64(image.CameraId(), buffer);
+            *buffer += " " + image.Name() + "\n";
+            bool is_first = true;
+            for (const Point2D& point2D : image.Points2D()) {
+              if (!is_first) {
+                *buffer += " ";
+              }
+              is_first = false;
+              AppendDouble(point2D.xy(0), buffer);
+              *buffer += " ";
+              AppendDouble(point2D.xy(1), buffer);
+              *buffer += " ";
+              if (point2D.HasPoint3D()) {
+                AppendUInt64(point2D.point3D_id, buffer);
+              } else {
+                *buffer += "-1";
+              }
+            }
+            *buffer += "\n";
+          }
+        });
+  }
+
+  {
+    const std::string points3D_path = JoinPaths(path, "points3D.txt");
+    std::ofstream file(points3D_path, std::ios::trunc);
+    THROW_CHECK_MSG(file.is_open(), "Could not open " + points3D_path);
+    std::string header =
+        "# 3D point list with one line of data per point:\n"
+        "#   POINT3D_ID, X, Y, Z, R, G, B, ERROR, TRACK[] as "
+        "(IMAGE_ID, POINT2D_IDX)\n"
+        "# Number of points: ";
+    AppendUInt64(reconstruction.NumPoints3D(), &header);
+    header += ", mean track length: ";
+    AppendDouble(reconstruction.ComputeMeanTrackLength(), &header);
+    header += "\n";
+    file.write(header.data(), header.size());
+
+    // Chunks are ranges of hash buckets of the point storage.
+    const auto& points3D = reconstruction.Points3D();
+    WriteChunked(
+        file,
+        points3D.bucket_count(),
+        num_threads,
+        [&](size_t begin, size_t end, std::string* buffer) {
+          for (size_t bucket = begin; bucket < end; ++bucket) {
+            for (auto it = points3D.begin(bucket); it != points3D.end(bucket);
+                 ++it) {
+              const Point3D& point3D = it->second;
+              AppendUInt64(it->first, buffer);
+              for (int k = 0; k < 3; ++k) {
+                *buffer += " ";
+                AppendDouble(point3D.XYZ()(k), buffer);
+              }
+              for (int k = 0; k < 3; ++k) {
+                *buffer += " ";
+                AppendUInt64(point3D.Color(k), buffer);
+              }
+              *buffer += " ";
+              AppendDouble(point3D.Error(), buffer);
+              for (const TrackElement& track_el : point3D.Track().Elements()) {
+                *buffer += " ";
+                AppendUInt64(track_el.image_id, buffer);
+                *buffer += " ";
+                AppendUInt64(track_el.point2D_idx, buffer);
+              }
+              *buffer += "\n";
+            }
+          }
+        });
+  }
+}
@@ -13,6 +13,8 @@ using namespace pybind11::literals;
 using namespace colmap;
 
 #include "helpers.h"
+#include "pipeline/feature_cache.h"
+#include "pipeline/keypoint_selection.h"
 #include "utils.h"
 
 #define kdim 4
@@ -30,12 +32,25 @@ static std::map<int, std::unique_ptr<std::mutex>> sift_gpu_mutexes;
 
 class Sift {
  public:
-  Sift(SiftExtractionOptions options, Device device)
-      : options_(options), use_gpu_(IsGPU(device)) {
+  Sift(SiftExtractionOptions options,
+       Device device,
+       const KeypointSelectionOptions& selection_options,
+       const FeatureCacheOptions& cache_options)
+      : options_(options),
+        selection_options_(selection_options),
+        cache_options_(cache_options),
+        use_gpu_(IsGPU(device)) {
+    if (selection_options_.method != KeypointSelectionMethod::NONE) {
+      selection_options_.Check();
+    }
     VerifyGPUParams(use_gpu_);
     options_.use_gpu = use_gpu_;
     extractor_ = CreateSiftFeatureExtractor(options_);
     THROW_CHECK(extractor_ != nullptr);
+    if (cache_options_.Enabled()) {
+      cache_.reset(new FeatureCache(cache_options_));
+      cache_options_key_ = SiftExtractionOptionsKey(options_);
+    }
   }
 
   sift_output_t Extract(Eigen::Ref<const pyimage_t<uint8_t>> image) {
@@ -46,23 +61,49 @@ class Sift {
     const unsigned int width = image.cols();
     const unsigned int scan_width = (bpp / 8) * width;
     pyimage_t<uint8_t> image_copy = image;
-    FIBITMAP* bitmap_raw = FreeImage_ConvertFromRawBitsEx(
-        /*copySource=*/false,
-        static_cast<unsigned char*>(image_copy.data()),
-        FIT_BITMAP,
-        width,
-        image.rows(),
-        scan_width,
-        bpp,
-        FI_RGBA_RED_MASK,
-        FI_RGBA_GREEN_MASK,
-        FI_RGBA_BLUE_MASK,
-        /*topdown=*/true);
-    const Bitmap bitmap(bitmap_raw);
 
     FeatureKeypoints keypoints_;
     FeatureDescriptors descriptors_;
-    THROW_CHECK(extractor_->Extract(bitmap, &keypoints_, &descriptors_))
+    // The features are cached before the selection, which is cheap.
+    std::string cache_key;
+    CachedFeatures cached_features;
+    if (cache_) {
+      cache_key = FeatureCacheKey(
+          reinterpret_cast<const char*>(image_copy.data()),
+          image_copy.size(),
+          cache_options_key_ + "," + std::to_string(image.cols()));
+    }
+    if (cache_ && cache_->Read(cache_key, &cached_features)) {
+      keypoints_ = std::move(cached_features.keypoints);
+      descriptors_ = std::move(cached_features.descriptors);
+    } else {
+      FIBITMAP* bitmap_raw = FreeImage_ConvertFromRawBitsEx(
+          /*copySource=*/false,
+          static_cast<unsigned char*>(image_copy.data()),
+          FIT_BITMAP,
+          width,
+          image.rows(),
+          scan_width,
+          bpp,
+          FI_RGBA_RED_MASK,
+          FI_RGBA_GREEN_MASK,
+          FI_RGBA_BLUE_MASK,
+          /*topdown=*/true);
+      const Bitmap bitmap(bitmap_raw);
+      THROW_CHECK(extractor_->Extract(bitmap, &keypoints_, &descriptors_))
+      if (cache_) {
+        cached_features.camera.SetWidth(bitmap.Width());
+        cached_features.camera.SetHeight(bitmap.Height());
+        cached_features.keypoints = keypoints_;
+        cached_features.descriptors = descriptors_;
+        cache_->Write(cache_key, cached_features);
+      }
+    }
+    SelectKeypoints(image.cols(),
+                    image.rows(),
+                    selection_options_,
+                    &keypoints_,
+                    &descriptors_);
     const size_t num_features = keypoints_.size();
 
     keypoints_t keypoints(num_features, kdim);
@@ -86,11 +127,21 @@ class Sift {
 
   const SiftExtractionOptions& Options() const { return options_; };
 
+  const KeypointSelectionOptions& SelectionOptions() const {
+    return selection_options_;
+  };
+
+  const FeatureCacheOptions& CacheOptions() const { return cache_options_; };
+
   Device GetDevice() const { return (use_gpu_) ? Device::CUDA : Device::CPU; };
 
  private:
   std::unique_ptr<FeatureExtractor> extractor_;
   SiftExtractionOptions options_;
+  KeypointSelectionOptions selection_options_;
+  FeatureCacheOptions cache_options_;
+  std::unique_ptr<FeatureCache> cache_;
+  std::string cache_options_key_;
   bool use_gpu_ = false;
 };
 
@@ -102,9 +153,14 @@ void init_sift(py::module& m) {
   sift_options["max_image_size"] = 7000;
 
   py::class_<Sift>(m, "Sift")
-      .def(py::init<SiftExtractionOptions, Device>(),
+      .def(py::init<SiftExtractionOptions,
+                    Device,
+                    const KeypointSelectionOptions&,
+                    const FeatureCacheOptions&>(),
            "options"_a = sift_options,
-           "device"_a = Device::AUTO)
+           "device"_a = Device::AUTO,
+           "selection_options"_a = KeypointSelectionOptions(),
+           "cache_options"_a = FeatureCacheOptions())
       .def("extract",
            py::overload_cast<Eigen::Ref<const pyimage_t<uint8_t>>>(
                &Sift::Extract),
@@ -114,5 +170,7 @@ void init_sift(py::module& m) {
           py::overload_cast<Eigen::Ref<const pyimage_t<float>>>(&Sift::Extract),
           "image"_a.noconvert())
       .def_property_readonly("options", &Sift::Options)
+      .def_property_readonly("selection_options", &Sift::SelectionOptions)
+      .def_property_readonly("cache_options", &Sift::CacheOptions)
       .def_property_readonly("device", &Sift::GetDevice);
 }
@@ -0,0 +1,74 @@
+import numpy as np
+import pycolmap
+
+MAX_NUM_FEATURES = 200
+
+
+def textured_image(width=640, height=480, seed=0):
+    rng = np.random.default_rng(seed)
+    image = np.zeros((height, width))
+    for cell in [4, 8, 16, 32]:
+        noise = rng.normal(size=(height // cell + 1, width // cell + 1))
+        image += np.kron(noise, np.ones((cell, cell)))[:height, :width]
+    image -= image.min()
+    return (255 * image / image.max()).astype(np.uint8)
+
+
+def extract(image, method):
+    selection_options = pycolmap.KeypointSelectionOptions()
+    selection_options.method = method
+    selection_options.max_num_features = MAX_NUM_FEATURES
+    sift = pycolmap.Sift(
+        device=pycolmap.Device.cpu, selection_options=selection_options
+    )
+    keypoints, _ = sift.extract(image)
+    return keypoints, selection_options
+
+
+def suppression_radii(keypoints, robustness):
+    """Distance of each keypoint to the nearest one stronger by robustness."""
+    xy = keypoints[:, :2].astype(np.float64)
+    strengths = keypoints[:, 2].astype(np.float64)
+    distances = np.linalg.norm(xy[:, None] - xy[None], axis=-1)
+    stronger = strengths[None] * robustness > strengths[:, None]
+    return np.where(stronger, distances, np.inf).min(axis=1)
+
+
+def row_indices(keypoints, subset):
+    rows = {tuple(row): i for i, row in enumerate(keypoints[:, :2].tolist())}
+    return np.array([rows[tuple(row)] for row in subset[:, :2].tolist()])
+
+
+def test_anms_keeps_largest_radii():
+    image = textured_image()
+    keypoints, _ = extract(image, "NONE")
+    assert len(keypoints) > MAX_NUM_FEATURES
+    selected, options = extract(image, "ANMS")
+    assert len(selected) == MAX_NUM_FEATURES
+    # Sorted by decreasing strength.
+    assert np.all(np.diff(selected[:, 2]) <= 0)
+
+    radii = suppression_radii(keypoints, options.anms_robustness)
+    is_selected = np.zeros(len(keypoints), dtype=bool)
+    is_selected[row_indices(keypoints, selected)] = True
+    assert radii[is_selected].min() >= radii[~is_selected].max() - 1e-4
+
+
+def test_grid_covers_cells():
+    image = textured_image()
+    keypoints, _ = extract(image, "NONE")
+    selected, options = extract(image, "GRID")
+    assert len(selected) == MAX_NUM_FEATURES
+
+    cell_size = max(image.shape) / options.grid_num_cells
+    num_rows, num_cols = np.ceil(np.array(image.shape) / cell_size)
+
+    def cells(points):
+        cols = np.clip((points[:, 0] // cell_size), 0, num_cols - 1)
+        rows = np.clip((points[:, 1] // cell_size), 0, num_rows - 1)
+        return set(zip(rows.tolist(), cols.tolist()))
+
+    # There are fewer cells than selected keypoints, so every cell with a
+    # keypoint keeps its strongest one.
+    assert num_rows * num_cols <= MAX_NUM_FEATURES
+    assert cells(selected) == cells(keypoints)
@@ -0,0 +1,115 @@
+import numpy as np
+import pycolmap
+
+
+def gps_options(max_distance):
+    options = pycolmap.SpatialMatchingOptions()
+    options.is_gps = True
+    options.ignore_z = True
+    options.max_num_neighbors = 2
+    options.max_distance = max_distance
+    return options
+
+
+# At latitude 47, image 2 is 111 m north of image 1 and image 3 is 99 m east
+# of it. Zeroing the ECEF Z coordinate would shrink the north-south distance
+# to 81 m, below the east-west one.
+GPS_PRIORS = np.array(
+    [
+        [47.0, 8.0, 500.0],
+        [47.001, 8.0, 480.0],
+        [47.0, 8.0013, 520.0],
+    ]
+)
+IMAGE_IDS = [1, 2, 3]
+
+
+def test_spatial_pairs_gps_mid_latitude():
+    pairs = pycolmap.pairs_from_spatial_priors(
+        GPS_PRIORS, gps_options(105), image_ids=IMAGE_IDS
+    )
+    assert pairs.tolist() == [[1, 3]]
+
+    pairs = pycolmap.pairs_from_spatial_priors(
+        GPS_PRIORS, gps_options(115), image_ids=IMAGE_IDS
+    )
+    assert pairs.tolist() == [[1, 2], [1, 3]]
+
+
+def test_spatial_pairs_gps_altitude():
+    options = gps_options(105)
+    options.ignore_z = False
+    priors = GPS_PRIORS.copy()
+    priors[2, 2] = 600.0  # 141 m from image 1 with the altitude.
+    pairs = pycolmap.pairs_from_spatial_priors(
+        priors, options, image_ids=IMAGE_IDS
+    )
+    assert pairs.tolist() == []
+
+
+def test_spatial_pairs_default_image_ids():
+    pairs = pycolmap.pairs_from_spatial_priors(GPS_PRIORS, gps_options(105))
+    assert pairs.tolist() == [[1, 3]]
+
+
+def brute_force_pairs(descriptors, k, metric):
+    """Pairs of each row with its k nearest other rows, as ids from 1."""
+    descriptors = descriptors.astype(np.float64)
+    if metric == "COSINE":
+        descriptors /= np.linalg.norm(descriptors, axis=1, keepdims=True)
+    if metric == "L2":
+        squared_norms = (descriptors**2).sum(1)
+        distances = (
+            squared_norms[:, None]
+            + squared_norms[None]
+            - 2 * descriptors @ descriptors.T
+        )
+    else:
+        distances = -descriptors @ descriptors.T
+    np.fill_diagonal(distances, np.inf)
+    neighbors = np.argsort(distances, axis=1)[:, :k]
+    pairs = np.stack(
+        [np.repeat(np.arange(len(descriptors)), k), neighbors.ravel()], 1
+    )
+    return np.unique(np.sort(pairs, axis=1), axis=0) + 1
+
+
+def random_descriptors(num_images, dim=32, seed=0):
+    rng = np.random.default_rng(seed)
+    return rng.normal(size=(num_images, dim)).astype(np.float32)
+
+
+def test_global_pairs_exact():
+    descriptors = random_descriptors(300)
+    for metric in ["COSINE", "INNER_PRODUCT", "L2"]:
+        pairs = pycolmap.pairs_from_global_descriptors(
+            descriptors, 5, metric=metric, approx=False
+        )
+        expected = brute_force_pairs(descriptors, 5, metric)
+        assert pairs.tolist() == expected.tolist(), metric
+
+
+def test_global_pairs_hnsw_recall():
+    descriptors = random_descriptors(2000)
+    for metric in ["COSINE", "INNER_PRODUCT", "L2"]:
+        pairs = pycolmap.pairs_from_global_descriptors(
+            descriptors, 10, metric=metric, approx=True
+        )
+        expected = brute_force_pairs(descriptors, 10, metric)
+        found = set(map(tuple, pairs.tolist()))
+        recall = np.mean([tuple(pair) in found for pair in expected.tolist()])
+        assert recall > 0.95, metric
+
+
+def test_global_pairs_image_ids():
+    descriptors = random_descriptors(50)
+    pairs = pycolmap.pairs_from_global_descriptors(descriptors, 3)
+    assert pairs.min() == 1
+    assert pairs.max() <= len(descriptors)
+    assert np.all(pairs[:, 0] < pairs[:, 1])
+
+    image_ids = np.arange(len(descriptors)) * 2 + 10
+    pairs_with_ids = pycolmap.pairs_from_global_descriptors(
+        descriptors, 3, image_ids=image_ids.tolist()
+    )
+    assert pairs_with_ids.tolist() == image_ids[pairs - 1].tolist()
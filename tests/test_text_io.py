@@ -0,0 +1,52 @@
+import numpy as np
+import pycolmap
+
+
+def write_text_reconstruction(path, point3D_ids):
+    """Two images observing one 3D point of each id at their keypoints."""
+    (path / "cameras.txt").write_text("1 SIMPLE_PINHOLE 100 100 50 50 50\n")
+    points2D = " ".join(
+        f"{10 + i} {20 + i} {point3D_id}"
+        for i, point3D_id in enumerate(point3D_ids)
+    )
+    (path / "images.txt").write_text(
+        "# Image list\n"
+        f"1 1 0 0 0 0 0 0 1 image1.jpg\n{points2D}\n"
+        f"2 1 0 0 0 -1 0 0 1 image2.jpg\n{points2D}\n"
+    )
+    (path / "points3D.txt").write_text(
+        "".join(
+            f"{point3D_id} {i} 0 5 255 0 0 0.5 1 {i} 2 {i}\n"
+            for i, point3D_id in enumerate(point3D_ids)
+        )
+    )
+
+
+def check_read_text(path, point3D_ids):
+    write_text_reconstruction(path, point3D_ids)
+    reconstruction = pycolmap.Reconstruction()
+    reconstruction.read_text(str(path), num_threads=2)
+    assert sorted(reconstruction.points3D.keys()) == point3D_ids
+    for i, point3D_id in enumerate(point3D_ids):
+        point3D = reconstruction.points3D[point3D_id]
+        assert np.allclose(point3D.xyz, [i, 0, 5])
+        assert point3D.track.length() == 2
+    for image_id in [1, 2]:
+        image = reconstruction.images[image_id]
+        assert image.num_points3D() == len(point3D_ids)
+    # New points get ids after the largest one, as with the binary format.
+    new_point3D_id = reconstruction.add_point3D(np.zeros(3), pycolmap.Track())
+    assert new_point3D_id == max(point3D_ids) + 1
+
+
+def test_read_text_dense_ids(tmp_path):
+    check_read_text(tmp_path, [1, 2, 3])
+
+
+def test_read_text_ids_with_gaps(tmp_path):
+    check_read_text(tmp_path, [2, 5, 9, 100])
+
+
+def test_read_text_sparse_ids(tmp_path):
+    # Too sparse for placeholder points, so read by COLMAP's reader.
+    check_read_text(tmp_path, [1, 7, 2**40])
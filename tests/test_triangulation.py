@@ -0,0 +1,72 @@
+import numpy as np
+import pycolmap
+
+FOCAL_LENGTH = 1000.0
+PRINCIPAL_POINT = np.array([500.0, 500.0])
+POINT = np.array([0.3, -0.2, 10.0])
+# Five cameras 1 m apart along the x-axis, all looking along the z-axis.
+CENTERS = np.array([[x, 0.0, 0.0] for x in [-2.0, -1.0, 0.0, 1.0, 2.0]])
+
+
+def triangulate_track(offsets_y, options=None):
+    """Triangulate POINT from the first len(offsets_y) cameras, with the
+    observations offset vertically by the given number of pixels."""
+    num_obs = len(offsets_y)
+    points2D = (
+        FOCAL_LENGTH * (POINT[:2] - CENTERS[:num_obs, :2]) / POINT[2]
+        + PRINCIPAL_POINT
+    )
+    points2D[:, 1] += offsets_y
+    camera = pycolmap.Camera(
+        model="SIMPLE_PINHOLE",
+        width=1000,
+        height=1000,
+        params=[FOCAL_LENGTH, *PRINCIPAL_POINT],
+    )
+    cams_from_world = [
+        pycolmap.Rigid3d(pycolmap.Rotation3d([0.0, 0.0, 0.0, 1.0]), -center)
+        for center in CENTERS[:num_obs]
+    ]
+    if options is None:
+        options = pycolmap.BatchTriangulationOptions()
+    return pycolmap.triangulate(
+        points2D,
+        np.array([0, num_obs]),
+        np.arange(num_obs),
+        cams_from_world,
+        [camera] * num_obs,
+        options,
+    )
+
+
+def test_triangulate_exact():
+    result = triangulate_track([0, 0, 0, 0, 0])
+    assert result["success"].tolist() == [True]
+    assert result["num_inliers"].tolist() == [5]
+    assert np.allclose(result["xyz"][0], POINT)
+    assert result["errors"][0] < 1e-6
+
+
+def test_triangulate_rejects_outlier_without_ransac():
+    result = triangulate_track([0, 0, 500, 0, 0])
+    assert result["success"].tolist() == [True]
+    assert result["inlier_mask"].tolist() == [True, True, False, True, True]
+    assert np.allclose(result["xyz"][0], POINT)
+    assert result["errors"][0] < 1e-6
+
+
+def test_triangulate_fails_inconsistent_track():
+    # The rays do not intersect, so either observation is off by about
+    # 250 pixels.
+    result = triangulate_track([0, 500])
+    assert result["success"].tolist() == [False]
+    assert result["num_inliers"][0] < 2
+
+
+def test_triangulate_max_error():
+    options = pycolmap.BatchTriangulationOptions()
+    options.max_error = 1000.0
+    result = triangulate_track([0, 500], options)
+    assert result["success"].tolist() == [True]
+    assert result["num_inliers"].tolist() == [2]
+    assert result["errors"][0] > 100
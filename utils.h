@@ -1,8 +1,16 @@
 #pragma once
 
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <future>
 #include <iostream>
 #include <regex>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "log_exceptions.h"
 
@@ -28,4 +36,95 @@ void VerifyGPUParams(const bool use_gpu) {
                     "set device='auto' or device='cpu'.")
   }
 #endif
-}
\ No newline at end of file
+}
+
+// Number of chunks into which ParallelFor splits a range of num_items items,
+// i.e. one chunk per thread. Useful to allocate per-chunk buffers.
+inline size_t NumParallelChunks(const size_t num_items, const int num_threads) {
+  const size_t effective_num_threads =
+      static_cast<size_t>(colmap::GetEffectiveNumThreads(num_threads));
+  return std::max<size_t>(1, std::min(num_items, effective_num_threads));
+}
+
+// Split [0, num_items) into one contiguous chunk per thread of the pool, or
+// fewer if there are fewer items, and call func(chunk_idx, begin, end) for
+// each of them on the pool, e.g. to reuse the threads for many small ranges.
+// A single chunk is processed in the calling thread. Exceptions thrown by func
+// are rethrown once all chunks have finished.
+template <typename Func>
+void ParallelFor(colmap::ThreadPool& thread_pool,
+                 const size_t num_items,
+                 Func&& func) {
+  const size_t num_chunks = std::max<size_t>(
+      1, std::min(num_items, static_cast<size_t>(thread_pool.NumThreads())));
+  if (num_chunks == 1) {
+    func(0, 0, num_items);
+    return;
+  }
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_chunks);
+  for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+    const size_t begin = num_items * chunk_idx / num_chunks;
+    const size_t end = num_items * (chunk_idx + 1) / num_chunks;
+    futures.push_back(thread_pool.AddTask(
+        [&func, chunk_idx, begin, end]() { func(chunk_idx, begin, end); }));
+  }
+
+  std::exception_ptr exception;
+  for (auto& future : futures) {
+    try {
+      future.get();
+    } catch (...) {
+      if (!exception) {
+        exception = std::current_exception();
+      }
+    }
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+// Split [0, num_items) into NumParallelChunks contiguous chunks and call
+// func(chunk_idx, begin, end) for each of them on a new thread pool, as above.
+template <typename Func>
+void ParallelFor(const size_t num_items, const int num_threads, Func&& func) {
+  const size_t num_chunks = NumParallelChunks(num_items, num_threads);
+  if (num_chunks == 1) {
+    func(0, 0, num_items);
+    return;
+  }
+  colmap::ThreadPool thread_pool(static_cast<int>(num_chunks));
+  ParallelFor(thread_pool, num_items, std::forward<Func>(func));
+}
+
+// Call func(chunk_idx, element) for all elements of an unordered map in
+// parallel. The chunks are contiguous ranges of hash buckets, so that no
+// intermediate list of keys has to be built. The map must not be rehashed
+// while iterating, i.e. func must not insert or erase elements.
+template <typename MapType, typename Func>
+void ParallelForEachInMap(MapType& map, const int num_threads, Func&& func) {
+  ParallelFor(map.bucket_count(),
+              num_threads,
+              [&map, &func](size_t chunk_idx, size_t begin, size_t end) {
+                for (size_t bucket = begin; bucket < end; ++bucket) {
+                  for (auto it = map.begin(bucket); it != map.end(bucket);
+                       ++it) {
+                    func(chunk_idx, *it);
+                  }
+                }
+              });
+}
+
+// Shard of an item among num_shards, from the 64-bit FNV-1a hash of its key.
+// Unlike std::hash, the hash is the same on all platforms and runs, so that
+// workers on different machines agree on the shards.
+inline size_t ShardOfKey(const std::string& key, const size_t num_shards) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<size_t>(hash % num_shards);
+}